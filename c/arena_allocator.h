@@ -0,0 +1,112 @@
+#pragma once
+
+/*
+ * Adapters to allocate the memory of STL containers from an Arena:
+ *  - ArenaAllocator<T>: classic allocator. Requires C++11.
+ *  - ArenaMemoryResource: std::pmr::memory_resource for std::pmr containers. Requires C++17.
+ *
+ * Memory is bump-allocated from the arena and it's released all at once when the arena is cleared or its position is
+ * restored. Deallocating the last allocation of the arena gives its memory back, so a container that is built and
+ * destroyed at the top of the arena doesn't leave anything behind. Any other deallocation is a no-op.
+ *
+ * The containers must be destroyed before the arena memory they use is released.
+ *
+ * Tests are defined in `arena_test.cpp`.
+ * */
+
+#include <stddef.h>
+
+#include "basic.h"
+
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#   define ARENA_MEMORY_RESOURCE
+#   include <memory_resource>
+#endif
+
+// Pop memory from the arena if it's the last element pushed. Returns true if the memory was given back to the arena.
+static inline bool arena_pop_if_last(Arena *arena, void *memory, u64 size) {
+    // @NOTE: the memory doesn't belong to the current block of a growable arena if it's not right below _position, so
+    // arena_set_pos() never has to pop a block here.
+    bool is_last_element = (u8*)memory + size == arena->_position && (u8*)memory >= arena->_memory_start;
+    if (is_last_element) {
+        arena_set_pos(arena, arena_get_pos(arena) - size);
+    }
+    return is_last_element;
+}
+
+// ####################################################################################################################
+// Classic allocator
+
+template <typename T>
+struct ArenaAllocator {
+    typedef T value_type;
+
+    Arena *arena;
+
+    explicit ArenaAllocator(Arena *a) : arena(a) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+    // @NOTE: containers may ask for 0 elements, but arenas don't support empty allocations
+    T *allocate(size_t count) {
+        T *memory = (T*)ARENA_PUSH_DATA(arena, sizeof(T), count > 0 ? count : 1, alignof(T), 0);
+        return memory;
+    }
+
+    void deallocate(T *memory, size_t count) {
+        arena_pop_if_last(arena, memory, sizeof(T)*(count > 0 ? count : 1));
+    }
+
+    // Grow memory returned by allocate(). It grows in place if it's the last element pushed into the arena, otherwise it
+    // pushes new memory and copies the elements with memcpy, so use it only with trivially copyable types. Extra memory
+    // is not zeroed out.
+    T *reallocate(T *memory, size_t prev_count, size_t new_count) {
+        T *result = arena_grow_in_place_or_realloc(arena, T, memory, prev_count, new_count);
+        return result;
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) {
+    return a.arena == b.arena;
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) {
+    return a.arena != b.arena;
+}
+
+// ####################################################################################################################
+// Polymorphic memory resource
+
+#ifdef ARENA_MEMORY_RESOURCE
+struct ArenaMemoryResource : std::pmr::memory_resource {
+    Arena *arena;
+
+    explicit ArenaMemoryResource(Arena *a) : arena(a) {}
+
+    // See ArenaAllocator::reallocate()
+    void *reallocate(void *memory, size_t prev_size, size_t new_size, size_t alignment) {
+        void *result = arena_grow_in_place_or_realloc_impl(arena, memory, prev_size, new_size, alignment);
+        return result;
+    }
+
+protected:
+    void *do_allocate(size_t size, size_t alignment) override {
+        // @NOTE: std::pmr containers may ask for 0 bytes, but arenas don't support empty allocations
+        void *memory = ARENA_PUSH_DATA(arena, size > 0 ? size : 1, 1, alignment, 0);
+        return memory;
+    }
+
+    void do_deallocate(void *memory, size_t size, size_t alignment) override {
+        UNUSED(alignment);
+        arena_pop_if_last(arena, memory, size > 0 ? size : 1);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+        const ArenaMemoryResource *resource = dynamic_cast<const ArenaMemoryResource*>(&other);
+        return resource != nullptr && resource->arena == arena;
+    }
+};
+#endif
@@ -0,0 +1,799 @@
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __linux__
+#   include <linux/perf_event.h>
+#   include <sys/ioctl.h>
+#   include <sys/syscall.h>
+#   include <unistd.h>
+#endif
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "arena_allocator.h"
+#include "basic.h"
+#include "bench_suite.cpp"
+
+// ####################################################################################################################
+// Hardware counters
+
+// Open a counter for the data TLB misses of this thread. Returns -1 if it's not available, for example in virtual machines
+// or when /proc/sys/kernel/perf_event_paranoid doesn't allow it.
+static int dtlb_miss_counter_open() {
+#ifdef __linux__
+    struct perf_event_attr attr = {};
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    return fd;
+#else
+    return -1;
+#endif
+}
+
+static void dtlb_miss_counter_start(int fd) {
+#ifdef __linux__
+    if (fd != -1) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#else
+    UNUSED(fd);
+#endif
+}
+
+static i64 dtlb_miss_counter_stop(int fd) {
+    i64 count = -1;
+#ifdef __linux__
+    if (fd != -1) {
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+            count = -1;
+        }
+    }
+#else
+    UNUSED(fd);
+#endif
+    return count;
+}
+
+// ####################################################################################################################
+// Benchmarks
+
+// Random reads over a big arena. Every access touches a different page most of the time, so it's dominated by TLB misses
+// when the arena uses regular pages.
+static void bench_random_access(const char *name, u32 flags) {
+    u64 size = 1*GiB;
+    u64 count = size/sizeof(u64);
+    u64 accesses = 20*1000*1000;
+
+    ArenaParams params = {};
+    params.capacity = size;
+    params.flags = flags;
+    Arena arena = arena_alloc_params(params);
+
+    arena_commit(&arena, size);
+    u64 *values = arena_push_nozero(&arena, u64, count);
+    for (u64 i = 0; i < count; i++) {
+        values[i] = i;
+    }
+
+    int counter = dtlb_miss_counter_open();
+    dtlb_miss_counter_start(counter);
+
+    u64 start = bench_now_ns();
+    u64 state = 0x9E3779B97F4A7C15ull;
+    u64 sum = 0;
+    for (u64 i = 0; i < accesses; i++) {
+        // xorshift64
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        sum += values[state & (count - 1)];
+    }
+    u64 elapsed = bench_now_ns() - start;
+    bench_sink = sum;
+
+    i64 misses = dtlb_miss_counter_stop(counter);
+    bench_print(name, accesses, elapsed);
+    if (misses >= 0) {
+        printf("%-56s %10.4f dTLB misses/op\n", "", (f64)misses/(f64)accesses);
+    } else {
+        printf("%-56s %10s dTLB misses/op (counter not available)\n", "", "-");
+    }
+
+#ifdef __linux__
+    if (counter != -1) {
+        close(counter);
+    }
+#endif
+    arena_free(&arena);
+}
+
+#define BENCH_PUSHES_PER_THREAD (2*1000*1000)
+
+typedef struct {
+    Arena *arena;
+    Mutex *mutex;
+    ConcurrentArena *concurrent_arena;
+} PushBenchContext;
+
+static void push_mutex_arena_thread(void *arg) {
+    PushBenchContext *context = (PushBenchContext*)arg;
+    for (u64 i = 0; i < BENCH_PUSHES_PER_THREAD; i++) {
+        mutex_lock(context->mutex);
+        u64 *value = arena_push_nozero(context->arena, u64, 4);
+        mutex_unlock(context->mutex);
+        value[0] = i;
+    }
+}
+
+static void push_concurrent_arena_thread(void *arg) {
+    PushBenchContext *context = (PushBenchContext*)arg;
+    for (u64 i = 0; i < BENCH_PUSHES_PER_THREAD; i++) {
+        u64 *value = arena_push_nozero(context->concurrent_arena, u64, 4);
+        value[0] = i;
+    }
+}
+
+// Every thread pushes BENCH_PUSHES_PER_THREAD objects of 32 bytes into the same arena
+static void bench_shared_arena_push(u32 thread_count) {
+    Arena arena = arena_alloc((u64)8*GiB);
+    ConcurrentArena concurrent_arena = concurrent_arena_alloc((u64)8*GiB);
+    Mutex mutex = {};
+    PushBenchContext context = { &arena, &mutex, &concurrent_arena };
+
+    ThreadFunction functions[] = { push_mutex_arena_thread, push_concurrent_arena_thread };
+    const char *names[] = { "mutex + Arena", "ConcurrentArena" };
+    for (u32 f = 0; f < ARRAY_LENGTH(functions); f++) {
+        Thread threads[64];
+        u64 start = bench_now_ns();
+        for (u32 i = 0; i < thread_count; i++) {
+            threads[i] = thread_create(functions[f], &context);
+        }
+        for (u32 i = 0; i < thread_count; i++) {
+            thread_join(threads[i]);
+        }
+        u64 elapsed = bench_now_ns() - start;
+
+        char name[128];
+        snprintf(name, sizeof(name), "%s, %u threads", names[f], thread_count);
+        bench_print(name, (u64)thread_count*BENCH_PUSHES_PER_THREAD, elapsed);
+    }
+
+    concurrent_arena_free(&concurrent_arena);
+    arena_free(&arena);
+}
+
+// Objects of the size of a typical connection or timer that are allocated and released all the time
+typedef struct {
+    u64 id;
+    u64 deadline;
+    void *callback;
+    void *user_data;
+    u8 buffer[96];
+} ChurnObject;
+
+#define CHURN_LIVE_OBJECTS 10000
+#define CHURN_OPERATIONS (20*1000*1000)
+
+// Keep CHURN_LIVE_OBJECTS alive and replace a random one on every operation
+static void bench_pool_churn() {
+    Arena arena = arena_alloc(GiB);
+    ChurnObject **live = arena_push(&arena, ChurnObject*, CHURN_LIVE_OBJECTS);
+
+    {
+        for (u64 i = 0; i < CHURN_LIVE_OBJECTS; i++) {
+            live[i] = (ChurnObject*)malloc(sizeof(ChurnObject));
+        }
+
+        u64 state = 1;
+        u64 start = bench_now_ns();
+        for (u64 i = 0; i < CHURN_OPERATIONS; i++) {
+            state = state*6364136223846793005ull + 1442695040888963407ull;
+            u64 index = (state >> 33) % CHURN_LIVE_OBJECTS;
+            free(live[index]);
+            live[index] = (ChurnObject*)malloc(sizeof(ChurnObject));
+            live[index]->id = i;
+        }
+        u64 elapsed = bench_now_ns() - start;
+        bench_print("malloc/free", CHURN_OPERATIONS, elapsed);
+
+        for (u64 i = 0; i < CHURN_LIVE_OBJECTS; i++) {
+            free(live[i]);
+        }
+    }
+
+    {
+        Pool pool = pool_make(&arena, ChurnObject, 1024);
+        for (u64 i = 0; i < CHURN_LIVE_OBJECTS; i++) {
+            live[i] = pool_push_nozero(&pool, ChurnObject);
+        }
+
+        u64 state = 1;
+        u64 start = bench_now_ns();
+        for (u64 i = 0; i < CHURN_OPERATIONS; i++) {
+            state = state*6364136223846793005ull + 1442695040888963407ull;
+            u64 index = (state >> 33) % CHURN_LIVE_OBJECTS;
+            pool_release(&pool, live[index]);
+            live[index] = pool_push_nozero(&pool, ChurnObject);
+            live[index]->id = i;
+        }
+        u64 elapsed = bench_now_ns() - start;
+        bench_print("pool_release/pool_push_nozero", CHURN_OPERATIONS, elapsed);
+    }
+
+    arena_free(&arena);
+}
+
+#define HEAP_LIVE_ALLOCATIONS 20000
+#define HEAP_OPERATIONS (2*1000*1000)
+
+// Size distribution of a typical service: mostly small objects, some buffers and a few big ones
+static u64 heap_bench_size(u64 random) {
+    u64 bucket = random % 100;
+    random >>= 8;
+    u64 size;
+    if (bucket < 80) {
+        size = 16 + random % 112;
+    } else if (bucket < 98) {
+        size = 128 + random % 3968;
+    } else {
+        size = 4096 + random % (60*KiB);
+    }
+    return size;
+}
+
+typedef struct {
+    void *(*push)(void *allocator, u64 size);
+    void (*release)(void *allocator, void *memory);
+    void *allocator;
+} HeapBenchAllocator;
+
+static void *heap_bench_malloc(void *allocator, u64 size) { UNUSED(allocator); return malloc(size); }
+static void  heap_bench_free(void *allocator, void *memory) { UNUSED(allocator); free(memory); }
+static void *heap_bench_heap_push(void *allocator, u64 size) { return heap_push_data((Heap*)allocator, size, 16, 0); }
+static void  heap_bench_heap_release(void *allocator, void *memory) { heap_release((Heap*)allocator, memory); }
+
+// Replace random live allocations and measure the latency of every release+push pair. Returns the bytes requested by the
+// allocations that are alive at the end.
+static u64 heap_bench_run(const char *name, HeapBenchAllocator allocator, Arena *arena) {
+    TempArena temp = temp_arena_begin(arena);
+    void **live = arena_push(arena, void*, HEAP_LIVE_ALLOCATIONS);
+    u64 *sizes = arena_push(arena, u64, HEAP_LIVE_ALLOCATIONS);
+    u64 *latencies = arena_push_nozero(arena, u64, HEAP_OPERATIONS);
+
+    u64 state = 7;
+    u64 live_bytes = 0;
+    for (u64 i = 0; i < HEAP_LIVE_ALLOCATIONS; i++) {
+        state = state*6364136223846793005ull + 1442695040888963407ull;
+        sizes[i] = heap_bench_size(state >> 20);
+        live[i] = allocator.push(allocator.allocator, sizes[i]);
+        live_bytes += sizes[i];
+    }
+
+    u64 total_start = bench_now_ns();
+    for (u64 i = 0; i < HEAP_OPERATIONS; i++) {
+        state = state*6364136223846793005ull + 1442695040888963407ull;
+        u64 index = (state >> 33) % HEAP_LIVE_ALLOCATIONS;
+        u64 size = heap_bench_size(state >> 5);
+
+        u64 start = bench_now_ns();
+        allocator.release(allocator.allocator, live[index]);
+        live[index] = allocator.push(allocator.allocator, size);
+        latencies[i] = bench_now_ns() - start;
+
+        *(u8*)live[index] = 1;
+        live_bytes = live_bytes - sizes[index] + size;
+        sizes[index] = size;
+    }
+    u64 total_elapsed = bench_now_ns() - total_start;
+
+    bench_print(name, HEAP_OPERATIONS, total_elapsed);
+    bench_print_latencies("", latencies, HEAP_OPERATIONS);
+
+    for (u64 i = 0; i < HEAP_LIVE_ALLOCATIONS; i++) {
+        allocator.release(allocator.allocator, live[i]);
+    }
+    temp_arena_end(temp);
+    return live_bytes;
+}
+
+static void bench_heap() {
+    Arena arena = arena_alloc(GiB);
+
+    // The fragmentation is the memory the allocator holds divided by the bytes requested by the live allocations
+    HeapBenchAllocator system = { heap_bench_malloc, heap_bench_free, 0 };
+    heap_bench_run("malloc/free (release + push)", system, &arena);
+
+    Heap heap = heap_alloc((u64)8*GiB);
+    HeapBenchAllocator tlsf = { heap_bench_heap_push, heap_bench_heap_release, &heap };
+    u64 live_bytes = heap_bench_run("heap_push_data/heap_release (release + push)", tlsf, &arena);
+    HeapStats stats = heap_get_stats(&heap);
+    printf("%-56s %10.3f heap size / live bytes\n", "heap fragmentation", (f64)stats.heap_size/(f64)live_bytes);
+
+    heap_free(&heap);
+    arena_free(&arena);
+}
+
+// ####################################################################################################################
+// STL containers
+
+#define CONTAINERS_ROUNDS 20
+#define CONTAINERS_ELEMENTS 200000
+
+// The workloads are templates over the allocator, so the same code runs with std::allocator, ArenaAllocator and
+// std::pmr::polymorphic_allocator
+template <typename Allocator>
+static u64 containers_vector_workload(const Allocator &allocator) {
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<u64> U64Allocator;
+    std::vector<u64, U64Allocator> numbers(allocator);
+    for (u64 i = 0; i < CONTAINERS_ELEMENTS; i++) {
+        numbers.push_back(i);
+    }
+    return numbers.size();
+}
+
+template <typename Allocator>
+static u64 containers_map_workload(const Allocator &allocator) {
+    typedef std::pair<const u64, u64> Entry;
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<Entry> EntryAllocator;
+    std::unordered_map<u64, u64, std::hash<u64>, std::equal_to<u64>, EntryAllocator> map(allocator);
+    for (u64 i = 0; i < CONTAINERS_ELEMENTS; i++) {
+        map[i*2654435761u] = i;
+    }
+    u64 sum = 0;
+    for (u64 i = 0; i < CONTAINERS_ELEMENTS; i++) {
+        sum += map[i*2654435761u];
+    }
+    return sum;
+}
+
+template <typename Allocator>
+static u64 containers_strings_workload(const Allocator &allocator) {
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<char> CharAllocator;
+    typedef std::basic_string<char, std::char_traits<char>, CharAllocator> StdString;
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<StdString> StringAllocator;
+    std::vector<StdString, StringAllocator> strings(allocator);
+    for (u64 i = 0; i < CONTAINERS_ELEMENTS; i++) {
+        StdString s(allocator);
+        s.append("a string that doesn't fit in the small string buffer #");
+        s.append(1 + i % 16, 'x');
+        strings.push_back(std::move(s));
+    }
+    return strings.size();
+}
+
+template <typename Allocator>
+static void bench_containers_with(const char *name, const Allocator &allocator, Arena *arena) {
+    typedef u64 (*Workload)(const Allocator&);
+    const char *workload_names[] = { "vector<u64> push_back", "unordered_map<u64, u64> insert+find", "vector<string> push_back" };
+    Workload workloads[] = { containers_vector_workload<Allocator>, containers_map_workload<Allocator>, containers_strings_workload<Allocator> };
+
+    for (u64 w = 0; w < ARRAY_LENGTH(workloads); w++) {
+        u64 start = bench_now_ns();
+        for (u64 round = 0; round < CONTAINERS_ROUNDS; round++) {
+            bench_sink += workloads[w](allocator);
+            arena_clear(arena);
+        }
+        u64 elapsed = bench_now_ns() - start;
+
+        char label[128];
+        snprintf(label, sizeof(label), "%s, %s", workload_names[w], name);
+        bench_print(label, CONTAINERS_ROUNDS*CONTAINERS_ELEMENTS, elapsed);
+    }
+}
+
+static void bench_containers() {
+    Arena arena = arena_alloc(GiB);
+
+    bench_containers_with("std::allocator", std::allocator<u64>(), &arena);
+    bench_containers_with("ArenaAllocator", ArenaAllocator<u64>(&arena), &arena);
+#ifdef ARENA_MEMORY_RESOURCE
+    ArenaMemoryResource resource(&arena);
+    bench_containers_with("ArenaMemoryResource", std::pmr::polymorphic_allocator<u64>(&resource), &arena);
+#endif
+
+    arena_free(&arena);
+}
+
+#define ARRAY_ROUNDS 20
+#define ARRAY_ELEMENTS (1000*1000)
+
+// Push into an Array while another allocation lands after it every `interleave` pushes, so it can't always grow in place
+static void bench_array_push(const char *name, Arena *arena, u64 interleave) {
+    u64 start = bench_now_ns();
+    for (u64 round = 0; round < ARRAY_ROUNDS; round++) {
+        Array<u64> numbers = array_make(arena, u64, 0);
+        for (u64 i = 0; i < ARRAY_ELEMENTS; i++) {
+            array_push(&numbers, i);
+            if (interleave != 0 && i % interleave == 0) {
+                arena_push(arena, u64);
+            }
+        }
+        bench_sink += numbers.data[numbers.length - 1];
+        arena_clear(arena);
+    }
+    bench_print(name, ARRAY_ROUNDS*ARRAY_ELEMENTS, bench_now_ns() - start);
+}
+
+static void bench_array() {
+    Arena arena = arena_alloc(GiB);
+
+    u64 start = bench_now_ns();
+    for (u64 round = 0; round < ARRAY_ROUNDS; round++) {
+        std::vector<u64> numbers;
+        for (u64 i = 0; i < ARRAY_ELEMENTS; i++) {
+            numbers.push_back(i);
+        }
+        bench_sink += numbers.back();
+    }
+    bench_print("std::vector push_back", ARRAY_ROUNDS*ARRAY_ELEMENTS, bench_now_ns() - start);
+
+    bench_array_push("array_push, always the last element", &arena, 0);
+    bench_array_push("array_push, another push every 1000 elements", &arena, 1000);
+
+    u64 chunk[64];
+    for (u64 i = 0; i < ARRAY_LENGTH(chunk); i++) {
+        chunk[i] = i;
+    }
+
+    start = bench_now_ns();
+    for (u64 round = 0; round < ARRAY_ROUNDS; round++) {
+        std::vector<u64> numbers;
+        for (u64 i = 0; i < ARRAY_ELEMENTS; i += ARRAY_LENGTH(chunk)) {
+            numbers.insert(numbers.end(), chunk, chunk + ARRAY_LENGTH(chunk));
+        }
+        bench_sink += numbers.back();
+    }
+    bench_print("std::vector insert, 64 elements at a time", ARRAY_ROUNDS*ARRAY_ELEMENTS, bench_now_ns() - start);
+
+    start = bench_now_ns();
+    for (u64 round = 0; round < ARRAY_ROUNDS; round++) {
+        Array<u64> numbers = array_make(&arena, u64, 0);
+        for (u64 i = 0; i < ARRAY_ELEMENTS; i += ARRAY_LENGTH(chunk)) {
+            array_append(&numbers, chunk, ARRAY_LENGTH(chunk));
+        }
+        bench_sink += numbers.data[numbers.length - 1];
+        arena_clear(&arena);
+    }
+    bench_print("array_append, 64 elements at a time", ARRAY_ROUNDS*ARRAY_ELEMENTS, bench_now_ns() - start);
+
+    arena_free(&arena);
+}
+
+#define STRING_MAP_KEYS 200000
+#define STRING_MAP_LOOKUPS (2*1000*1000)
+
+// Keeps track of the bytes allocated by std::unordered_map to compare its memory footprint
+static u64 counting_allocator_bytes;
+
+template <typename T>
+struct CountingAllocator {
+    typedef T value_type;
+
+    CountingAllocator() {}
+    template <typename U> CountingAllocator(const CountingAllocator<U>&) {}
+
+    T *allocate(size_t count) {
+        counting_allocator_bytes += sizeof(T)*count;
+        return (T*)malloc(sizeof(T)*count);
+    }
+
+    void deallocate(T *memory, size_t count) {
+        counting_allocator_bytes -= sizeof(T)*count;
+        free(memory);
+    }
+};
+
+template <typename T, typename U> bool operator==(const CountingAllocator<T>&, const CountingAllocator<U>&) { return true; }
+template <typename T, typename U> bool operator!=(const CountingAllocator<T>&, const CountingAllocator<U>&) { return false; }
+
+typedef std::basic_string<char, std::char_traits<char>, CountingAllocator<char>> CountedString;
+
+// Both maps use string_hash(), so the benchmark compares the tables and not the hash functions
+struct CountedStringHash {
+    size_t operator()(const CountedString &key) const {
+        String str = { (const u8*)key.data(), (u64)key.size() };
+        return (size_t)string_hash(str);
+    }
+};
+
+static void bench_string_map() {
+    Arena arena = arena_alloc(GiB);
+
+    // Keys similar to header names or configuration keys
+    String *keys = arena_push_nozero(&arena, String, STRING_MAP_KEYS);
+    std::vector<std::string> std_keys;
+    for (u64 i = 0; i < STRING_MAP_KEYS; i++) {
+        char *key = arena_push_nozero(&arena, char, 64);
+        int length = snprintf(key, 64, "server.section-%llu.option", (unsigned long long)i);
+        keys[i] = (String){ (const u8*)key, (u64)length };
+        std_keys.push_back(std::string(key, (size_t)length));
+    }
+
+    u32 *lookups = arena_push_nozero(&arena, u32, STRING_MAP_LOOKUPS);
+    u64 state = 3;
+    for (u64 i = 0; i < STRING_MAP_LOOKUPS; i++) {
+        state = state*6364136223846793005ull + 1442695040888963407ull;
+        lookups[i] = (u32)((state >> 33) % STRING_MAP_KEYS);
+    }
+
+    {
+        typedef CountingAllocator<std::pair<const CountedString, u64>> EntryAllocator;
+        std::unordered_map<CountedString, u64, CountedStringHash, std::equal_to<CountedString>, EntryAllocator> map;
+
+        u64 start = bench_now_ns();
+        for (u64 i = 0; i < STRING_MAP_KEYS; i++) {
+            map[CountedString(std_keys[i].data(), std_keys[i].size())] = i;
+        }
+        bench_print("std::unordered_map<std::string, u64> insert", STRING_MAP_KEYS, bench_now_ns() - start);
+
+        std::vector<CountedString> lookup_keys(std_keys.begin(), std_keys.end());
+        u64 footprint = counting_allocator_bytes;
+        start = bench_now_ns();
+        for (u64 i = 0; i < STRING_MAP_LOOKUPS; i++) {
+            bench_sink += map.find(lookup_keys[lookups[i]])->second;
+        }
+        bench_print("std::unordered_map<std::string, u64> find", STRING_MAP_LOOKUPS, bench_now_ns() - start);
+        printf("%-56s %10.2f MiB (keys included)\n", "std::unordered_map memory", (f64)footprint/MiB);
+    }
+
+    {
+        u64 pos = arena_get_pos(&arena);
+        StringMap<u64> map = string_map_make(&arena, u64, 0);
+
+        u64 start = bench_now_ns();
+        for (u64 i = 0; i < STRING_MAP_KEYS; i++) {
+            string_map_put(&map, keys[i], i);
+        }
+        bench_print("StringMap<u64> insert", STRING_MAP_KEYS, bench_now_ns() - start);
+
+        start = bench_now_ns();
+        for (u64 i = 0; i < STRING_MAP_LOOKUPS; i++) {
+            bench_sink += *string_map_get(&map, keys[lookups[i]]);
+        }
+        bench_print("StringMap<u64> get", STRING_MAP_LOOKUPS, bench_now_ns() - start);
+
+        // The keys were pushed into the arena before the map. Add them to compare with std::unordered_map.
+        u64 key_bytes = 0;
+        for (u64 i = 0; i < STRING_MAP_KEYS; i++) {
+            key_bytes += keys[i].length;
+        }
+        u64 table = (map._capacity + STRING_MAP_GROUP_WIDTH) + map._capacity*sizeof(StringMapSlot<u64>);
+        printf("%-56s %10.2f MiB (keys included)\n", "StringMap memory", (f64)(table + key_bytes)/MiB);
+        printf("%-56s %10.2f MiB (keys included)\n", "StringMap memory, including the tables left by growing", (f64)(arena_get_pos(&arena) - pos + key_bytes)/MiB);
+    }
+
+    arena_free(&arena);
+}
+
+// ####################################################################################################################
+// Snapshots
+
+#define CONFIG_ENTRIES 200000
+#define CONFIG_LOADS 10
+#define CONFIG_LOOKUPS 1000
+
+// Configuration table built in an arena. It only uses RelPtr, so it can be saved into a snapshot.
+typedef struct {
+    RelPtr<u8> key;
+    RelPtr<u8> value;
+    u32 key_length;
+    u32 value_length;
+} ConfigEntry;
+
+typedef struct {
+    u64 count;
+    u64 index_mask;
+    RelPtr<ConfigEntry> entries;
+    RelPtr<u32> index;  // Open-addressing table of entry indices + 1
+} ConfigTable;
+
+static ConfigTable *config_parse(Arena *arena, String file_name) {
+    ConfigTable *table = arena_push(arena, ConfigTable);
+
+    Buffer file = {};
+    TempArena scratch = scratch_begin(&arena, 1);
+    bool ok = read_entire_file(scratch.arena, file_name, &file);
+    assert(ok);
+    UNUSED(ok);
+
+    u64 line_count = 0;
+    for (u64 i = 0; i < file.length; i++) {
+        line_count += file.data[i] == '\n';
+    }
+
+    ConfigEntry *entries = arena_push(arena, ConfigEntry, line_count);
+    u64 index_capacity = 1;
+    while (index_capacity < line_count*2) {
+        index_capacity *= 2;
+    }
+    u32 *index = arena_push(arena, u32, index_capacity);
+    rel_ptr_set(&table->entries, entries);
+    rel_ptr_set(&table->index, index);
+    table->index_mask = index_capacity - 1;
+
+    // Lines are "key = value"
+    u64 line_start = 0;
+    for (u64 i = 0; i < file.length; i++) {
+        if (file.data[i] != '\n') {
+            continue;
+        }
+
+        String line = { file.data + line_start, i - line_start };
+        line_start = i + 1;
+        u64 separator = 0;
+        while (separator + 3 <= line.length && memcmp(line.data + separator, " = ", 3) != 0) {
+            separator++;
+        }
+        String key = string_slice(line, 0, separator);
+        String value = string_slice(line, separator + 3, line.length);
+
+        ConfigEntry *entry = &entries[table->count];
+        u8 *key_copy = arena_push_nozero(arena, u8, key.length);
+        u8 *value_copy = arena_push_nozero(arena, u8, value.length);
+        memcpy(key_copy, key.data, key.length);
+        memcpy(value_copy, value.data, value.length);
+        rel_ptr_set(&entry->key, key_copy);
+        rel_ptr_set(&entry->value, value_copy);
+        entry->key_length = (u32)key.length;
+        entry->value_length = (u32)value.length;
+
+        u64 slot = string_hash(key) & table->index_mask;
+        while (index[slot] != 0) {
+            slot = (slot + 1) & table->index_mask;
+        }
+        index[slot] = (u32)table->count + 1;
+        table->count += 1;
+    }
+
+    scratch_end(scratch);
+    return table;
+}
+
+static String config_get(ConfigTable *table, String key) {
+    ConfigEntry *entries = rel_ptr_get(&table->entries);
+    u32 *index = rel_ptr_get(&table->index);
+    for (u64 slot = string_hash(key) & table->index_mask; index[slot] != 0; slot = (slot + 1) & table->index_mask) {
+        ConfigEntry *entry = &entries[index[slot] - 1];
+        String entry_key = { rel_ptr_get(&entry->key), entry->key_length };
+        if (string_equals(entry_key, key)) {
+            String value = { rel_ptr_get(&entry->value), entry->value_length };
+            return value;
+        }
+    }
+    String empty = {};
+    return empty;
+}
+
+static u64 config_lookups(ConfigTable *table) {
+    u64 found = 0;
+    for (u64 i = 0; i < CONFIG_LOOKUPS; i++) {
+        char key[64];
+        int length = snprintf(key, sizeof(key), "service.section%llu.option", (unsigned long long)(i*197 % CONFIG_ENTRIES));
+        String str = { (const u8*)key, (u64)length };
+        found += config_get(table, str).length > 0;
+    }
+    assert(found == CONFIG_LOOKUPS);
+    return found;
+}
+
+static void bench_snapshot() {
+    // The files are in the page cache, so this measures the CPU work at startup and not the disk
+    String config_file = S("arena_bench_config.txt");
+    String snapshot_file = S("arena_bench_config.snapshot");
+    FILE *file = fopen("arena_bench_config.txt", "wb");
+    for (u64 i = 0; i < CONFIG_ENTRIES; i++) {
+        fprintf(file, "service.section%llu.option = value of the option number %llu\n", (unsigned long long)i, (unsigned long long)i);
+    }
+    fclose(file);
+
+    // Saved before the clock starts, so writing the snapshot isn't counted as parsing
+    Arena snapshot_arena = arena_alloc(GiB);
+    config_parse(&snapshot_arena, config_file);
+    bool saved = arena_snapshot_save(&snapshot_arena, snapshot_file, 1);
+    assert(saved);
+    UNUSED(saved);
+    arena_free(&snapshot_arena);
+
+    u64 start = bench_now_ns();
+    for (u64 i = 0; i < CONFIG_LOADS; i++) {
+        Arena arena = arena_alloc(GiB);
+        bench_sink += config_lookups(config_parse(&arena, config_file));
+        arena_free(&arena);
+    }
+    bench_print_duration("parse text and look up 1000 keys", CONFIG_LOADS, bench_now_ns() - start);
+
+    bool verify[] = { true, false };
+    const char *names[] = { "load snapshot and look up 1000 keys", "load snapshot, no checksum, and look up 1000 keys" };
+    for (u64 v = 0; v < ARRAY_LENGTH(verify); v++) {
+        start = bench_now_ns();
+        for (u64 i = 0; i < CONFIG_LOADS; i++) {
+            Arena arena = {};
+            bool ok = arena_snapshot_load(&arena, snapshot_file, 1, GiB, verify[v]);
+            assert(ok);
+            UNUSED(ok);
+            bench_sink += config_lookups((ConfigTable*)arena_snapshot_get_root(&arena));
+            arena_free(&arena);
+        }
+        bench_print_duration(names[v], CONFIG_LOADS, bench_now_ns() - start);
+    }
+
+    remove("arena_bench_config.txt");
+    remove("arena_bench_config.snapshot");
+}
+
+// ####################################################################################################################
+// Debug mode
+
+#define DEBUG_ARENA_ITERATIONS (200*1000)
+
+// Temporary pushes of a few KiB that are released right away, like most uses of scratch arenas
+static void bench_debug_arena(const char *name, u32 flags) {
+    ArenaParams params = {};
+    params.capacity = GiB;
+    params.flags = flags;
+    Arena arena = arena_alloc_params(params);
+    arena_push(&arena, u8, 100);
+
+    u64 start = bench_now_ns();
+    for (u64 i = 0; i < DEBUG_ARENA_ITERATIONS; i++) {
+        TempArena temp = temp_arena_begin(&arena);
+        u64 count = 64 + (i % 8)*1024;
+        u8 *bytes = arena_push_nozero(&arena, u8, count);
+        bytes[count - 1] = (u8)i;
+        u64 *numbers = arena_push(&arena, u64, 256);
+        bench_sink += bytes[count - 1] + numbers[255];
+        temp_arena_end(temp);
+    }
+    bench_print(name, DEBUG_ARENA_ITERATIONS, bench_now_ns() - start);
+
+    arena_free(&arena);
+}
+
+int main(void) {
+    bench_print_header("Huge pages: random reads over 1 GiB");
+    bench_random_access("regular pages", 0);
+    bench_random_access("huge pages", ARENA_FLAG_HUGE_PAGES);
+
+    bench_print_header("Shared arena: 32-byte pushes from several threads");
+    u32 max_threads = MIN(get_cpu_count(), 64);
+    for (u32 thread_count = 1; thread_count <= max_threads; thread_count *= 2) {
+        bench_shared_arena_push(thread_count);
+    }
+    if ((max_threads & (max_threads - 1)) != 0) {
+        bench_shared_arena_push(max_threads);
+    }
+
+    bench_print_header("Pool: release and push with 10000 live objects of 128 bytes");
+    bench_pool_churn();
+
+    bench_print_header("Heap: release + push with 20000 live allocations of 16 B to 64 KiB");
+    bench_heap();
+
+    bench_print_header("STL containers: 200000 elements per container");
+    bench_containers();
+
+    bench_print_header("Dynamic array: 1000000 elements of 8 bytes");
+    bench_array();
+
+    bench_print_header("Hash map: 200000 string keys, 2000000 random lookups");
+    bench_string_map();
+
+    bench_print_header("Snapshots: startup with a configuration of 200000 entries");
+    bench_snapshot();
+
+    bench_print_header("Debug mode: temporary pushes of up to 9 KiB released right away");
+    bench_debug_arena("regular arena", 0);
+    bench_debug_arena("debug arena", ARENA_FLAG_DEBUG);
+
+    return 0;
+}
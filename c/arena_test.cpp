@@ -1,3 +1,4 @@
+#include <stdio.h>
 #include <string.h>
 
 #ifdef _WIN32
@@ -5,12 +6,19 @@
 #    include <windows.h>
 #elif __linux__
 #   include <fcntl.h>
+#   include <setjmp.h>
+#   include <signal.h>
 #   include <sys/mman.h>
 #   include <sys/stat.h>
 #   include <sys/types.h>
 #   include <unistd.h>
 #endif
 
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "arena_allocator.h"
 #include "basic.h"
 #include "test_suite.cpp"
 
@@ -31,6 +39,14 @@ static u64 get_page_size() {
 #endif
 }
 
+static u64 get_huge_page_size() {
+#ifdef __linux__
+    return ARENA_HUGE_PAGE_SIZE;
+#else
+    return get_page_size();
+#endif
+}
+
 static void test_push_primitive_types(void *context) {
     UNUSED(context);
     Arena arena = arena_alloc(ARENA_CAPACITY);
@@ -393,6 +409,820 @@ static void test_reallocate_buffer_instead_of_growing(void *context) {
     arena_free(&arena);
 }
 
+static void test_temp_arena_restores_position(void *context) {
+    UNUSED(context);
+    Arena arena = arena_alloc(ARENA_CAPACITY);
+    arena_push(&arena, u64);
+    u64 pos_before = arena_get_pos(&arena);
+
+    TempArena temp = temp_arena_begin(&arena);
+    arena_push(&arena, u8, 5000);
+    EXPECT(arena_get_pos(&arena) > pos_before);
+    temp_arena_end(temp);
+
+    EXPECT(arena_get_pos(&arena) == pos_before);
+    arena_free(&arena);
+}
+
+static void test_scratch_is_reused_and_rewound(void *context) {
+    UNUSED(context);
+
+    TempArena scratch = scratch_begin(0, 0);
+    Arena *scratch_arena = scratch.arena;
+    u64 pos_start = arena_get_pos(scratch_arena);
+    u32 *a = arena_push(scratch_arena, u32, 1024);
+    scratch_end(scratch);
+    EXPECT(arena_get_pos(scratch_arena) == pos_start);
+
+    // The same memory is handed back the next time, so no new memory has to be reserved
+    scratch = scratch_begin(0, 0);
+    EXPECT(scratch.arena == scratch_arena);
+    u32 *b = arena_push(scratch.arena, u32, 1024);
+    EXPECT(a == b);
+    scratch_end(scratch);
+}
+
+static void test_scratch_avoids_conflicts(void *context) {
+    UNUSED(context);
+
+    // Nested scratch arenas must not alias the arena used by the outer scope
+    TempArena outer = scratch_begin(0, 0);
+    TempArena inner = scratch_begin(&outer.arena, 1);
+    EXPECT(inner.arena != outer.arena);
+
+    u64 outer_pos = arena_get_pos(outer.arena);
+    arena_push(inner.arena, u8, 4096);
+    EXPECT(arena_get_pos(outer.arena) == outer_pos);
+
+    // Conflicting with a regular arena doesn't exclude any scratch arena
+    Arena arena = arena_alloc(ARENA_CAPACITY);
+    Arena *conflicts[] = { &arena, inner.arena };
+    TempArena other = scratch_begin(conflicts, ARRAY_LENGTH(conflicts));
+    EXPECT(other.arena == outer.arena);
+    scratch_end(other);
+
+    scratch_end(inner);
+    scratch_end(outer);
+    arena_free(&arena);
+}
+
+static Arena growable_arena_alloc(u64 capacity) {
+    ArenaParams params = {};
+    params.capacity = capacity;
+    params.flags = ARENA_FLAG_GROWABLE;
+    return arena_alloc_params(params);
+}
+
+static void test_growable_arena_chains_blocks(void *context) {
+    UNUSED(context);
+    u64 page_size = get_page_size();
+    Arena arena = growable_arena_alloc(page_size);
+    u64 initial_capacity = arena_get_capacity(&arena);
+
+    // Push much more memory than the capacity of the first block and check no data is overwritten
+    u32 *arrays[64];
+    for (u32 i = 0; i < ARRAY_LENGTH(arrays); i++) {
+        arrays[i] = arena_push(&arena, u32, 1000);
+        for (u32 j = 0; j < 1000; j++) {
+            arrays[i][j] = i;
+        }
+    }
+
+    EXPECT(arena_get_capacity(&arena) > initial_capacity);
+    for (u32 i = 0; i < ARRAY_LENGTH(arrays); i++) {
+        EXPECT(arrays[i][0] == i);
+        EXPECT(arrays[i][999] == i);
+    }
+
+    // Pushing something bigger than the next block doubling the previous one also works
+    u8 *big = arena_push(&arena, u8, 100*page_size);
+    FILL_ARRAY_WITH_GARBAGE(big, 100*page_size);
+
+    arena_free(&arena);
+
+    Arena arena_zero = {};
+    EXPECT(memcmp(&arena, &arena_zero, sizeof(Arena)) == 0);
+}
+
+static void test_growable_arena_set_pos_across_blocks(void *context) {
+    UNUSED(context);
+    u64 page_size = get_page_size();
+    Arena arena = growable_arena_alloc(page_size);
+    u64 pos_start = arena_get_pos(&arena);
+
+    u64 *a = arena_push(&arena, u64);
+    *a = 1234;
+    u64 pos_after_a = arena_get_pos(&arena);
+
+    for (u64 i = 0; i < 10; i++) {
+        arena_push(&arena, u8, page_size);
+    }
+    u64 pos_after_blocks = arena_get_pos(&arena);
+    EXPECT(pos_after_blocks > pos_after_a);
+
+    // Positions keep increasing across blocks and going back to a previous block releases the blocks after it
+    arena_set_pos(&arena, pos_after_a);
+    EXPECT(arena_get_pos(&arena) == pos_after_a);
+    EXPECT(arena_get_capacity(&arena) == page_size);
+    EXPECT(*a == 1234);
+
+    // The next push after the rewind lands right after a, in the first block
+    u64 *b = arena_push(&arena, u64);
+    EXPECT(b == a + 1);
+
+    arena_clear(&arena);
+    EXPECT(arena_get_pos(&arena) == pos_start);
+    arena_free(&arena);
+}
+
+static void test_growable_arena_grow_across_blocks(void *context) {
+    UNUSED(context);
+    u64 page_size = get_page_size();
+    Arena arena = growable_arena_alloc(page_size);
+
+    // The buffer is the last element pushed, but there is no room left to grow it in the current block. It must be cloned
+    // into the next block transparently.
+    u64 count = page_size/sizeof(u64) - 1;
+    u64 *buffer = arena_push(&arena, u64, count);
+    for (u64 i = 0; i < count; i++) {
+        buffer[i] = i;
+    }
+
+    u64 *grown = arena_grow_in_place_or_realloc(&arena, u64, buffer, count, 4*count);
+    EXPECT(grown != buffer);
+    for (u64 i = 0; i < count; i++) {
+        EXPECT(grown[i] == i);
+    }
+    for (u64 i = count; i < 4*count; i++) {
+        grown[i] = i;
+    }
+
+    // Now it's the last element of the new block, so it grows in place
+    u64 *grown_again = arena_grow_in_place_or_realloc(&arena, u64, grown, 4*count, 5*count);
+    EXPECT(grown_again == grown);
+
+    arena_free(&arena);
+}
+
+#ifdef __linux__
+static u64 count_resident_pages(void *start, u64 size) {
+    u64 page_size = get_page_size();
+    u64 page_count = size/page_size;
+    static unsigned char residency[4096];
+    assert(page_count <= ARRAY_LENGTH(residency));
+
+    mincore(start, size, residency);
+    u64 resident = 0;
+    for (u64 i = 0; i < page_count; i++) {
+        resident += residency[i] & 1;
+    }
+    return resident;
+}
+
+static void test_decommit_above_retained_size(void *context) {
+    UNUSED(context);
+    u64 page_size = get_page_size();
+
+    ArenaParams params = {};
+    params.capacity = ARENA_CAPACITY;
+    params.flags = ARENA_FLAG_DECOMMIT;
+    params.retain_size = 16*page_size;
+    params.decommit_threshold = 64*page_size;
+    Arena arena = arena_alloc_params(params);
+
+    u64 size = 1024*page_size;
+    u8 *memory = arena_push_nozero(&arena, u8, size);
+    FILL_ARRAY_WITH_GARBAGE(memory, size);
+    EXPECT(count_resident_pages(memory, size) == 1024);
+
+    // Going back less than the threshold keeps the pages committed
+    arena_set_pos(&arena, size - 32*page_size);
+    EXPECT(count_resident_pages(memory, size) == 1024);
+
+    // Clearing the arena only keeps the retained pages
+    arena_clear(&arena);
+    EXPECT(count_resident_pages(memory, size) == 16);
+
+    // Decommitted pages are committed again as usual and arena_push() zeroes them
+    u8 *memory_again = arena_push(&arena, u8, size);
+    EXPECT(memory_again == memory);
+    EXPECT(memory_again[size - 1] == 0);
+    FILL_ARRAY_WITH_GARBAGE(memory_again, size);
+
+    arena_free(&arena);
+}
+
+// Debug mode only makes released pages inaccessible, but they must still be decommitted with a decommit policy
+static void test_debug_arena_decommits_released_pages(void *context) {
+    UNUSED(context);
+    u64 page_size = get_page_size();
+
+    u32 decommit_flags[] = { ARENA_FLAG_DECOMMIT, ARENA_FLAG_DECOMMIT_LAZY };
+    for (u64 i = 0; i < ARRAY_LENGTH(decommit_flags); i++) {
+        ArenaParams params = {};
+        params.capacity = ARENA_CAPACITY;
+        params.flags = ARENA_FLAG_DEBUG | decommit_flags[i];
+        params.retain_size = 16*page_size;
+        params.decommit_threshold = 64*page_size;
+        Arena arena = arena_alloc_params(params);
+
+        u64 size = 1024*page_size;
+        u8 *memory = arena_push_nozero(&arena, u8, size);
+        FILL_ARRAY_WITH_GARBAGE(memory, size);
+        EXPECT(count_resident_pages(memory, size) == 1024);
+
+        arena_set_pos(&arena, size - 32*page_size);
+        EXPECT(count_resident_pages(memory, size) == 1024);
+
+        // Pages freed lazily stay resident until the kernel needs them
+        arena_clear(&arena);
+        if (decommit_flags[i] == ARENA_FLAG_DECOMMIT) {
+            EXPECT(count_resident_pages(memory, size) == 16);
+        }
+#ifdef ARENA_STATS
+        EXPECT(arena_get_stats(&arena).decommit_count == 1);
+#endif
+
+        u8 *memory_again = arena_push(&arena, u8, size);
+        EXPECT(memory_again == memory);
+        EXPECT(memory_again[size - 1] == 0);
+        FILL_ARRAY_WITH_GARBAGE(memory_again, size);
+
+        arena_free(&arena);
+    }
+}
+
+static void test_commit_faults_in_pages(void *context) {
+    UNUSED(context);
+    u64 page_size = get_page_size();
+    Arena arena = arena_alloc(ARENA_CAPACITY);
+
+    u8 *first = arena_push(&arena, u8);
+    u64 size = 512*page_size;
+    arena_commit(&arena, size);
+    EXPECT(count_resident_pages(first, size) == 512);
+
+    // The committed memory is used by the next pushes
+    u8 *memory = arena_push(&arena, u8, size - 1);
+    EXPECT(memory == first + 1);
+    EXPECT(memory[size - 2] == 0);
+
+    arena_free(&arena);
+}
+#endif
+
+static void test_commit_granularity_larger_than_capacity(void *context) {
+    UNUSED(context);
+    u64 page_size = get_page_size();
+
+    // Chunks of committed memory never go past the end of the arena
+    ArenaParams params = {};
+    params.capacity = 3*page_size;
+    params.commit_granularity = 2*MiB;
+    params.flags = ARENA_FLAG_PREFAULT;
+    Arena arena = arena_alloc_params(params);
+
+    u8 *memory = arena_push(&arena, u8, 3*page_size);
+    FILL_ARRAY_WITH_GARBAGE(memory, 3*page_size);
+    arena_commit(&arena, GiB);
+
+    arena_free(&arena);
+}
+
+static void test_commit_granularity_not_power_of_two(void *context) {
+    UNUSED(context);
+    u64 page_size = get_page_size();
+
+    // It's rounded up to 4 pages, so memory is committed in aligned chunks of the same size every time
+    ArenaParams params = {};
+    params.capacity = ARENA_CAPACITY;
+    params.commit_granularity = 3*page_size;
+    Arena arena = arena_alloc_params(params);
+    u64 expected_granularity = (arena._flags & ARENA_FLAG_DEBUG) ? page_size : 4*page_size;
+    EXPECT(arena._commit_granularity == expected_granularity);
+
+    for (u64 i = 0; i < 100; i++) {
+        u8 *memory = arena_push(&arena, u8, page_size/2 + i);
+        FILL_ARRAY_WITH_GARBAGE(memory, page_size/2 + i);
+        EXPECT((u64)arena._next_reserved_page % expected_granularity == 0);
+    }
+
+    arena_free(&arena);
+}
+
+static void test_huge_pages_arena(void *context) {
+    UNUSED(context);
+
+    ArenaParams params = {};
+    params.capacity = 5*MiB;
+    params.flags = ARENA_FLAG_HUGE_PAGES|ARENA_FLAG_GROWABLE|ARENA_FLAG_DECOMMIT;
+    Arena arena = arena_alloc_params(params);
+
+    // The capacity is rounded up to the huge page size in the platforms that support them, and the memory is aligned to it
+    u64 huge_page_size = get_huge_page_size();
+    EXPECT(arena._page_size == huge_page_size);
+    EXPECT(arena_get_capacity(&arena) >= 5*MiB);
+    EXPECT(arena_get_capacity(&arena) % huge_page_size == 0);
+    EXPECT((u64)arena._memory_start % huge_page_size == 0);
+
+    u8 *a = arena_push(&arena, u8, 3*MiB);
+    FILL_ARRAY_WITH_GARBAGE(a, 3*MiB);
+    u8 *b = arena_push(&arena, u8, 7*MiB);
+    FILL_ARRAY_WITH_GARBAGE(b, 7*MiB);
+
+    // b didn't fit in the first block, so it's in a new one, which is aligned too
+    EXPECT(b >= arena._memory_start && b < arena._memory_start + arena._capacity);
+    EXPECT((u64)arena._memory_start % huge_page_size == 0);
+    EXPECT(arena._capacity % huge_page_size == 0);
+
+    arena_clear(&arena);
+    u64 *c = arena_push(&arena, u64, 1000);
+    EXPECT(c[999] == 0);
+
+    arena_free(&arena);
+}
+
+#define STRESS_THREAD_COUNT 4
+#define STRESS_PUSHES_PER_THREAD 20000
+
+typedef struct {
+    ConcurrentArena *arena;
+    u32 thread_index;
+    u8 **pushes;
+    u64 *sizes;
+} ConcurrentArenaStressContext;
+
+static void concurrent_arena_stress_thread(void *arg) {
+    ConcurrentArenaStressContext *context = (ConcurrentArenaStressContext*)arg;
+
+    u64 state = context->thread_index + 1;
+    for (u64 i = 0; i < STRESS_PUSHES_PER_THREAD; i++) {
+        // Mix small pushes served by the chunks of the thread with big pushes reserved directly from the shared position
+        state = state*6364136223846793005ull + 1442695040888963407ull;
+        u64 size = (state >> 33) % 64 + 1;
+        if (i % 500 == 0) {
+            size = 3*CONCURRENT_ARENA_CHUNK_SIZE/4;
+        }
+
+        u8 *memory = i % 2 == 0 ? arena_push(context->arena, u8, size) : (u8*)arena_push_nozero(context->arena, u64, (size + 7)/8);
+        memset(memory, (int)context->thread_index, size);
+        context->pushes[i] = memory;
+        context->sizes[i] = size;
+    }
+}
+
+static void test_concurrent_arena_stress(void *context) {
+    UNUSED(context);
+    Arena arena = arena_alloc(ARENA_CAPACITY);
+    ConcurrentArena concurrent_arena = concurrent_arena_alloc(ARENA_CAPACITY);
+
+    for (u32 round = 0; round < 2; round++) {
+        Thread threads[STRESS_THREAD_COUNT];
+        ConcurrentArenaStressContext contexts[STRESS_THREAD_COUNT];
+        for (u32 i = 0; i < STRESS_THREAD_COUNT; i++) {
+            contexts[i].arena = &concurrent_arena;
+            contexts[i].thread_index = i;
+            contexts[i].pushes = arena_push(&arena, u8*, STRESS_PUSHES_PER_THREAD);
+            contexts[i].sizes = arena_push(&arena, u64, STRESS_PUSHES_PER_THREAD);
+            threads[i] = thread_create(concurrent_arena_stress_thread, &contexts[i]);
+        }
+
+        for (u32 i = 0; i < STRESS_THREAD_COUNT; i++) {
+            thread_join(threads[i]);
+        }
+
+        // If two pushes overlapped, one thread would have overwritten the memory of another one
+        for (u32 i = 0; i < STRESS_THREAD_COUNT; i++) {
+            for (u64 j = 0; j < STRESS_PUSHES_PER_THREAD; j++) {
+                u8 *memory = contexts[i].pushes[j];
+                EXPECT(memory[0] == i);
+                EXPECT(memory[contexts[i].sizes[j] - 1] == i);
+                if (j % 2 == 1) {
+                    EXPECT((u64)memory % alignof(u64) == 0);
+                }
+            }
+        }
+
+        EXPECT(concurrent_arena_get_pos(&concurrent_arena) > 0);
+        concurrent_arena_clear(&concurrent_arena);
+        EXPECT(concurrent_arena_get_pos(&concurrent_arena) == 0);
+        arena_clear(&arena);
+    }
+
+    // Memory of a cleared arena is zeroed again by arena_push()
+    u64 *value = arena_push(&concurrent_arena, u64);
+    EXPECT(*value == 0);
+
+    concurrent_arena_free(&concurrent_arena);
+    arena_free(&arena);
+}
+
+typedef struct {
+    u64 id;
+    u8 flags;
+} PoolTestObject;
+
+static void test_pool_reuses_released_objects(void *context) {
+    UNUSED(context);
+    Arena arena = arena_alloc(ARENA_CAPACITY);
+    Pool pool = pool_make(&arena, PoolTestObject, 4);
+
+    PoolTestObject *objects[10];
+    for (u64 i = 0; i < ARRAY_LENGTH(objects); i++) {
+        objects[i] = pool_push(&pool, PoolTestObject);
+        EXPECT(objects[i]->id == 0);
+        EXPECT((u64)objects[i] % alignof(PoolTestObject) == 0);
+        objects[i]->id = i;
+    }
+
+    // Objects don't overlap, even across slabs
+    for (u64 i = 0; i < ARRAY_LENGTH(objects); i++) {
+        EXPECT(objects[i]->id == i);
+    }
+
+    // Released objects are reused in LIFO order and the arena doesn't grow
+    u64 pos = arena_get_pos(&arena);
+    pool_release(&pool, objects[3]);
+    pool_release(&pool, objects[7]);
+    PoolTestObject *a = pool_push(&pool, PoolTestObject);
+    PoolTestObject *b = pool_push_nozero(&pool, PoolTestObject);
+    EXPECT(a == objects[7]);
+    EXPECT(b == objects[3]);
+    EXPECT(a->id == 0);
+    EXPECT(arena_get_pos(&arena) == pos);
+
+    arena_free(&arena);
+}
+
+static void test_pool_of_small_objects(void *context) {
+    UNUSED(context);
+    Arena arena = arena_alloc(ARENA_CAPACITY);
+
+    // Objects smaller than a pointer still have room for the free list
+    Pool pool = pool_make(&arena, u8, 16);
+    u8 *a = pool_push(&pool, u8);
+    u8 *b = pool_push(&pool, u8);
+    EXPECT(b - a >= (i64)sizeof(void*));
+
+    pool_release(&pool, a);
+    pool_release(&pool, b);
+    EXPECT(pool_push(&pool, u8) == b);
+    EXPECT(pool_push(&pool, u8) == a);
+
+    arena_free(&arena);
+}
+
+static void test_heap_reuses_released_memory(void *context) {
+    UNUSED(context);
+    Heap heap = heap_alloc(ARENA_CAPACITY);
+
+    u64 *a = heap_push(&heap, u64, 10);
+    u64 *b = heap_push(&heap, u64, 10);
+    u64 *c = heap_push(&heap, u64, 10);
+    EXPECT(a[9] == 0 && b[9] == 0 && c[9] == 0);
+    EXPECT((u64)a % HEAP_ALIGNMENT == 0);
+
+    // Released blocks are merged with their free neighbours, so a bigger allocation fits in the space of a, b and c
+    heap_release(&heap, a);
+    heap_release(&heap, c);
+    heap_release(&heap, b);
+    EXPECT(heap_get_stats(&heap).used_size == 0);
+
+    u64 *d = heap_push_nozero(&heap, u64, 30);
+    EXPECT(d == a);
+
+    heap_release(&heap, d);
+    heap_free(&heap);
+
+    Heap heap_zero = {};
+    EXPECT(memcmp(&heap, &heap_zero, sizeof(Heap)) == 0);
+}
+
+static void test_heap_big_alignment(void *context) {
+    UNUSED(context);
+    Heap heap = heap_alloc(ARENA_CAPACITY);
+
+    u8 *small = heap_push(&heap, u8, 24);
+    u8 *page = (u8*)heap_push_data(&heap, 4096, 4096, 1);
+    u8 *after = heap_push(&heap, u8, 24);
+    EXPECT((u64)page % 4096 == 0);
+    FILL_ARRAY_WITH_GARBAGE(page, 4096);
+    small[23] = 1;
+    after[0] = 2;
+    EXPECT(small[23] == 1);
+    EXPECT(after[0] == 2);
+
+    heap_release(&heap, page);
+    heap_release(&heap, small);
+    heap_release(&heap, after);
+    EXPECT(heap_get_stats(&heap).used_size == 0);
+
+    heap_free(&heap);
+}
+
+static void test_heap_random_pushes_and_releases(void *context) {
+    UNUSED(context);
+    Heap heap = heap_alloc(ARENA_CAPACITY);
+
+    // Keep a set of live allocations filled with a byte that identifies them. If two of them ever overlapped, or the heap
+    // wrote its metadata inside a used block, the contents would be wrong when they are released.
+    u8 *live[256] = {};
+    u64 sizes[256] = {};
+    u64 state = 42;
+    for (u64 i = 0; i < 100000; i++) {
+        state = state*6364136223846793005ull + 1442695040888963407ull;
+        u64 index = (state >> 33) % ARRAY_LENGTH(live);
+
+        if (live[index] != 0) {
+            EXPECT(live[index][0] == (u8)index);
+            EXPECT(live[index][sizes[index] - 1] == (u8)index);
+            heap_release(&heap, live[index]);
+            live[index] = 0;
+        } else {
+            u64 size = (state >> 40) % 8 == 0 ? (state >> 20) % (64*KiB) + 1 : (state >> 20) % 256 + 1;
+            u64 alignment = (state >> 50) % 16 == 0 ? 256 : 1;
+            live[index] = (u8*)heap_push_data(&heap, size, alignment, 0);
+            EXPECT((u64)live[index] % alignment == 0);
+            memset(live[index], (int)index, size);
+            sizes[index] = size;
+        }
+    }
+
+    for (u64 i = 0; i < ARRAY_LENGTH(live); i++) {
+        if (live[i] != 0) {
+            EXPECT(live[i][0] == (u8)i);
+            heap_release(&heap, live[i]);
+        }
+    }
+    EXPECT(heap_get_stats(&heap).used_size == 0);
+
+    heap_free(&heap);
+}
+
+static void test_arena_allocator_std_vector(void *context) {
+    UNUSED(context);
+    Arena arena = arena_alloc(ARENA_CAPACITY);
+
+    {
+        ArenaAllocator<u64> allocator(&arena);
+        std::vector<u64, ArenaAllocator<u64>> numbers(allocator);
+        for (u64 i = 0; i < 10000; i++) {
+            numbers.push_back(i);
+        }
+        for (u64 i = 0; i < numbers.size(); i++) {
+            EXPECT(numbers[i] == i);
+        }
+        EXPECT((u8*)numbers.data() >= arena._memory_start);
+        EXPECT((u8*)(numbers.data() + numbers.size()) <= arena._position);
+    }
+
+    // The last buffer of the vector was the last element of the arena, so it's given back when the vector is destroyed
+    u64 pos = arena_get_pos(&arena);
+    ArenaAllocator<u64> allocator(&arena);
+    u64 *buffer = allocator.allocate(16);
+    allocator.deallocate(buffer, 16);
+    EXPECT(arena_get_pos(&arena) == pos);
+
+    // Grow in place while the buffer is the last element, and reallocate when it isn't
+    buffer = allocator.allocate(16);
+    buffer[15] = 15;
+    u64 *grown = allocator.reallocate(buffer, 16, 32);
+    EXPECT(grown == buffer);
+    ArenaAllocator<u8>(allocator).allocate(1);
+    grown = allocator.reallocate(buffer, 32, 64);
+    EXPECT(grown != buffer);
+    EXPECT(grown[15] == 15);
+
+    arena_free(&arena);
+}
+
+#ifdef ARENA_MEMORY_RESOURCE
+static void test_arena_memory_resource_pmr_containers(void *context) {
+    UNUSED(context);
+    Arena arena = arena_alloc(ARENA_CAPACITY);
+    ArenaMemoryResource resource(&arena);
+
+    {
+        std::pmr::unordered_map<u64, std::pmr::string> names(&resource);
+        for (u64 i = 0; i < 1000; i++) {
+            names[i] = std::pmr::string(std::to_string(i) + " is a number long enough to not fit in place", &resource);
+        }
+
+        EXPECT(names.size() == 1000);
+        EXPECT(names[123] == "123 is a number long enough to not fit in place");
+        EXPECT((u8*)names[123].data() >= arena._memory_start);
+        EXPECT((u8*)names[123].data() < arena._position);
+        EXPECT(names.get_allocator().resource()->is_equal(resource));
+
+        u64 pos = arena_get_pos(&arena);
+        std::pmr::vector<u8> bytes(MiB, 0, &resource);
+        EXPECT(arena_get_pos(&arena) >= pos + MiB);
+    }
+
+    arena_free(&arena);
+}
+#endif
+
+#if defined(__linux__) && !defined(__SANITIZE_ADDRESS__)
+static sigjmp_buf fault_jump;
+
+static void fault_handler(int signal) {
+    UNUSED(signal);
+    siglongjmp(fault_jump, 1);
+}
+
+// Returns true if reading the address raises a segmentation fault
+static bool address_faults(volatile u8 *address) {
+    struct sigaction action = {};
+    struct sigaction prev_action = {};
+    action.sa_handler = fault_handler;
+    sigaction(SIGSEGV, &action, &prev_action);
+
+    // @NOTE: volatile because it changes between sigsetjmp() and siglongjmp(), so otherwise its value is indeterminate
+    volatile bool faults = true;
+    if (sigsetjmp(fault_jump, 1) == 0) {
+        u8 value = *address;
+        UNUSED(value);
+        faults = false;
+    }
+
+    sigaction(SIGSEGV, &prev_action, 0);
+    return faults;
+}
+
+static void test_debug_arena_poisons_released_memory(void *context) {
+    UNUSED(context);
+    u64 page_size = get_page_size();
+
+    ArenaParams params = {};
+    params.capacity = 16*page_size;
+    params.flags = ARENA_FLAG_DEBUG;
+    Arena arena = arena_alloc_params(params);
+
+    u8 *kept = arena_push(&arena, u8, 100);
+    memset(kept, 1, 100);
+    TempArena temp = temp_arena_begin(&arena);
+    u8 *released = arena_push_nozero(&arena, u8, 3*page_size);
+    memset(released, 2, 3*page_size);
+    temp_arena_end(temp);
+
+    // The released bytes in the page that is still in use are filled with the poison byte, and the pages that were
+    // released entirely can't be accessed
+    EXPECT(kept[99] == 1);
+    EXPECT(released[0] == ARENA_DEBUG_POISON_BYTE);
+    EXPECT(released[page_size - 101] == ARENA_DEBUG_POISON_BYTE);
+    EXPECT(address_faults(released + page_size - 100));
+    EXPECT(address_faults(released + 3*page_size - 1));
+
+    // Pushing again makes the memory accessible
+    u8 *pushed = arena_push(&arena, u8, 2*page_size);
+    EXPECT(pushed == released);
+    EXPECT(pushed[2*page_size - 1] == 0);
+
+    // Pages are committed one at a time, so the page after the last pushed byte is a guard page
+    EXPECT(address_faults(pushed + 3*page_size - 100));
+
+    // There's a guard page at the end of the arena, even when it's full
+    arena_push_nozero(&arena, u8, arena_get_capacity(&arena) - arena_get_pos(&arena));
+    EXPECT(address_faults(arena._memory_start + arena._capacity));
+
+    arena_free(&arena);
+}
+#endif
+
+typedef struct SnapshotNode SnapshotNode;
+struct SnapshotNode {
+    u64 value;
+    RelPtr<SnapshotNode> next;
+};
+
+typedef struct {
+    RelPtr<SnapshotNode> first;
+    RelPtr<u8> name;
+    u64 name_length;
+} SnapshotRoot;
+
+static bool snapshot_list_is_valid(SnapshotRoot *root) {
+    String name = { rel_ptr_get(&root->name), root->name_length };
+    bool ok = string_equals(name, S("numbers"));
+
+    u64 expected = 0;
+    for (SnapshotNode *node = rel_ptr_get(&root->first); node != 0; node = rel_ptr_get(&node->next)) {
+        ok = ok && node->value == expected;
+        expected += 1;
+    }
+    return ok && expected == 1000;
+}
+
+static void test_arena_snapshot_round_trip(void *context) {
+    UNUSED(context);
+    String file_name = S("arena_snapshot_test.bin");
+
+    Arena arena = arena_alloc(ARENA_CAPACITY);
+    SnapshotRoot *root = arena_push(&arena, SnapshotRoot);
+    u8 *name = arena_push_nozero(&arena, u8, 7);
+    memcpy(name, "numbers", 7);
+    rel_ptr_set(&root->name, name);
+    root->name_length = 7;
+
+    RelPtr<SnapshotNode> *link = &root->first;
+    for (u64 i = 0; i < 1000; i++) {
+        SnapshotNode *node = arena_push(&arena, SnapshotNode);
+        node->value = i;
+        rel_ptr_set(link, node);
+        link = &node->next;
+    }
+    EXPECT(snapshot_list_is_valid(root));
+    u64 snapshot_size = arena_get_pos(&arena);
+    EXPECT(arena_snapshot_save(&arena, file_name, 7));
+    arena_free(&arena);
+
+    // Load it twice, so it's mapped at two different addresses at the same time
+    Arena a = {};
+    Arena b = {};
+    EXPECT(arena_snapshot_load(&a, file_name, 7, ARENA_CAPACITY, true));
+    EXPECT(arena_snapshot_load(&b, file_name, 7, ARENA_CAPACITY, false));
+    EXPECT(arena_snapshot_get_root(&a) != arena_snapshot_get_root(&b));
+    EXPECT(snapshot_list_is_valid((SnapshotRoot*)arena_snapshot_get_root(&a)));
+    EXPECT(snapshot_list_is_valid((SnapshotRoot*)arena_snapshot_get_root(&b)));
+
+    // Loaded arenas are regular arenas, and writing to one of them doesn't change the other one
+    EXPECT(arena_get_pos(&a) == snapshot_size);
+    u64 *after = arena_push(&a, u64, 1000);
+    EXPECT(after[999] == 0);
+    ((SnapshotRoot*)arena_snapshot_get_root(&a))->name_length = 3;
+    EXPECT(snapshot_list_is_valid((SnapshotRoot*)arena_snapshot_get_root(&b)));
+
+    arena_free(&a);
+    arena_free(&b);
+
+    // Wrong version, not enough capacity or files that don't exist
+    Arena c = {};
+    EXPECT(!arena_snapshot_load(&c, file_name, 8, ARENA_CAPACITY, true));
+    EXPECT(!arena_snapshot_load(&c, S("this_file_does_not_exist.bin"), 7, ARENA_CAPACITY, true));
+    EXPECT(!arena_snapshot_load(&c, file_name, 7, snapshot_size/2, true));
+
+    // Corrupt one byte of the data. The checksum catches it.
+    FILE *file = fopen("arena_snapshot_test.bin", "r+b");
+    EXPECT(file != 0);
+    fseek(file, (long)snapshot_size/2, SEEK_SET);
+    fputc(0xAA, file);
+    fclose(file);
+    EXPECT(!arena_snapshot_load(&c, file_name, 7, ARENA_CAPACITY, true));
+    EXPECT(arena_snapshot_load(&c, file_name, 7, ARENA_CAPACITY, false));
+    arena_free(&c);
+
+    remove("arena_snapshot_test.bin");
+}
+
+#ifdef ARENA_STATS
+static void test_arena_stats(void *context) {
+    UNUSED(context);
+    Arena arena = arena_alloc(ARENA_CAPACITY);
+
+    arena_push(&arena, u8);
+    arena_push(&arena, u64, 10);
+    u8 *buffer = arena_push_nozero(&arena, u8, 100);
+    buffer = arena_grow_in_place_or_realloc(&arena, u8, buffer, 100, 200);
+    arena_push(&arena, u8);
+    buffer = arena_grow_in_place_or_realloc(&arena, u8, buffer, 200, 300);
+    u64 peak = arena_get_pos(&arena);
+    arena_clear(&arena);
+    arena_push(&arena, u8);
+
+    ArenaStats stats = arena_get_stats(&arena);
+    EXPECT(stats.peak_pos == peak);
+    EXPECT(stats.push_count == 7);
+    EXPECT(stats.padding_bytes == 7);
+    EXPECT(stats.pushed_bytes == 1 + 80 + 100 + 100 + 1 + 300 + 1);
+    // @NOTE: debug mode makes the pages released by arena_clear() inaccessible, so the last push commits them again
+    EXPECT(stats.commit_count == ((arena._flags & ARENA_FLAG_DEBUG) ? 2 : 1));
+    EXPECT(stats.in_place_growths == 1);
+    EXPECT(stats.reallocations == 1);
+
+#ifdef ARENA_STATS_CALLSITES
+    // The pushes made through the macros are attributed to this file. The growths aren't, because they call
+    // arena_push_data() directly.
+    const ArenaCallsite *callsites = arena_get_callsites(&arena);
+    EXPECT(callsites != 0);
+
+    u64 callsite_count = 0;
+    u64 callsite_bytes = 0;
+    for (u64 i = 0; i < ARENA_STATS_MAX_CALLSITES; i++) {
+        if (callsites[i].file != 0) {
+            EXPECT(strcmp(callsites[i].file, __FILE__) == 0);
+            callsite_count += 1;
+            callsite_bytes += callsites[i].pushed_bytes;
+        }
+    }
+    EXPECT(callsite_count == 5);
+    EXPECT(callsite_bytes == 1 + 80 + 100 + 1 + 1);
+#endif
+
+    arena_free(&arena);
+}
+#endif
+
 int main(void) {
     TestSuite suite = test_suite_new(__FILE__);
     TEST(&suite, test_push_primitive_types);
@@ -406,6 +1236,37 @@ int main(void) {
     TEST(&suite, test_get_set_position_and_clear);
     TEST(&suite, test_grow_buffer_in_place);
     TEST(&suite, test_reallocate_buffer_instead_of_growing);
+    TEST(&suite, test_temp_arena_restores_position);
+    TEST(&suite, test_scratch_is_reused_and_rewound);
+    TEST(&suite, test_scratch_avoids_conflicts);
+    TEST(&suite, test_growable_arena_chains_blocks);
+    TEST(&suite, test_growable_arena_set_pos_across_blocks);
+    TEST(&suite, test_growable_arena_grow_across_blocks);
+#ifdef __linux__
+    TEST(&suite, test_decommit_above_retained_size);
+    TEST(&suite, test_debug_arena_decommits_released_pages);
+    TEST(&suite, test_commit_faults_in_pages);
+#endif
+    TEST(&suite, test_commit_granularity_larger_than_capacity);
+    TEST(&suite, test_commit_granularity_not_power_of_two);
+    TEST(&suite, test_huge_pages_arena);
+    TEST(&suite, test_concurrent_arena_stress);
+    TEST(&suite, test_pool_reuses_released_objects);
+    TEST(&suite, test_pool_of_small_objects);
+    TEST(&suite, test_heap_reuses_released_memory);
+    TEST(&suite, test_heap_big_alignment);
+    TEST(&suite, test_heap_random_pushes_and_releases);
+    TEST(&suite, test_arena_allocator_std_vector);
+#ifdef ARENA_MEMORY_RESOURCE
+    TEST(&suite, test_arena_memory_resource_pmr_containers);
+#endif
+    TEST(&suite, test_arena_snapshot_round_trip);
+#if defined(__linux__) && !defined(__SANITIZE_ADDRESS__)
+    TEST(&suite, test_debug_arena_poisons_released_memory);
+#endif
+#ifdef ARENA_STATS
+    TEST(&suite, test_arena_stats);
+#endif
 
     int errcode = test_suite_run_all_and_print(&suite);
     return errcode;
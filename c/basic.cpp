@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -6,18 +7,42 @@
 #ifdef _WIN32
 #    define _WIN32_LEAN_AND_MEAN
 #    include <windows.h>
+#   pragma comment(lib, "Synchronization.lib")
+#   pragma comment(lib, "onecore.lib")         // VirtualAlloc2() and MapViewOfFile3() for the ring buffer
 #elif __linux__
+#   include <dirent.h>
+#   include <errno.h>
 #   include <fcntl.h>
+#   include <linux/futex.h>
+#   include <linux/io_uring.h>
+#   include <pthread.h>
+#   include <sched.h>
 #   include <sys/mman.h>
 #   include <sys/stat.h>
+#   include <sys/syscall.h>
 #   include <sys/types.h>
+#   include <sys/uio.h>
 #   include <unistd.h>
 #endif
 
+// AddressSanitizer is used by arenas in debug mode to poison released memory
+#if defined(__SANITIZE_ADDRESS__)
+#   define ARENA_ASAN
+#elif defined(__has_feature)
+#   if __has_feature(address_sanitizer)
+#       define ARENA_ASAN
+#   endif
+#endif
+#ifdef ARENA_ASAN
+#   include <sanitizer/asan_interface.h>
+#endif
+
 #include "basic.h"
 
 // ####################################################################################################################
 // Arena
+static u64 get_page_size();
+
 static u8* vm_reserve(u64 size) {
 #ifdef _WIN32
     u8* memory = (u8*)VirtualAlloc(0, size, MEM_RESERVE, PAGE_READWRITE);
@@ -38,6 +63,44 @@ static u8* vm_reserve(u64 size) {
 #endif
 }
 
+// Reserve memory aligned to huge pages. size must be a multiple of ARENA_HUGE_PAGE_SIZE.
+static u8* vm_reserve_huge(u64 size) {
+#ifdef __linux__
+    // Explicit huge pages. mmap fails if the hugetlbfs pool can't back the whole reservation, so we never get a SIGBUS
+    // later when the pages are touched.
+    u8* memory = (u8*)mmap(0, size, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+    if (memory != MAP_FAILED) {
+        return memory;
+    }
+
+    // Transparent huge pages. Reserve an extra huge page so the range can be aligned and release the excess at both ends.
+    u8 *unaligned = vm_reserve(size + ARENA_HUGE_PAGE_SIZE);
+    memory = (u8*)(((u64)unaligned + (ARENA_HUGE_PAGE_SIZE - 1)) & -(u64)ARENA_HUGE_PAGE_SIZE);
+
+    u64 head_size = memory - unaligned;
+    u64 tail_size = ARENA_HUGE_PAGE_SIZE - head_size;
+    if (head_size > 0) {
+        munmap(unaligned, head_size);
+    }
+    if (tail_size > 0) {
+        munmap(memory + size, tail_size);
+    }
+
+    madvise(memory, size, MADV_HUGEPAGE);
+    return memory;
+#else
+    return vm_reserve(size);
+#endif
+}
+
+static u64 get_huge_page_size() {
+#ifdef __linux__
+    return ARENA_HUGE_PAGE_SIZE;
+#else
+    return get_page_size();
+#endif
+}
+
 static void vm_commit_pages(u8 *start, u64 size) {
 #ifdef _WIN32
     if (!VirtualAlloc(start, size, MEM_COMMIT, PAGE_READWRITE)) {
@@ -54,6 +117,60 @@ static void vm_commit_pages(u8 *start, u64 size) {
 #endif
 }
 
+// Fault in committed pages so that accessing them later doesn't cause page faults
+static void vm_prefault_pages(u8 *start, u64 size) {
+#if __linux__ && defined(MADV_POPULATE_WRITE)
+    // Available since Linux 5.14. It populates all the pages with a single syscall.
+    if (madvise(start, size, MADV_POPULATE_WRITE) == 0) {
+        return;
+    }
+#endif
+    // Fallback: write every page. Reading and writing back the same value preserves the contents of the pages.
+    u64 page_size = get_page_size();
+    for (u64 offset = 0; offset < size; offset += page_size) {
+        volatile u8 *byte = start + offset;
+        *byte = *byte;
+    }
+}
+
+static void vm_decommit_pages(u8 *start, u64 size, bool lazy) {
+#ifdef _WIN32
+    // @NOTE: Windows has no lazy equivalent that also makes the pages inaccessible, so both modes decommit right away
+    UNUSED(lazy);
+    VirtualFree(start, size, MEM_DECOMMIT);
+#elif __linux__
+    // Drop the physical pages first and then make the range inaccessible again, so it goes back to the same state as
+    // reserved memory that hasn't been committed yet. MADV_FREE isn't supported by kernels older than 4.5, so fall back to
+    // MADV_DONTNEED if it fails.
+    int advice_ok = -1;
+#ifdef MADV_FREE
+    if (lazy) {
+        advice_ok = madvise(start, size, MADV_FREE);
+    }
+#else
+    UNUSED(lazy);
+#endif
+    if (advice_ok == -1) {
+        madvise(start, size, MADV_DONTNEED);
+    }
+    mprotect(start, size, PROT_NONE);
+#else
+    #error "Not implemented for your platform"
+#endif
+}
+
+// Make committed pages inaccessible without releasing them, so committing them again is cheap and keeps their contents
+static void vm_protect_pages(u8 *start, u64 size) {
+#ifdef _WIN32
+    // @NOTE: committing pages that are already committed doesn't change their protection in Windows, so decommit them
+    VirtualFree(start, size, MEM_DECOMMIT);
+#elif __linux__
+    mprotect(start, size, PROT_NONE);
+#else
+    #error "Not implemented for your platform"
+#endif
+}
+
 static void vm_free_pages(u8 *start, u64 size) {
     // Deallocate memory
 #ifdef _WIN32
@@ -80,21 +197,167 @@ static u64 get_page_size() {
 #endif
 }
 
+struct ArenaBlock {
+    ArenaBlock *prev;
+    u8 *memory_start;
+    u8 *next_reserved_page;
+    u64 capacity;
+    u64 base_pos;
+};
+
+#ifdef ARENA_STATS
+#   define ARENA_STATS_ADD(arena, field, value) ((arena)->_stats.field += (value))
+#   define ARENA_STATS_UPDATE_PEAK(arena) \
+        ((arena)->_stats.peak_pos = MAX((arena)->_stats.peak_pos, arena_get_pos(arena)))
+#else
+#   define ARENA_STATS_ADD(arena, field, value) ((void)0)
+#   define ARENA_STATS_UPDATE_PEAK(arena) ((void)0)
+#endif
+
+// In debug mode with AddressSanitizer, the memory past the position of the arena is poisoned
+#ifdef ARENA_ASAN
+#   define ARENA_ASAN_POISON(arena, start, size) \
+        ((arena)->_flags & ARENA_FLAG_DEBUG ? ASAN_POISON_MEMORY_REGION(start, size) : (void)0)
+#   define ARENA_ASAN_UNPOISON(arena, start, size) \
+        ((arena)->_flags & ARENA_FLAG_DEBUG ? ASAN_UNPOISON_MEMORY_REGION(start, size) : (void)0)
+#else
+#   define ARENA_ASAN_POISON(arena, start, size) ((void)0)
+#   define ARENA_ASAN_UNPOISON(arena, start, size) ((void)0)
+#endif
+
+// Arenas in debug mode reserve a guard page after the end of every block that is never committed
+static u64 arena_guard_size(Arena *arena) {
+    u64 size = (arena->_flags & ARENA_FLAG_DEBUG) ? arena->_page_size : 0;
+    return size;
+}
+
+static u8 *arena_reserve(Arena *arena, u64 capacity) {
+    u64 size = capacity + arena_guard_size(arena);
+    u8 *memory = (arena->_flags & ARENA_FLAG_HUGE_PAGES) ? vm_reserve_huge(size) : vm_reserve(size);
+    return memory;
+}
+
+static void arena_release_block_memory(Arena *arena) {
+    // @NOTE: AddressSanitizer keeps the poisoned state of unmapped memory, which would be reported as an error when the
+    // address range is mapped again
+    ARENA_ASAN_UNPOISON(arena, arena->_memory_start, arena->_capacity);
+    vm_free_pages(arena->_memory_start, arena->_capacity + arena_guard_size(arena));
+}
+
 Arena arena_alloc(u64 capacity_hint) {
+    ArenaParams params = {};
+    params.capacity = capacity_hint;
+    return arena_alloc_params(params);
+}
+
+Arena arena_alloc_params(ArenaParams params) {
     Arena arena = {};
-    arena._page_size = get_page_size();
-    arena._capacity = (capacity_hint + (arena._page_size - 1)) & -arena._page_size;
-    arena._memory_start = vm_reserve(arena._capacity);
+#ifdef ARENA_DEBUG
+    params.flags |= ARENA_FLAG_DEBUG;
+#endif
+    arena._flags = params.flags;
+    arena._page_size = (params.flags & ARENA_FLAG_HUGE_PAGES) ? get_huge_page_size() : get_page_size();
+    arena._capacity = (MAX(params.capacity, 1) + (arena._page_size - 1)) & -arena._page_size;
+    arena._memory_start = arena_reserve(&arena, arena._capacity);
     arena._position = arena._memory_start;
     arena._next_reserved_page = arena._memory_start;
+    arena._retain_size = params.retain_size;
+    arena._decommit_threshold = params.decommit_threshold > 0 ? params.decommit_threshold : ARENA_DEFAULT_DECOMMIT_THRESHOLD;
+
+    // In debug mode pages are committed one at a time, so the page after the last committed one works as a guard page
+    u64 commit_granularity = params.commit_granularity > 0 ? params.commit_granularity : ARENA_DEFAULT_COMMIT_GRANULARITY;
+    if (params.flags & ARENA_FLAG_DEBUG) {
+        commit_granularity = arena._page_size;
+    }
+    // @NOTE: the commit range is rounded with a mask, so the granularity must be a power of two. The page size is one too.
+    arena._commit_granularity = arena._page_size;
+    while (arena._commit_granularity < commit_granularity) {
+        arena._commit_granularity *= 2;
+    }
 
     return arena;
 }
 
+// Reserve a new block for a growable arena with enough room to push size bytes aligned to alignment. The state of the
+// current block is saved at the beginning of the new one, so arena_set_pos() can go back to it.
+static void arena_push_block(Arena *arena, u64 size, u64 alignment) {
+    u64 header_size = sizeof(ArenaBlock);
+    u64 min_capacity = header_size + (alignment - 1) + size;
+    u64 capacity = MAX(arena->_capacity*2, min_capacity);
+    capacity = (capacity + (arena->_page_size - 1)) & -arena->_page_size;
+
+    u8 *memory = arena_reserve(arena, capacity);
+    u8 *next_reserved_page = (u8*)(((u64)memory + header_size + (arena->_page_size - 1)) & -arena->_page_size);
+    vm_commit_pages(memory, next_reserved_page - memory);
+    ARENA_STATS_ADD(arena, commit_count, 1);
+    ARENA_STATS_ADD(arena, block_count, 1);
+
+    ArenaBlock *block = (ArenaBlock*)memory;
+    block->prev = arena->_prev_block;
+    block->memory_start = arena->_memory_start;
+    block->next_reserved_page = arena->_next_reserved_page;
+    block->capacity = arena->_capacity;
+    block->base_pos = arena->_base_pos;
+
+    arena->_base_pos += arena->_capacity;
+    arena->_memory_start = memory;
+    arena->_position = memory + header_size;
+    arena->_next_reserved_page = next_reserved_page;
+    arena->_protected_end = 0;
+    arena->_capacity = capacity;
+    arena->_prev_block = block;
+}
+
+// Commit the pages of the current block up to end, rounded up to the commit granularity
+static void arena_commit_pages(Arena *arena, u8 *end) {
+    u8 *block_end = arena->_memory_start + arena->_capacity;
+    u8 *commit_end = (u8*)(((u64)end + (arena->_commit_granularity - 1)) & -arena->_commit_granularity);
+    if (commit_end > block_end) {
+        commit_end = block_end;
+    }
+
+    u64 commit_size = commit_end - arena->_next_reserved_page;
+    vm_commit_pages(arena->_next_reserved_page, commit_size);
+    ARENA_ASAN_POISON(arena, arena->_next_reserved_page, commit_size);
+    ARENA_STATS_ADD(arena, commit_count, 1);
+    if (arena->_flags & ARENA_FLAG_PREFAULT) {
+        vm_prefault_pages(arena->_next_reserved_page, commit_size);
+    }
+    arena->_next_reserved_page = commit_end;
+}
+
+// Release the current block of a growable arena and go back to the previous one
+static void arena_pop_block(Arena *arena) {
+    assert(arena->_prev_block != 0);
+
+    ArenaBlock block = *arena->_prev_block;
+    arena_release_block_memory(arena);
+
+    arena->_memory_start = block.memory_start;
+    arena->_position = block.memory_start + block.capacity;
+    arena->_next_reserved_page = block.next_reserved_page;
+    // @NOTE: the block doesn't remember where its inaccessible pages ended, so assume they may go up to its end. Decommitting
+    // pages that were never committed is harmless.
+    arena->_protected_end = (arena->_flags & ARENA_FLAG_DEBUG) ? block.memory_start + block.capacity : 0;
+    arena->_capacity = block.capacity;
+    arena->_base_pos = block.base_pos;
+    arena->_prev_block = block.prev;
+}
+
 void arena_free(Arena *arena) {
+    while (arena->_prev_block != 0) {
+        arena_pop_block(arena);
+    }
+
     if (arena->_memory_start != 0) {
-        vm_free_pages(arena->_memory_start, arena->_capacity);
+        arena_release_block_memory(arena);
+    }
+
+#ifdef ARENA_STATS
+    if (arena->_callsites != 0) {
+        vm_free_pages((u8*)arena->_callsites, ARENA_STATS_MAX_CALLSITES*sizeof(ArenaCallsite));
     }
+#endif
 
     Arena zero = {};
     *arena = zero;
@@ -113,36 +376,80 @@ void *arena_push_data(Arena *arena, u64 type_size, u64 count, u64 alignment, b32
 
     u8 arena_ran_out_of_memory = pos_end > arena->_memory_start + arena->_capacity;
     if (arena_ran_out_of_memory) {
-        u64 total_size = pos_end - pos_start;
-        u64 padding_size = pos_aligned - pos_start;
-        u64 memory_left = arena->_capacity - (arena->_position - arena->_memory_start);
-        fprintf(
-            stderr,
-            "Arena ran out of memory. Requested %zu bytes to reserve (%zu bytes for padding + %zu bytes for the data), but arena has only %zu bytes left.\n",
-            total_size,
-            padding_size,
-            size,
-            memory_left
-        );
-        abort();
+        if (arena->_flags & ARENA_FLAG_GROWABLE) {
+            // Continue in a new block. This is the slow path, so the check for the flag is only done when the current
+            // block is exhausted.
+            arena_push_block(arena, size, alignment);
+            pos_start = arena->_position;
+            pos_aligned = (u8*)(((u64)pos_start + (alignment - 1)) & -alignment);
+            pos_end = pos_aligned + size;
+        } else {
+            u64 total_size = pos_end - pos_start;
+            u64 padding_size = pos_aligned - pos_start;
+            u64 memory_left = arena->_capacity - (arena->_position - arena->_memory_start);
+            fprintf(
+                stderr,
+                "Arena ran out of memory. Requested %zu bytes to reserve (%zu bytes for padding + %zu bytes for the data), but arena has only %zu bytes left.\n",
+                total_size,
+                padding_size,
+                size,
+                memory_left
+            );
+            abort();
+        }
     }
 
-    // If memory reservation crosses a page boundary it needs to commit as many memory pages as needed
-    u8 *next_reserved_page = (u8*)(((u64)pos_end + (arena->_page_size - 1)) & -arena->_page_size);
-    if (next_reserved_page > arena->_next_reserved_page) {
-        u64 size_from_last_page = pos_end - arena->_next_reserved_page;
-        vm_commit_pages(arena->_next_reserved_page, size_from_last_page);
-        arena->_next_reserved_page = next_reserved_page;
+    // If memory reservation goes past the committed memory it needs to commit as many memory pages as needed
+    if (pos_end > arena->_next_reserved_page) {
+        arena_commit_pages(arena, pos_end);
     }
 
+    ARENA_ASAN_UNPOISON(arena, pos_aligned, size);
     if (zero_data) {
         memset(pos_aligned, 0, size);
     }
 
     arena->_position = pos_end;
+
+    ARENA_STATS_ADD(arena, push_count, 1);
+    ARENA_STATS_ADD(arena, pushed_bytes, size);
+    ARENA_STATS_ADD(arena, padding_bytes, pos_aligned - pos_start);
+    ARENA_STATS_UPDATE_PEAK(arena);
+
     return pos_aligned;
 }
 
+#ifdef ARENA_STATS_CALLSITES
+void *arena_push_data_callsite(Arena *arena, u64 type_size, u64 count, u64 alignment, b32 zero_data, const char *file, u32 line) {
+    void *memory = arena_push_data(arena, type_size, count, alignment, zero_data);
+
+    if (arena->_callsites == 0) {
+        u64 table_size = ARENA_STATS_MAX_CALLSITES*sizeof(ArenaCallsite);
+        arena->_callsites = (ArenaCallsite*)vm_reserve(table_size);
+        vm_commit_pages((u8*)arena->_callsites, table_size);
+    }
+
+    // Open addressing with linear probing. Callsites are identified by the pointer of __FILE__, which is unique for every
+    // file in practice, and the line. If the table is full the push is not attributed to any callsite.
+    u64 hash = ((u64)file ^ ((u64)line*0x9E3779B97F4A7C15ull))*0xFF51AFD7ED558CCDull;
+    for (u64 i = 0; i < ARENA_STATS_MAX_CALLSITES; i++) {
+        ArenaCallsite *callsite = &arena->_callsites[(hash + i) % ARENA_STATS_MAX_CALLSITES];
+        if (callsite->file == 0) {
+            callsite->file = file;
+            callsite->line = line;
+        }
+
+        if (callsite->file == file && callsite->line == line) {
+            callsite->push_count += 1;
+            callsite->pushed_bytes += type_size*count;
+            break;
+        }
+    }
+
+    return memory;
+}
+#endif
+
 void *arena_grow_in_place_or_realloc_impl(Arena *arena, void *prev_memory, u64 prev_size, u64 new_size, u64 alignment) {
     // @NOTE 1: be extremely careful doing any changes to this function because it's difficult to get it right. Use a suite
     // of tests to check any changes that you make.
@@ -152,194 +459,915 @@ void *arena_grow_in_place_or_realloc_impl(Arena *arena, void *prev_memory, u64 p
     // 1. prev_memory is contained in the arena and it's the last element pushed. It will grow the memory in place.
     // 2. prev_memory is contained in the arena and it isn't the last element pushed. It will push memory into the arena and clone it.
     // 3. prev_memory is not contained in the arena. It will push memory into the arena and clone it.
+    //
+    // In growable arenas the last element can't grow in place if the current block has no room left. In that case it's
+    // handled like case 2, so the data is cloned into the next block.
     assert(new_size > 0 && new_size > prev_size);
     assert(alignment >= 1);
 
     u8 *new_pos = (u8*)prev_memory;
-    if ((u8*)prev_memory + prev_size == arena->_position) {
+    bool is_last_element = (u8*)prev_memory + prev_size == arena->_position;
+    bool fits_in_block = (u8*)prev_memory + new_size <= arena->_memory_start + arena->_capacity;
+    if (is_last_element && fits_in_block) {
         // Extend size in place. Allocate memory for the difference between new_size and prev_size with no alignment to
         // make sure that all data remains sequential in memory. We use arena_push_data() because this function already
-        // takes care of committing memory pages automatically and handles out of memory conditions.
+        // takes care of committing memory pages automatically.
         u64 size_remaining = new_size - prev_size;
         arena_push_data(arena, size_remaining, 1, 1, 0);
+        ARENA_STATS_ADD(arena, in_place_growths, 1);
     } else {
         // Reallocate memory, either because prev_memory is not contained within the arena or there's not enough room to
-        // grow the data in place.
+        // grow the data in place. arena_push_data() handles out of memory conditions.
         new_pos = (u8*)arena_push_data(arena, new_size, 1, alignment, 0);
         memcpy(new_pos, prev_memory, prev_size);
+        ARENA_STATS_ADD(arena, reallocations, 1);
     }
 
     return new_pos;
 }
 
-u64 arena_get_capacity(Arena *arena) {
-    return arena->_capacity;
-}
+void arena_commit(Arena *arena, u64 size) {
+    u8 *block_end = arena->_memory_start + arena->_capacity;
+    u8 *end = arena->_position + MIN(size, (u64)(block_end - arena->_position));
+    if (end > arena->_next_reserved_page) {
+        arena_commit_pages(arena, end);
+    }
 
-u64 arena_get_pos(Arena *arena) {
-    return arena->_position - arena->_memory_start;
+    // Pages that were already committed may not have been touched yet, so fault in the whole range
+    u8 *start = (u8*)((u64)arena->_position & -arena->_page_size);
+    if (end > start) {
+        vm_prefault_pages(start, end - start);
+    }
 }
 
-void arena_set_pos(Arena *arena, u64 pos) {
-    assert(pos <= arena->_capacity);
-    arena->_position = arena->_memory_start + pos;
+u64 arena_get_capacity(Arena *arena) {
+    return arena->_base_pos + arena->_capacity;
 }
 
-void arena_clear(Arena *arena) {
-    // @TODO: Set a deallocation strategy
-    arena->_position = arena->_memory_start;
+u64 arena_get_pos(Arena *arena) {
+    return arena->_base_pos + (arena->_position - arena->_memory_start);
 }
 
-// ####################################################################################################################
-// Buffer
-#define X(type) \
-    bool buffer_read_##type(Buffer *buffer, type *out) { \
-        bool ok = false; \
-        u64 read_bytes = MIN((u64)sizeof(type), buffer->length); \
-        if (read_bytes == sizeof(type)) { \
-            *out = *((type*)buffer->data); \
-            ok = true; \
-        } else { \
-            *out = 0; \
-        } \
-        buffer->data += read_bytes; \
-        buffer->length -= read_bytes; \
-        return ok; \
+// Decommit the pages of the current block above MAX(position, retain size) if they exceed the decommit threshold
+static void arena_decommit_unused_pages(Arena *arena) {
+    u64 block_retain_size = 0;
+    if (arena->_retain_size > arena->_base_pos) {
+        block_retain_size = MIN(arena->_retain_size - arena->_base_pos, arena->_capacity);
     }
-BUFFER_READ_FUNCTIONS
-#undef X
 
-bool buffer_read_count(Buffer *buffer, void *out, u64 count) {
-    bool ok = false;
+    u8 *keep_end = arena->_memory_start + block_retain_size;
+    if (keep_end < arena->_position) {
+        keep_end = arena->_position;
+    }
+    keep_end = (u8*)(((u64)keep_end + (arena->_page_size - 1)) & -arena->_page_size);
 
-    u64 read_bytes = MIN(count, buffer->length);
-    if (read_bytes == count) {
-        memcpy(out, buffer->data, read_bytes);
-        ok = true;
-    } else {
-        memset(out, 0, read_bytes);
+    // @NOTE: in debug mode the released pages were only made inaccessible, so they are still committed up to _protected_end
+    u8 *committed_end = MAX(arena->_next_reserved_page, arena->_protected_end);
+    if (committed_end > keep_end) {
+        u64 decommit_size = committed_end - keep_end;
+        if (decommit_size >= arena->_decommit_threshold) {
+            vm_decommit_pages(keep_end, decommit_size, arena->_flags & ARENA_FLAG_DECOMMIT_LAZY);
+            arena->_next_reserved_page = MIN(arena->_next_reserved_page, keep_end);
+            arena->_protected_end = MIN(arena->_protected_end, keep_end);
+            ARENA_STATS_ADD(arena, decommit_count, 1);
+        }
     }
+}
 
-    buffer->data += read_bytes;
-    buffer->length -= read_bytes;
+// Poison the memory released by arena_set_pos(). Any access to it is reported by AddressSanitizer. Without it, the
+// released memory is filled with ARENA_DEBUG_POISON_BYTE and the pages that were released entirely become inaccessible
+// until they are pushed again.
+static void arena_debug_poison(Arena *arena, u8 *start, u8 *end) {
+    end = MIN(end, arena->_next_reserved_page);
+    if (start >= end) {
+        return;
+    }
 
-    return ok;
-}
+#ifdef ARENA_ASAN
+    ASAN_POISON_MEMORY_REGION(start, end - start);
+#else
+    memset(start, ARENA_DEBUG_POISON_BYTE, end - start);
 
-bool buffer_read_nocopy(Buffer *inBuffer, Buffer *outBuffer, u64 count) {
-    bool ok = false;
-    outBuffer->data = inBuffer->data;
+    u8 *protect_start = (u8*)(((u64)start + (arena->_page_size - 1)) & -arena->_page_size);
+    if (protect_start < arena->_next_reserved_page) {
+        vm_protect_pages(protect_start, arena->_next_reserved_page - protect_start);
+        arena->_protected_end = MAX(arena->_protected_end, arena->_next_reserved_page);
+        arena->_next_reserved_page = protect_start;
+    }
+#endif
+}
 
-    if (inBuffer->length >= count) {
-        outBuffer->length = count;
+void arena_set_pos(Arena *arena, u64 pos) {
+    // Release every block that starts after pos. Positions inside the header of a block belong to the previous block.
+    while (arena->_prev_block != 0 && pos < arena->_base_pos + sizeof(ArenaBlock)) {
+        arena_pop_block(arena);
+    }
 
-        inBuffer->data += count;
-        inBuffer->length -= count;
+    assert(pos >= arena->_base_pos);
+    assert(pos <= arena->_base_pos + arena->_capacity);
+    u8 *prev_position = arena->_position;
+    arena->_position = arena->_memory_start + (pos - arena->_base_pos);
 
-        ok = true;
-    } else {
-        // Not enough bytes to read. Consume input buffer anyway.
-        inBuffer->length = 0;
-        outBuffer->length = 0;
+    if (arena->_flags & ARENA_FLAG_DEBUG) {
+        arena_debug_poison(arena, arena->_position, prev_position);
     }
 
-    return ok;
+    if (arena->_flags & (ARENA_FLAG_DECOMMIT|ARENA_FLAG_DECOMMIT_LAZY)) {
+        arena_decommit_unused_pages(arena);
+    }
 }
 
-Buffer buffer_slice(Buffer buf, u64 start, u64 end) {
-    // @NOTE: reference function that is copy-pasted in string_slice()
-    u64 actual_start = MIN(start, buf.length);
-    u64 actual_end = CLAMP(end, actual_start, buf.length);
-    u64 length = actual_end - actual_start;
-    Buffer ret = {
-        buf.data + actual_start,
-        length
-    };
-    return ret;
+void arena_clear(Arena *arena) {
+    // Blocks of growable arenas are released and committed pages are kept unless a decommit policy has been set
+    arena_set_pos(arena, 0);
 }
 
-// ####################################################################################################################
-// String
-String string_from_cstring(const char *str) {
-    String ret = {
-        (const u8*)str,
-        (u64)strlen(str)
-    };
-    return ret;
+#ifdef ARENA_STATS
+ArenaStats arena_get_stats(Arena *arena) {
+    return arena->_stats;
 }
 
-const char *string_to_cstring(Arena *arena, String str) {
-    char *c_str = arena_grow_in_place_or_realloc(arena, char, (void*)str.data, str.length, str.length + 1);
-    c_str[str.length] = 0;
-    return c_str;
+const ArenaCallsite *arena_get_callsites(Arena *arena) {
+    return arena->_callsites;
 }
 
-bool string_equals(String a, String b) {
-    bool equals = a.length == b.length && (a.length == 0 || memcmp(a.data, b.data, a.length) == 0);
-    return equals;
+void arena_print_stats(Arena *arena, const char *name) {
+    ArenaStats stats = arena->_stats;
+    printf("Arena %s\n", name);
+    printf("  peak position:    %zu bytes\n", stats.peak_pos);
+    printf("  pushes:           %zu (%zu bytes, %zu bytes of padding)\n", stats.push_count, stats.pushed_bytes, stats.padding_bytes);
+    printf("  commits:          %zu\n", stats.commit_count);
+    printf("  decommits:        %zu\n", stats.decommit_count);
+    printf("  chained blocks:   %zu\n", stats.block_count);
+    printf("  in-place growths: %zu\n", stats.in_place_growths);
+    printf("  reallocations:    %zu\n", stats.reallocations);
+
+    if (arena->_callsites == 0) {
+        return;
+    }
+
+    // Sort callsites by pushed bytes with insertion sort. There are few of them and this is not a hot path.
+    TempArena scratch = scratch_begin(&arena, 1);
+    ArenaCallsite *sorted = arena_push_nozero(scratch.arena, ArenaCallsite, ARENA_STATS_MAX_CALLSITES);
+    u64 count = 0;
+    for (u64 i = 0; i < ARENA_STATS_MAX_CALLSITES; i++) {
+        ArenaCallsite callsite = arena->_callsites[i];
+        if (callsite.file == 0) {
+            continue;
+        }
+
+        u64 j = count;
+        while (j > 0 && sorted[j - 1].pushed_bytes < callsite.pushed_bytes) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = callsite;
+        count++;
+    }
+
+    printf("  callsites:\n");
+    for (u64 i = 0; i < count; i++) {
+        printf("    %12zu bytes %8zu pushes  %s:%u\n", sorted[i].pushed_bytes, sorted[i].push_count, sorted[i].file, sorted[i].line);
+    }
+    scratch_end(scratch);
 }
+#endif
 
-String string_slice(String str, u64 start, u64 end) {
-    // @NOTE: Copy-pasted from buffer_slice()
-    u64 actual_start = MIN(start, str.length);
-    u64 actual_end = CLAMP(end, actual_start, str.length);
-    u64 length = actual_end - actual_start;
-    String ret = {
-        str.data + actual_start,
-        length
+TempArena temp_arena_begin(Arena *arena) {
+    TempArena temp = {
+        arena,
+        arena_get_pos(arena)
     };
-    return ret;
+    return temp;
 }
 
-bool string_starts_with(String str, String search) {
-    bool ok = str.length >= search.length && memcmp(str.data, search.data, search.length) == 0;
-    return ok;
+void temp_arena_end(TempArena temp) {
+    arena_set_pos(temp.arena, temp.pos);
 }
 
-bool string_ends_with(String str, String search) {
-    bool ok = false;
-    if (str.length >= search.length) {
-        u64 displacement = str.length - search.length;
-        const u8 *astr = str.data + displacement;
-        ok = memcmp(astr, search.data, search.length) == 0;
-    }
-    return ok;
-}
+// ====================================================================================================================
+// Scratch arena
 
-String string_concat(Arena *arena, String a, String b) {
-    // This function tries to allocate as little memory as possible, ideally zero allocations. It will only alocate memory
-    // if arguments a and b are non-empty strings.
-    u8 *data = (u8*)(a.length > 0 ? a.data : b.data);
-    u64 new_length = a.length + b.length;
-    if (a.length > 0 && b.length > 0) {
-        data = arena_grow_in_place_or_realloc(arena, u8, (void*)a.data, a.length, new_length);
-        memcpy(data + a.length, b.data, b.length);
+// @NOTE: The pool is a trivial thread_local array so the hot path doesn't pay for the lazy initialization guard that C++
+// generates for thread_local objects with constructors or destructors. Only the releaser below has a destructor, and it's
+// constructed the first time a thread reserves its scratch arenas.
+static thread_local Arena scratch_arenas[SCRATCH_ARENA_COUNT];
+
+struct ScratchArenaReleaser {
+    ~ScratchArenaReleaser() {
+        for (u64 i = 0; i < SCRATCH_ARENA_COUNT; i++) {
+            arena_free(&scratch_arenas[i]);
+        }
     }
+};
 
-    String ret = {
-        .data = data,
-        .length = new_length
-    };
-    return ret;
+static void scratch_arenas_init() {
+    // Release the scratch arenas of this thread when it exits
+    static thread_local ScratchArenaReleaser releaser;
+    UNUSED(releaser);
+
+    for (u64 i = 0; i < SCRATCH_ARENA_COUNT; i++) {
+        scratch_arenas[i] = arena_alloc(SCRATCH_ARENA_CAPACITY);
+    }
 }
 
-// ####################################################################################################################
-// File I/O
-bool read_entire_file(Arena *arena, String file_name, Buffer *out_file_buffer) {
-    assert(out_file_buffer != 0);
+TempArena scratch_begin(Arena **conflicts, u64 conflict_count) {
+    assert(conflict_count == 0 || conflicts != 0);
 
-    u64 arena_original_pos = arena_get_pos(arena);
-    const char *file_name_cstr = string_to_cstring(arena, file_name);
+    if (scratch_arenas[0]._memory_start == 0) {
+        scratch_arenas_init();
+    }
 
-    bool ok = true;
-    u8 *file_buffer = 0;
-    u64 file_size = 0;
+    Arena *scratch = 0;
+    for (u64 i = 0; i < SCRATCH_ARENA_COUNT && scratch == 0; i++) {
+        Arena *candidate = &scratch_arenas[i];
 
-#if _WIN32
-    // @TODO: Enable longer paths in Windows
-    // @NOTE: According to the Microsoft documentation "[OpenFile] has limited capabilities and is not recommended. For
-    // new application development, use the CreateFile function."
-    // Source (24/07/2025): https://learn.microsoft.com/en-us/windows/win32/api/winbase/nf-winbase-openfile?source=recommendations
+        bool has_conflict = false;
+        for (u64 j = 0; j < conflict_count; j++) {
+            if (conflicts[j] == candidate) {
+                has_conflict = true;
+                break;
+            }
+        }
+
+        if (!has_conflict) {
+            scratch = candidate;
+        }
+    }
+
+    if (scratch == 0) {
+        fprintf(stderr, "All %d scratch arenas conflict with the arenas passed to scratch_begin()\n", SCRATCH_ARENA_COUNT);
+        abort();
+    }
+
+    return temp_arena_begin(scratch);
+}
+
+void scratch_end(TempArena scratch) {
+    temp_arena_end(scratch);
+}
+
+// ====================================================================================================================
+// Concurrent arena
+
+// Chunk of a concurrent arena owned by a thread. Each thread has a small direct-mapped cache of chunks indexed by the id
+// of the arena, so a thread can push into several concurrent arenas without evicting its chunks all the time.
+typedef struct {
+    u64 arena_id;
+    u8 *position;
+    u8 *end;
+} ConcurrentArenaChunk;
+
+#define CONCURRENT_ARENA_CHUNK_CACHE_SIZE 8
+static thread_local ConcurrentArenaChunk concurrent_arena_chunks[CONCURRENT_ARENA_CHUNK_CACHE_SIZE];
+
+// Source of unique ids for concurrent arenas. Ids are never reused, so chunks cached for an arena that has been freed or
+// cleared never match any live arena. Zero is reserved for empty cache entries.
+static volatile u64 concurrent_arena_next_id = 1;
+
+ConcurrentArena concurrent_arena_alloc(u64 capacity_hint) {
+    ConcurrentArena arena = {};
+    arena._page_size = get_page_size();
+    arena._capacity = (MAX(capacity_hint, 1) + (arena._page_size - 1)) & -arena._page_size;
+    arena._commit_granularity = (ARENA_DEFAULT_COMMIT_GRANULARITY + (arena._page_size - 1)) & -arena._page_size;
+    arena._memory_start = vm_reserve(arena._capacity);
+    arena._id = atomic_fetch_add_u64(&concurrent_arena_next_id, 1);
+
+    return arena;
+}
+
+void concurrent_arena_free(ConcurrentArena *arena) {
+    if (arena->_memory_start != 0) {
+        vm_free_pages(arena->_memory_start, arena->_capacity);
+    }
+
+    ConcurrentArena zero = {};
+    *arena = zero;
+}
+
+// Reserve size bytes from the shared position and make sure they are committed
+static u8 *concurrent_arena_reserve(ConcurrentArena *arena, u64 size) {
+    u64 start = atomic_fetch_add_u64(&arena->_position, size);
+    u64 end = start + size;
+    if (end > arena->_capacity) {
+        fprintf(
+            stderr,
+            "Concurrent arena ran out of memory. Requested %zu bytes to reserve, but arena has only %zu bytes left.\n",
+            size,
+            start < arena->_capacity ? arena->_capacity - start : 0
+        );
+        abort();
+    }
+
+    // Several threads may commit overlapping ranges at the same time, which is harmless because committing pages that are
+    // already committed does nothing. The committed size is only published after the pages have been committed, and it
+    // never decreases.
+    u64 committed_size = atomic_load_u64(&arena->_committed_size);
+    while (committed_size < end) {
+        u64 commit_end = (end + (arena->_commit_granularity - 1)) & -arena->_commit_granularity;
+        commit_end = MIN(commit_end, arena->_capacity);
+        vm_commit_pages(arena->_memory_start + committed_size, commit_end - committed_size);
+
+        u64 prev_committed_size = atomic_compare_exchange_u64(&arena->_committed_size, committed_size, commit_end);
+        committed_size = prev_committed_size == committed_size ? commit_end : prev_committed_size;
+    }
+
+    return arena->_memory_start + start;
+}
+
+void *arena_push_data(ConcurrentArena *arena, u64 type_size, u64 count, u64 alignment, b32 zero_data) {
+    assert(alignment >= 1);
+
+    u64 size = type_size*count;
+    assert(size > 0);
+
+    u8 *pos_aligned = 0;
+    ConcurrentArenaChunk *chunk = &concurrent_arena_chunks[arena->_id % CONCURRENT_ARENA_CHUNK_CACHE_SIZE];
+    if (chunk->arena_id == arena->_id) {
+        // Fast path: bump the position of the chunk of this thread
+        u8 *aligned = (u8*)(((u64)chunk->position + (alignment - 1)) & -alignment);
+        if (aligned + size <= chunk->end) {
+            pos_aligned = aligned;
+            chunk->position = aligned + size;
+        }
+    }
+
+    if (pos_aligned == 0) {
+        u64 size_with_padding = size + (alignment - 1);
+        if (size_with_padding > CONCURRENT_ARENA_CHUNK_SIZE/4) {
+            // Big pushes would waste most of a chunk, so they are reserved on their own and the current chunk is kept
+            u8 *memory = concurrent_arena_reserve(arena, size_with_padding);
+            pos_aligned = (u8*)(((u64)memory + (alignment - 1)) & -alignment);
+        } else {
+            // Get a new chunk. The rest of the previous chunk is wasted.
+            u8 *memory = concurrent_arena_reserve(arena, CONCURRENT_ARENA_CHUNK_SIZE);
+            pos_aligned = (u8*)(((u64)memory + (alignment - 1)) & -alignment);
+            chunk->arena_id = arena->_id;
+            chunk->position = pos_aligned + size;
+            chunk->end = memory + CONCURRENT_ARENA_CHUNK_SIZE;
+        }
+    }
+
+    if (zero_data) {
+        memset(pos_aligned, 0, size);
+    }
+
+    return pos_aligned;
+}
+
+#ifdef ARENA_STATS_CALLSITES
+void *arena_push_data_callsite(ConcurrentArena *arena, u64 type_size, u64 count, u64 alignment, b32 zero_data, const char *file, u32 line) {
+    // Concurrent arenas don't record statistics, because the bookkeeping would need synchronization between threads
+    UNUSED(file);
+    UNUSED(line);
+    return arena_push_data(arena, type_size, count, alignment, zero_data);
+}
+#endif
+
+u64 concurrent_arena_get_pos(ConcurrentArena *arena) {
+    return MIN(atomic_load_u64(&arena->_position), arena->_capacity);
+}
+
+void concurrent_arena_clear(ConcurrentArena *arena) {
+    // A new id invalidates the chunks that any thread has cached for this arena
+    arena->_id = atomic_fetch_add_u64(&concurrent_arena_next_id, 1);
+    atomic_store_u64(&arena->_position, 0);
+}
+
+// ####################################################################################################################
+// Pool
+Pool pool_make_impl(Arena *arena, u64 object_size, u64 alignment, u64 objects_per_slab) {
+    assert(arena != 0);
+    assert(object_size > 0);
+    assert(alignment >= 1);
+    assert(objects_per_slab > 0);
+
+    // Released objects store the pointer to the next free object in their own memory, so every object must be big enough
+    // and aligned enough to hold a pointer. Rounding the size up to the alignment keeps every object in a slab aligned.
+    alignment = MAX(alignment, (u64)alignof(void*));
+    object_size = MAX(object_size, (u64)sizeof(void*));
+    object_size = (object_size + (alignment - 1)) & -alignment;
+
+    Pool pool = {};
+    pool._arena = arena;
+    pool._object_size = object_size;
+    pool._alignment = alignment;
+    pool._objects_per_slab = objects_per_slab;
+    return pool;
+}
+
+void *pool_push_data(Pool *pool, u64 object_size, b32 zero_data) {
+    assert(object_size <= pool->_object_size && "Pushed an object bigger than the objects of the pool");
+    UNUSED(object_size);
+
+    u8 *object = (u8*)pool->_free_list;
+    if (object != 0) {
+        // Reuse the last object released
+        pool->_free_list = *(void**)object;
+    } else {
+        // Carve a new object from the current slab. Objects are carved one at a time, so a new slab doesn't have to be
+        // walked to build its free list.
+        if (pool->_slab_position == pool->_slab_end) {
+            u64 slab_size = pool->_object_size*pool->_objects_per_slab;
+            pool->_slab_position = (u8*)arena_push_data(pool->_arena, slab_size, 1, pool->_alignment, 0);
+            pool->_slab_end = pool->_slab_position + slab_size;
+        }
+
+        object = pool->_slab_position;
+        pool->_slab_position += pool->_object_size;
+    }
+
+    if (zero_data) {
+        memset(object, 0, pool->_object_size);
+    }
+
+    return object;
+}
+
+void pool_release(Pool *pool, void *object) {
+    assert(object != 0);
+    *(void**)object = pool->_free_list;
+    pool->_free_list = object;
+}
+
+// ####################################################################################################################
+// Heap
+
+// Every block has a header with the size of its payload. The pointers of the free lists are stored in the payload, so
+// they only take space in free blocks. prev_physical is only valid when the previous block is free, which is the only
+// time it's needed: to merge a released block with the previous one.
+struct HeapBlock {
+    HeapBlock *prev_physical;
+    u64 size;               // Size of the payload with HEAP_BLOCK_* flags in the lowest bits
+    HeapBlock *next_free;
+    HeapBlock *prev_free;
+};
+
+#define HEAP_BLOCK_FREE         1
+#define HEAP_BLOCK_PREV_FREE    2
+#define HEAP_BLOCK_FLAGS        (HEAP_BLOCK_FREE|HEAP_BLOCK_PREV_FREE)
+#define HEAP_BLOCK_HEADER_SIZE  (2*sizeof(u64))
+#define HEAP_BLOCK_MIN_SIZE     (2*sizeof(HeapBlock*))
+#define HEAP_FL_SHIFT           (HEAP_SL_COUNT_LOG2 + 4)
+#define HEAP_SMALL_BLOCK_SIZE   ((u64)1 << HEAP_FL_SHIFT)
+
+static u64 heap_block_size(HeapBlock *block) {
+    return block->size & ~(u64)HEAP_BLOCK_FLAGS;
+}
+
+static u8 *heap_block_payload(HeapBlock *block) {
+    return (u8*)block + HEAP_BLOCK_HEADER_SIZE;
+}
+
+static HeapBlock *heap_block_next(HeapBlock *block) {
+    return (HeapBlock*)(heap_block_payload(block) + heap_block_size(block));
+}
+
+// Size class of a block of the given size. Blocks smaller than HEAP_SMALL_BLOCK_SIZE are all in the first level, split
+// in classes of HEAP_ALIGNMENT bytes.
+static void heap_mapping(u64 size, u32 *fl, u32 *sl) {
+    if (size < HEAP_SMALL_BLOCK_SIZE) {
+        *fl = 0;
+        *sl = (u32)(size/HEAP_ALIGNMENT);
+    } else {
+        u32 log2 = bit_scan_reverse_u64(size);
+        *sl = (u32)(size >> (log2 - HEAP_SL_COUNT_LOG2)) ^ HEAP_SL_COUNT;
+        *fl = log2 - (HEAP_FL_SHIFT - 1);
+    }
+}
+
+static void heap_insert_free_block(Heap *heap, HeapBlock *block) {
+    u32 fl, sl;
+    heap_mapping(heap_block_size(block), &fl, &sl);
+
+    HeapBlock *head = heap->_free_lists[fl][sl];
+    block->next_free = head;
+    block->prev_free = 0;
+    if (head != 0) {
+        head->prev_free = block;
+    }
+
+    heap->_free_lists[fl][sl] = block;
+    heap->_fl_bitmap |= (u64)1 << fl;
+    heap->_sl_bitmaps[fl] |= (u32)1 << sl;
+}
+
+static void heap_remove_free_block(Heap *heap, HeapBlock *block) {
+    u32 fl, sl;
+    heap_mapping(heap_block_size(block), &fl, &sl);
+
+    if (block->prev_free != 0) {
+        block->prev_free->next_free = block->next_free;
+    } else {
+        heap->_free_lists[fl][sl] = block->next_free;
+    }
+    if (block->next_free != 0) {
+        block->next_free->prev_free = block->prev_free;
+    }
+
+    if (heap->_free_lists[fl][sl] == 0) {
+        heap->_sl_bitmaps[fl] &= ~((u32)1 << sl);
+        if (heap->_sl_bitmaps[fl] == 0) {
+            heap->_fl_bitmap &= ~((u64)1 << fl);
+        }
+    }
+}
+
+// Find a free block of at least size bytes. The size is rounded up to the next size class, so any block in the list
+// found is big enough without walking the list.
+static HeapBlock *heap_find_free_block(Heap *heap, u64 size) {
+    if (size >= HEAP_SMALL_BLOCK_SIZE) {
+        size += ((u64)1 << (bit_scan_reverse_u64(size) - HEAP_SL_COUNT_LOG2)) - 1;
+    }
+
+    u32 fl, sl;
+    heap_mapping(size, &fl, &sl);
+    if (fl >= HEAP_FL_COUNT) {
+        return 0;
+    }
+
+    u32 sl_map = heap->_sl_bitmaps[fl] & (~(u32)0 << sl);
+    if (sl_map == 0) {
+        u64 fl_map = fl + 1 < 64 ? heap->_fl_bitmap & (~(u64)0 << (fl + 1)) : 0;
+        if (fl_map == 0) {
+            return 0;
+        }
+
+        fl = bit_scan_forward_u64(fl_map);
+        sl_map = heap->_sl_bitmaps[fl];
+    }
+
+    sl = bit_scan_forward_u64(sl_map);
+    return heap->_free_lists[fl][sl];
+}
+
+static void heap_mark_block_free(Heap *heap, HeapBlock *block) {
+    block->size |= HEAP_BLOCK_FREE;
+
+    HeapBlock *next = heap_block_next(block);
+    if ((u8*)next < heap->_top) {
+        next->size |= HEAP_BLOCK_PREV_FREE;
+        next->prev_physical = block;
+    }
+}
+
+static void heap_mark_block_used(Heap *heap, HeapBlock *block) {
+    block->size &= ~(u64)HEAP_BLOCK_FREE;
+
+    HeapBlock *next = heap_block_next(block);
+    if ((u8*)next < heap->_top) {
+        next->size &= ~(u64)HEAP_BLOCK_PREV_FREE;
+    }
+}
+
+// Split the block so it has exactly size bytes and put the rest back into the free lists. It does nothing if the rest
+// would be too small to be a block on its own.
+static void heap_split_block(Heap *heap, HeapBlock *block, u64 size) {
+    u64 block_size = heap_block_size(block);
+    if (block_size < size + HEAP_BLOCK_HEADER_SIZE + HEAP_BLOCK_MIN_SIZE) {
+        return;
+    }
+
+    HeapBlock *rest = (HeapBlock*)(heap_block_payload(block) + size);
+    rest->size = block_size - size - HEAP_BLOCK_HEADER_SIZE;
+    block->size = size | (block->size & HEAP_BLOCK_FLAGS);
+    if (heap->_last_block == block) {
+        heap->_last_block = rest;
+    }
+
+    heap_mark_block_free(heap, rest);
+    heap_insert_free_block(heap, rest);
+}
+
+// Carve a block of at least size bytes at the top of the heap, committing more memory if needed. If the last block is
+// free it's extended instead, so it doesn't become a fragment that nobody can use.
+static HeapBlock *heap_extend(Heap *heap, u64 size) {
+    HeapBlock *block = 0;
+    u8 *end = 0;
+    HeapBlock *last = heap->_last_block;
+    if (last != 0 && (last->size & HEAP_BLOCK_FREE)) {
+        heap_remove_free_block(heap, last);
+        block = last;
+        end = heap_block_payload(block) + size;
+    } else {
+        block = (HeapBlock*)heap->_top;
+        end = heap->_top + HEAP_BLOCK_HEADER_SIZE + size;
+    }
+
+    if (end > heap->_memory_start + heap->_capacity) {
+        fprintf(stderr, "Heap ran out of memory. Requested %zu bytes, but the heap has a capacity of %zu bytes.\n", size, heap->_capacity);
+        abort();
+    }
+
+    if (end > heap->_committed_end) {
+        u8 *commit_end = (u8*)(((u64)end + (ARENA_DEFAULT_COMMIT_GRANULARITY - 1)) & -(u64)ARENA_DEFAULT_COMMIT_GRANULARITY);
+        commit_end = MIN(commit_end, heap->_memory_start + heap->_capacity);
+        vm_commit_pages(heap->_committed_end, commit_end - heap->_committed_end);
+        heap->_committed_end = commit_end;
+    }
+
+    // Neither block can have a free block before it: a free last block would have been merged with it, and a new block
+    // follows a used block or no block at all
+    block->size = end - heap_block_payload(block);
+    heap->_top = end;
+    heap->_last_block = block;
+    return block;
+}
+
+Heap heap_alloc(u64 capacity_hint) {
+    u64 page_size = get_page_size();
+
+    Heap heap = {};
+    heap._capacity = (MAX(capacity_hint, 1) + (page_size - 1)) & -page_size;
+    heap._memory_start = vm_reserve(heap._capacity);
+    heap._top = heap._memory_start;
+    heap._committed_end = heap._memory_start;
+    return heap;
+}
+
+void heap_free(Heap *heap) {
+    if (heap->_memory_start != 0) {
+        vm_free_pages(heap->_memory_start, heap->_capacity);
+    }
+
+    Heap zero = {};
+    *heap = zero;
+}
+
+void *heap_push_data(Heap *heap, u64 size, u64 alignment, b32 zero_data) {
+    assert(size > 0);
+    assert(alignment >= 1 && (alignment & (alignment - 1)) == 0);
+
+    u64 block_size = (MAX(size, HEAP_BLOCK_MIN_SIZE) + (HEAP_ALIGNMENT - 1)) & -(u64)HEAP_ALIGNMENT;
+
+    // Payloads are always aligned to HEAP_ALIGNMENT. Bigger alignments need a block with enough room to split off a free
+    // block in front of the aligned payload.
+    u64 search_size = block_size;
+    if (alignment > HEAP_ALIGNMENT) {
+        search_size += alignment + HEAP_BLOCK_HEADER_SIZE + HEAP_BLOCK_MIN_SIZE;
+    }
+
+    HeapBlock *block = heap_find_free_block(heap, search_size);
+    if (block != 0) {
+        heap_remove_free_block(heap, block);
+    } else {
+        block = heap_extend(heap, search_size);
+    }
+
+    if (alignment > HEAP_ALIGNMENT) {
+        u8 *payload = heap_block_payload(block);
+        u8 *aligned = (u8*)(((u64)payload + (alignment - 1)) & -alignment);
+        if (aligned != payload) {
+            while ((u64)(aligned - payload) < HEAP_BLOCK_HEADER_SIZE + HEAP_BLOCK_MIN_SIZE) {
+                aligned += alignment;
+            }
+
+            // The free block in front takes the gap and the aligned block takes the rest
+            u64 gap = aligned - payload;
+            HeapBlock *front = block;
+            block = (HeapBlock*)(aligned - HEAP_BLOCK_HEADER_SIZE);
+            block->size = heap_block_size(front) - gap;
+            front->size = (gap - HEAP_BLOCK_HEADER_SIZE) | (front->size & HEAP_BLOCK_PREV_FREE);
+            if (heap->_last_block == front) {
+                heap->_last_block = block;
+            }
+
+            heap_mark_block_free(heap, front);
+            heap_insert_free_block(heap, front);
+        }
+    }
+
+    heap_split_block(heap, block, block_size);
+    heap_mark_block_used(heap, block);
+    heap->_used_size += HEAP_BLOCK_HEADER_SIZE + heap_block_size(block);
+
+    u8 *memory = heap_block_payload(block);
+    if (zero_data) {
+        memset(memory, 0, size);
+    }
+    return memory;
+}
+
+void heap_release(Heap *heap, void *memory) {
+    assert(memory != 0);
+
+    HeapBlock *block = (HeapBlock*)((u8*)memory - HEAP_BLOCK_HEADER_SIZE);
+    assert(!(block->size & HEAP_BLOCK_FREE) && "Memory released twice");
+    heap->_used_size -= HEAP_BLOCK_HEADER_SIZE + heap_block_size(block);
+
+    // Merge with the previous block
+    if (block->size & HEAP_BLOCK_PREV_FREE) {
+        HeapBlock *prev = block->prev_physical;
+        heap_remove_free_block(heap, prev);
+        prev->size += HEAP_BLOCK_HEADER_SIZE + heap_block_size(block);
+        if (heap->_last_block == block) {
+            heap->_last_block = prev;
+        }
+        block = prev;
+    }
+
+    // Merge with the next block
+    HeapBlock *next = heap_block_next(block);
+    if ((u8*)next < heap->_top && (next->size & HEAP_BLOCK_FREE)) {
+        heap_remove_free_block(heap, next);
+        block->size += HEAP_BLOCK_HEADER_SIZE + heap_block_size(next);
+        if (heap->_last_block == next) {
+            heap->_last_block = block;
+        }
+    }
+
+    heap_mark_block_free(heap, block);
+    heap_insert_free_block(heap, block);
+}
+
+HeapStats heap_get_stats(Heap *heap) {
+    HeapStats stats = {};
+    stats.used_size = heap->_used_size;
+    stats.heap_size = heap->_top - heap->_memory_start;
+    stats.committed_size = heap->_committed_end - heap->_memory_start;
+    return stats;
+}
+
+// ####################################################################################################################
+// Buffer
+#define X(type) \
+    bool buffer_read_##type(Buffer *buffer, type *out) { \
+        bool ok = false; \
+        u64 read_bytes = MIN((u64)sizeof(type), buffer->length); \
+        if (read_bytes == sizeof(type)) { \
+            *out = *((type*)buffer->data); \
+            ok = true; \
+        } else { \
+            *out = 0; \
+        } \
+        buffer->data += read_bytes; \
+        buffer->length -= read_bytes; \
+        return ok; \
+    }
+BUFFER_READ_FUNCTIONS
+#undef X
+
+bool buffer_read_count(Buffer *buffer, void *out, u64 count) {
+    bool ok = false;
+
+    u64 read_bytes = MIN(count, buffer->length);
+    if (read_bytes == count) {
+        memcpy(out, buffer->data, read_bytes);
+        ok = true;
+    } else {
+        memset(out, 0, read_bytes);
+    }
+
+    buffer->data += read_bytes;
+    buffer->length -= read_bytes;
+
+    return ok;
+}
+
+bool buffer_read_nocopy(Buffer *inBuffer, Buffer *outBuffer, u64 count) {
+    bool ok = false;
+    outBuffer->data = inBuffer->data;
+
+    if (inBuffer->length >= count) {
+        outBuffer->length = count;
+
+        inBuffer->data += count;
+        inBuffer->length -= count;
+
+        ok = true;
+    } else {
+        // Not enough bytes to read. Consume input buffer anyway.
+        inBuffer->length = 0;
+        outBuffer->length = 0;
+    }
+
+    return ok;
+}
+
+Buffer buffer_slice(Buffer buf, u64 start, u64 end) {
+    // @NOTE: reference function that is copy-pasted in string_slice()
+    u64 actual_start = MIN(start, buf.length);
+    u64 actual_end = CLAMP(end, actual_start, buf.length);
+    u64 length = actual_end - actual_start;
+    Buffer ret = {
+        buf.data + actual_start,
+        length
+    };
+    return ret;
+}
+
+// ####################################################################################################################
+// String
+String string_from_cstring(const char *str) {
+    String ret = {
+        (const u8*)str,
+        (u64)strlen(str)
+    };
+    return ret;
+}
+
+const char *string_to_cstring(Arena *arena, String str) {
+    char *c_str = arena_grow_in_place_or_realloc(arena, char, (void*)str.data, str.length, str.length + 1);
+    c_str[str.length] = 0;
+    return c_str;
+}
+
+bool string_equals(String a, String b) {
+    bool equals = a.length == b.length && (a.length == 0 || memcmp(a.data, b.data, a.length) == 0);
+    return equals;
+}
+
+String string_slice(String str, u64 start, u64 end) {
+    // @NOTE: Copy-pasted from buffer_slice()
+    u64 actual_start = MIN(start, str.length);
+    u64 actual_end = CLAMP(end, actual_start, str.length);
+    u64 length = actual_end - actual_start;
+    String ret = {
+        str.data + actual_start,
+        length
+    };
+    return ret;
+}
+
+bool string_starts_with(String str, String search) {
+    bool ok = str.length >= search.length && memcmp(str.data, search.data, search.length) == 0;
+    return ok;
+}
+
+bool string_ends_with(String str, String search) {
+    bool ok = false;
+    if (str.length >= search.length) {
+        u64 displacement = str.length - search.length;
+        const u8 *astr = str.data + displacement;
+        ok = memcmp(astr, search.data, search.length) == 0;
+    }
+    return ok;
+}
+
+String string_concat(Arena *arena, String a, String b) {
+    // This function tries to allocate as little memory as possible, ideally zero allocations. It will only alocate memory
+    // if arguments a and b are non-empty strings.
+    u8 *data = (u8*)(a.length > 0 ? a.data : b.data);
+    u64 new_length = a.length + b.length;
+    if (a.length > 0 && b.length > 0) {
+        data = arena_grow_in_place_or_realloc(arena, u8, (void*)a.data, a.length, new_length);
+        memcpy(data + a.length, b.data, b.length);
+    }
+
+    String ret = {
+        .data = data,
+        .length = new_length
+    };
+    return ret;
+}
+
+u64 string_hash(String str) {
+    // Multiply and rotate 8 bytes at a time, then mix the result with the finalizer of MurmurHash3 so every bit of the
+    // input affects the lower 7 bits and the position in the hash map
+    const u64 multiplier = 0x9E3779B97F4A7C15ull;
+    u64 hash = str.length*multiplier;
+
+    u64 i = 0;
+    for (; i + 8 <= str.length; i += 8) {
+        u64 word;
+        memcpy(&word, str.data + i, 8);
+        hash = (hash ^ word)*multiplier;
+        hash = (hash << 31) | (hash >> 33);
+    }
+    if (i < str.length) {
+        u64 word = 0;
+        memcpy(&word, str.data + i, str.length - i);
+        hash = (hash ^ word)*multiplier;
+    }
+
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// ####################################################################################################################
+// File I/O
+bool read_entire_file(Arena *arena, String file_name, Buffer *out_file_buffer) {
+    assert(out_file_buffer != 0);
+
+    // The C-string is only needed to open the file, so it's pushed into a scratch arena instead of wasting memory in the
+    // output arena
+    u64 arena_original_pos = arena_get_pos(arena);
+    TempArena scratch = scratch_begin(&arena, 1);
+    const char *file_name_cstr = string_to_cstring(scratch.arena, file_name);
+
+    bool ok = true;
+    u8 *file_buffer = 0;
+    u64 file_size = 0;
+
+#if _WIN32
+    // @TODO: Enable longer paths in Windows
+    // @NOTE: According to the Microsoft documentation "[OpenFile] has limited capabilities and is not recommended. For
+    // new application development, use the CreateFile function."
+    // Source (24/07/2025): https://learn.microsoft.com/en-us/windows/win32/api/winbase/nf-winbase-openfile?source=recommendations
     //
     // With CreateFile() we have also the benefit of supporting paths longer than MAX_PATH characters imposed by older
     // Windows editions.
@@ -356,121 +1384,3030 @@ bool read_entire_file(Arena *arena, String file_name, Buffer *out_file_buffer) {
         ok = false;
     }
 
-    // Get file size
-    LARGE_INTEGER li_file_size = {};
+    // Get file size
+    LARGE_INTEGER li_file_size = {};
+    if (ok) {
+        // @NOTE: Microsoft documentation recommends to use GetFileSizeEx() instead of GetFileSize()
+        // Source (24/07/2025): https://learn.microsoft.com/en-us/windows/win32/api/fileapi/nf-fileapi-getfilesize
+        if (GetFileSizeEx(fd, &li_file_size) == 0) {
+            ok = false;
+        }
+    }
+
+    // Read the entire file into RAM
+    if (ok) {
+        file_size = (u64)li_file_size.QuadPart;
+        file_buffer = arena_push(arena, u8, file_size);
+
+        u64 total_read = 0;
+        while (total_read < file_size) {
+            DWORD bytes_read = 0;
+            BOOL read_ok = ReadFile(
+                fd,                         // File descriptor
+                file_buffer + total_read,   // Output buffer
+                file_size - total_read,     // Bytes to read
+                &bytes_read,                // Pointer to number of bytes read
+                NULL
+            );
+            if (!read_ok) {
+                ok = false;
+                break;
+            }
+
+            total_read += bytes_read;
+        }
+    }
+
+    if (fd != INVALID_HANDLE_VALUE) {
+        CloseHandle(fd);
+    }
+
+#elif __linux__
+    int fd = open(file_name_cstr, O_RDONLY);
+    if (fd == -1) {
+        ok = false;
+    }
+
+    // Get file size
+    struct stat st = {};
+    if (ok) {
+        if (fstat(fd, &st) == -1) {
+            ok = false;
+        }
+    }
+
+    // Read the entire file into RAM
+    if (ok) {
+        file_size = (u64)st.st_size;
+        file_buffer = arena_push(arena, u8, file_size);
+
+        u64 total_read = 0;
+        while (total_read < file_size) {
+            u64 bytes_read = (u64)read(fd, file_buffer + total_read, file_size - total_read);
+            if (bytes_read == 0) {
+                ok = false;
+                break;
+            }
+
+            total_read += bytes_read;
+        }
+    }
+
+    if (fd != -1) {
+        close(fd);
+    }
+
+#else
+    // Fallback implementation with C-standard library
+
+    // Read in binary mode because some operating systems like Windows try to convert some characters and we don't want that
+    FILE *file = fopen(file_name_cstr, "rb");
+    if (file == 0) {
+        ok = false;
+    }
+
+    if (ok) {
+        // Get file size
+        fseek(file, 0, SEEK_END);
+        file_size = (u64) ftell(file);
+        fseek(file, 0, SEEK_SET);
+
+        // Read the entire file into RAM
+        file_buffer = arena_push(arena, u8, file_size);
+        u64 total_read = 0;
+        while (total_read < file_size) {
+            u64 bytes_read = (u64) fread(file_buffer + total_read, 1, file_size - total_read, file);
+            if (bytes_read == 0) {
+                ok = false;
+                break;
+            }
+
+            total_read += bytes_read;
+        }
+    }
+
+    if (file != 0) {
+        fclose(file);
+    }
+
+#endif
+
+    if (ok) {
+        out_file_buffer->data = file_buffer;
+        out_file_buffer->length = file_size;
+    } else {
+        // Failed to read file. Deallocate any memory used.
+        arena_set_pos(arena, arena_original_pos);
+    }
+
+    scratch_end(scratch);
+    return ok;
+}
+
+// Read until the end of the file for files whose size isn't known in advance. The buffer doubles its size in place while
+// it's the last element of the arena.
+#ifdef _WIN32
+static bool read_file_until_end(Arena *arena, HANDLE fd, Buffer *out_buffer) {
+#else
+static bool read_file_until_end(Arena *arena, int fd, Buffer *out_buffer) {
+#endif
+    u64 capacity = 64*KiB;
+    u8 *buffer = arena_push_nozero(arena, u8, capacity);
+    u64 length = 0;
+    for (;;) {
+        if (length == capacity) {
+            buffer = arena_grow_in_place_or_realloc(arena, u8, buffer, capacity, 2*capacity);
+            capacity *= 2;
+        }
+
+#ifdef _WIN32
+        DWORD bytes_read = 0;
+        DWORD to_read = (DWORD)MIN(capacity - length, (u64)GiB);
+        if (!ReadFile(fd, buffer + length, to_read, &bytes_read, NULL)) {
+            // Pipes report the end of the file as an error when the writer closes them
+            if (GetLastError() == ERROR_BROKEN_PIPE) {
+                break;
+            }
+            return false;
+        }
+#elif __linux__
+        ssize_t bytes_read = read(fd, buffer + length, capacity - length);
+        if (bytes_read == -1 && errno == EINTR) {
+            continue;
+        }
+        if (bytes_read < 0) {
+            return false;
+        }
+#else
+    #error "Not implemented for your platform"
+#endif
+        if (bytes_read == 0) {
+            break;
+        }
+        length += (u64)bytes_read;
+    }
+
+    out_buffer->data = buffer;
+    out_buffer->length = length;
+    return true;
+}
+
+bool map_entire_file(Arena *arena, String file_name, u32 flags, MappedFile *out_file) {
+    assert(out_file != 0);
+
+    u64 arena_original_pos = arena_get_pos(arena);
+    TempArena scratch = scratch_begin(&arena, 1);
+    const char *file_name_cstr = string_to_cstring(scratch.arena, file_name);
+
+    bool ok = true;
+    MappedFile file = {};
+
+#ifdef _WIN32
+    DWORD attributes = FILE_ATTRIBUTE_NORMAL;
+    if (flags & MAP_FILE_SEQUENTIAL) {
+        attributes |= FILE_FLAG_SEQUENTIAL_SCAN;
+    }
+    HANDLE fd = CreateFileA(file_name_cstr, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, attributes, NULL);
+    if (fd == INVALID_HANDLE_VALUE) {
+        ok = false;
+    }
+
+    LARGE_INTEGER file_size = {};
+    bool can_map = false;
+    if (ok) {
+        can_map = GetFileType(fd) == FILE_TYPE_DISK && GetFileSizeEx(fd, &file_size) && file_size.QuadPart > 0;
+    }
+
+    if (ok && can_map) {
+        // @NOTE: the view keeps the mapping object alive, so its handle can be closed right away
+        HANDLE mapping = CreateFileMappingA(fd, NULL, PAGE_READONLY, 0, 0, NULL);
+        void *view = 0;
+        if (mapping != NULL) {
+            view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+        }
+
+        if (view != 0) {
+            file.contents.data = (u8*)view;
+            file.contents.length = (u64)file_size.QuadPart;
+            file._is_mapped = true;
+            if (flags & MAP_FILE_WILL_NEED) {
+                WIN32_MEMORY_RANGE_ENTRY range = { view, (SIZE_T)file_size.QuadPart };
+                PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+            }
+        } else {
+            ok = false;
+        }
+    } else if (ok) {
+        ok = read_file_until_end(arena, fd, &file.contents);
+    }
+
+    if (fd != INVALID_HANDLE_VALUE) {
+        CloseHandle(fd);
+    }
+
+#elif __linux__
+    int fd = open(file_name_cstr, O_RDONLY);
+    if (fd == -1) {
+        ok = false;
+    }
+
+    struct stat st = {};
+    if (ok && fstat(fd, &st) == -1) {
+        ok = false;
+    }
+
+    if (ok && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *memory = mmap(0, (u64)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (memory != MAP_FAILED) {
+            file.contents.data = (u8*)memory;
+            file.contents.length = (u64)st.st_size;
+            file._is_mapped = true;
+            if (flags & MAP_FILE_SEQUENTIAL) {
+                madvise(memory, (u64)st.st_size, MADV_SEQUENTIAL);
+            }
+            if (flags & MAP_FILE_WILL_NEED) {
+                madvise(memory, (u64)st.st_size, MADV_WILLNEED);
+            }
+        } else {
+            ok = false;
+        }
+    } else if (ok) {
+        ok = read_file_until_end(arena, fd, &file.contents);
+    }
+
+    // @NOTE: the mapping stays valid after closing the file
+    if (fd != -1) {
+        close(fd);
+    }
+
+#else
+    UNUSED(flags);
+    UNUSED(file_name_cstr);
+    ok = read_entire_file(arena, file_name, &file.contents);
+#endif
+
+    if (ok) {
+        *out_file = file;
+    } else {
+        // Failed to read file. Deallocate any memory used.
+        arena_set_pos(arena, arena_original_pos);
+    }
+
+    scratch_end(scratch);
+    return ok;
+}
+
+void unmap_file(MappedFile *file) {
+    if (file->_is_mapped) {
+#ifdef _WIN32
+        UnmapViewOfFile(file->contents.data);
+#elif __linux__
+        munmap(file->contents.data, file->contents.length);
+#endif
+    }
+    MappedFile empty = {};
+    *file = empty;
+}
+
+// ====================================================================================================================
+// Reading many files
+
+// Read the files of indices[next_index...] one by one in several threads. Arena pushes are serialized with a mutex.
+typedef struct {
+    Arena *arena;
+    Mutex arena_mutex;
+    const String *file_names;
+    Buffer *out_files;
+    bool *out_ok;
+    const u64 *indices;     // Indices in file_names of the files to read
+    u64 count;              // Number of indices
+    volatile u64 next_index;
+} ReadFilesContext;
+
+static bool read_files_thread_read_one(ReadFilesContext *context, Arena *scratch_arena, const char *file_name_cstr,
+                                       Buffer *out_buffer) {
+    bool ok = true;
+    u8 *data = 0;
+    u64 size = 0;
+    Buffer contents = {};
+
+#ifdef _WIN32
+    HANDLE fd = CreateFileA(file_name_cstr, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fd == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER file_size = {};
+    bool has_size = GetFileType(fd) == FILE_TYPE_DISK && GetFileSizeEx(fd, &file_size) && file_size.QuadPart > 0;
+    if (has_size) {
+        size = (u64)file_size.QuadPart;
+        mutex_lock(&context->arena_mutex);
+        data = arena_push_nozero(context->arena, u8, size);
+        mutex_unlock(&context->arena_mutex);
+    } else {
+        ok = read_file_until_end(scratch_arena, fd, &contents);
+    }
+
+    u64 total_read = 0;
+    while (has_size && total_read < size) {
+        DWORD bytes_read = 0;
+        DWORD to_read = (DWORD)MIN(size - total_read, (u64)GiB);
+        if (!ReadFile(fd, data + total_read, to_read, &bytes_read, NULL) || bytes_read == 0) {
+            ok = false;
+            break;
+        }
+        total_read += bytes_read;
+    }
+    CloseHandle(fd);
+
+#elif __linux__
+    int fd = open(file_name_cstr, O_RDONLY|O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+
+    struct stat st = {};
+    bool has_size = fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0;
+    if (has_size) {
+        size = (u64)st.st_size;
+        mutex_lock(&context->arena_mutex);
+        data = arena_push_nozero(context->arena, u8, size);
+        mutex_unlock(&context->arena_mutex);
+    } else {
+        ok = read_file_until_end(scratch_arena, fd, &contents);
+    }
+
+    u64 total_read = 0;
+    while (has_size && total_read < size) {
+        ssize_t bytes_read = pread(fd, data + total_read, size - total_read, (off_t)total_read);
+        if (bytes_read == -1 && errno == EINTR) {
+            continue;
+        }
+        if (bytes_read <= 0) {
+            ok = false;
+            break;
+        }
+        total_read += (u64)bytes_read;
+    }
+    close(fd);
+
+#else
+    #error "Not implemented for your platform"
+#endif
+
+    if (has_size) {
+        out_buffer->data = data;
+        out_buffer->length = size;
+    } else if (ok && contents.length > 0) {
+        // @NOTE: files without a size are read into scratch memory, so the mutex is only held to push the copy
+        mutex_lock(&context->arena_mutex);
+        out_buffer->data = arena_push_nozero(context->arena, u8, contents.length);
+        mutex_unlock(&context->arena_mutex);
+        memcpy(out_buffer->data, contents.data, contents.length);
+        out_buffer->length = contents.length;
+    }
+    return ok;
+}
+
+static void read_files_thread(void *arg) {
+    ReadFilesContext *context = (ReadFilesContext*)arg;
+    TempArena scratch = scratch_begin(&context->arena, 1);
+    for (;;) {
+        u64 next = atomic_fetch_add_u64(&context->next_index, 1);
+        if (next >= context->count) {
+            break;
+        }
+        u64 index = context->indices[next];
+
+        u64 scratch_pos = arena_get_pos(scratch.arena);
+        const char *file_name_cstr = string_to_cstring(scratch.arena, context->file_names[index]);
+        context->out_ok[index] = read_files_thread_read_one(context, scratch.arena, file_name_cstr, &context->out_files[index]);
+        arena_set_pos(scratch.arena, scratch_pos);
+    }
+    scratch_end(scratch);
+}
+
+static void read_files_with_threads(Arena *arena, const String *file_names, const u64 *indices, u64 count, Buffer *out_files,
+                                    bool *out_ok) {
+    ReadFilesContext context = {};
+    context.arena = arena;
+    context.file_names = file_names;
+    context.out_files = out_files;
+    context.out_ok = out_ok;
+    context.indices = indices;
+    context.count = count;
+
+    // Threads mostly wait for the disk, so there are more of them than processors
+    u64 thread_count = MIN(MIN((u64)2*get_cpu_count(), (u64)READ_FILES_MAX_THREADS), count);
+    Thread threads[READ_FILES_MAX_THREADS];
+    for (u64 i = 0; i < thread_count; i++) {
+        threads[i] = thread_create(read_files_thread, &context);
+    }
+    for (u64 i = 0; i < thread_count; i++) {
+        thread_join(threads[i]);
+    }
+}
+
+#ifdef __linux__
+// Minimal io_uring built on the raw syscalls, so there's no dependency on liburing
+typedef struct {
+    int fd;
+    volatile u32 *sq_head;
+    volatile u32 *sq_tail;
+    u32 sq_mask;
+    u32 *sq_array;
+    struct io_uring_sqe *sqes;
+    volatile u32 *cq_head;
+    volatile u32 *cq_tail;
+    u32 cq_mask;
+    struct io_uring_cqe *cqes;
+    u32 to_submit;          // SQEs queued since the last io_uring_enter()
+
+    void *sq_ring;
+    u64 sq_ring_size;
+    void *cq_ring;
+    u64 cq_ring_size;
+    u64 sqes_size;
+} IoUring;
+
+static void uring_free(IoUring *ring) {
+    if (ring->sqes != 0) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_ring != 0 && ring->cq_ring != ring->sq_ring) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    if (ring->sq_ring != 0) {
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    }
+    close(ring->fd);
+}
+
+// Returns false if io_uring is not available, for example in old kernels or when a seccomp filter blocks it
+static bool uring_init(IoUring *ring, u32 entries) {
+    IoUring result = {};
+    struct io_uring_params params = {};
+    result.fd = (int)syscall(SYS_io_uring_setup, entries, &params);
+    if (result.fd < 0) {
+        return false;
+    }
+
+    // IORING_OP_OPENAT, IORING_OP_STATX and IORING_OP_CLOSE need Linux 5.6, the same version that added this feature
+    if (!(params.features & IORING_FEAT_RW_CUR_POS)) {
+        close(result.fd);
+        return false;
+    }
+
+    result.sq_ring_size = params.sq_off.array + params.sq_entries*sizeof(u32);
+    result.cq_ring_size = params.cq_off.cqes + params.cq_entries*sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        result.sq_ring_size = MAX(result.sq_ring_size, result.cq_ring_size);
+    }
+    result.sqes_size = params.sq_entries*sizeof(struct io_uring_sqe);
+
+    bool ok = true;
+    void *memory = mmap(0, result.sq_ring_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, result.fd, IORING_OFF_SQ_RING);
+    ok = memory != MAP_FAILED;
+    result.sq_ring = ok ? memory : 0;
+    if (ok && (params.features & IORING_FEAT_SINGLE_MMAP)) {
+        result.cq_ring = result.sq_ring;
+    } else if (ok) {
+        memory = mmap(0, result.cq_ring_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, result.fd, IORING_OFF_CQ_RING);
+        ok = memory != MAP_FAILED;
+        result.cq_ring = ok ? memory : 0;
+    }
+    if (ok) {
+        memory = mmap(0, result.sqes_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, result.fd, IORING_OFF_SQES);
+        ok = memory != MAP_FAILED;
+        result.sqes = ok ? (struct io_uring_sqe*)memory : 0;
+    }
+    if (!ok) {
+        uring_free(&result);
+        return false;
+    }
+
+    u8 *sq_ring = (u8*)result.sq_ring;
+    u8 *cq_ring = (u8*)result.cq_ring;
+    result.sq_head = (volatile u32*)(sq_ring + params.sq_off.head);
+    result.sq_tail = (volatile u32*)(sq_ring + params.sq_off.tail);
+    result.sq_mask = *(u32*)(sq_ring + params.sq_off.ring_mask);
+    result.sq_array = (u32*)(sq_ring + params.sq_off.array);
+    result.cq_head = (volatile u32*)(cq_ring + params.cq_off.head);
+    result.cq_tail = (volatile u32*)(cq_ring + params.cq_off.tail);
+    result.cq_mask = *(u32*)(cq_ring + params.cq_off.ring_mask);
+    result.cqes = (struct io_uring_cqe*)(cq_ring + params.cq_off.cqes);
+    *ring = result;
+    return true;
+}
+
+// The caller makes sure there's room in the submission queue
+static struct io_uring_sqe *uring_push_sqe(IoUring *ring, u8 opcode, int fd, u64 addr, u32 len, u64 offset, u64 user_data) {
+    u32 tail = *ring->sq_tail;
+    u32 index = tail & ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = addr;
+    sqe->len = len;
+    sqe->off = offset;
+    sqe->user_data = (u64)opcode << 32 | user_data;
+    ring->sq_array[index] = index;
+    atomic_store_u32(ring->sq_tail, tail + 1);
+    ring->to_submit += 1;
+    return sqe;
+}
+
+// Submit the queued SQEs and wait until there's at least one completion
+static bool uring_submit_and_wait(IoUring *ring) {
+    for (;;) {
+        long result = syscall(SYS_io_uring_enter, ring->fd, ring->to_submit, 1, IORING_ENTER_GETEVENTS, 0, 0);
+        if (result >= 0) {
+            ring->to_submit -= (u32)result;
+            return true;
+        }
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+}
+
+typedef enum {
+    URING_FILE_OPEN,            // Waiting for the openat and the statx of the file
+    URING_FILE_READ,
+    URING_FILE_CLOSE,
+} UringFileStage;
+
+typedef struct {
+    u64 index;                  // Index of the file in file_names
+    UringFileStage stage;
+    u32 pending;                // Operations in flight
+    int fd;                     // -1 when the file is not open
+    bool ok;
+    u64 total_read;
+    struct statx stx;
+} UringFile;
+
+// The user data of every operation is its opcode in the upper 32 bits and the slot of its file in the lower ones
+static void uring_read_next_part(IoUring *ring, UringFile *file, u64 slot, Buffer *out_buffer) {
+    u64 remaining = out_buffer->length - file->total_read;
+    u32 size = (u32)MIN(remaining, (u64)GiB);
+    uring_push_sqe(ring, IORING_OP_READ, file->fd, (u64)(out_buffer->data + file->total_read), size, file->total_read, slot);
+    file->pending += 1;
+}
+
+static void uring_close_file(IoUring *ring, UringFile *file, u64 slot) {
+    file->stage = URING_FILE_CLOSE;
+    if (file->fd >= 0) {
+        uring_push_sqe(ring, IORING_OP_CLOSE, file->fd, 0, 0, 0, slot);
+        file->pending += 1;
+    }
+}
+
+// Advance the file to the next stage once all its operations have completed
+static void uring_file_step(IoUring *ring, Arena *arena, UringFile *file, u64 slot, Buffer *out_buffer) {
+    if (file->stage == URING_FILE_OPEN) {
+        bool has_size = S_ISREG(file->stx.stx_mode) && file->stx.stx_size > 0;
+        if (file->ok && has_size) {
+            file->stage = URING_FILE_READ;
+            out_buffer->data = arena_push_nozero(arena, u8, file->stx.stx_size);
+            out_buffer->length = file->stx.stx_size;
+            uring_read_next_part(ring, file, slot, out_buffer);
+        } else {
+            // @NOTE: pipes and files that report a size of 0, like the ones in /proc, are read with blocking calls
+            if (file->ok) {
+                file->ok = read_file_until_end(arena, file->fd, out_buffer);
+            }
+            uring_close_file(ring, file, slot);
+        }
+    } else if (file->stage == URING_FILE_READ) {
+        if (file->ok && file->total_read < out_buffer->length) {
+            uring_read_next_part(ring, file, slot, out_buffer);
+        } else {
+            uring_close_file(ring, file, slot);
+        }
+    }
+}
+
+// Called when io_uring_enter() fails. The operations in flight point to the paths in the scratch arena and to the statx
+// buffers of the slots, so they must complete before those are released. The SQEs that the kernel hasn't consumed yet
+// are taken back instead of waited for, and the files that are still open are closed.
+static void uring_abort_files(IoUring *ring, UringFile *files, u64 slot_count) {
+    // @NOTE: without IORING_SETUP_SQPOLL the kernel only consumes SQEs inside io_uring_enter(), so the ones between the
+    // head and the tail can be removed by moving the tail back
+    u32 sq_head = atomic_load_u32(ring->sq_head);
+    u32 sq_tail = *ring->sq_tail;
+    for (u32 i = sq_head; i != sq_tail; i++) {
+        struct io_uring_sqe *sqe = &ring->sqes[ring->sq_array[i & ring->sq_mask]];
+        files[sqe->user_data & 0xFFFFFFFF].pending -= 1;
+    }
+    atomic_store_u32(ring->sq_tail, sq_head);
+    ring->to_submit = 0;
+
+    for (;;) {
+        u32 in_flight = 0;
+        for (u64 slot = 0; slot < slot_count; slot++) {
+            in_flight += files[slot].pending;
+        }
+        if (in_flight == 0 || !uring_submit_and_wait(ring)) {
+            break;
+        }
+
+        u32 head = *ring->cq_head;
+        u32 tail = atomic_load_u32(ring->cq_tail);
+        for (; head != tail; head++) {
+            struct io_uring_cqe *cqe = &ring->cqes[head & ring->cq_mask];
+            UringFile *file = &files[cqe->user_data & 0xFFFFFFFF];
+            u8 opcode = (u8)(cqe->user_data >> 32);
+            file->pending -= 1;
+            if (opcode == IORING_OP_OPENAT && cqe->res >= 0) {
+                file->fd = cqe->res;
+            } else if (opcode == IORING_OP_CLOSE) {
+                file->fd = -1;
+            }
+        }
+        atomic_store_u32(ring->cq_head, head);
+    }
+
+    for (u64 slot = 0; slot < slot_count; slot++) {
+        if (files[slot].fd >= 0) {
+            close(files[slot].fd);
+            files[slot].fd = -1;
+        }
+    }
+}
+
+// out_done[i] is set for the files that were read, or failed to be read. It stays unset for every file if io_uring is
+// not available, and for the rest of files if io_uring fails halfway.
+static void read_files_with_uring(Arena *arena, const String *file_names, u64 count, Buffer *out_files, bool *out_ok,
+                                  bool *out_done) {
+    IoUring ring;
+    if (!uring_init(&ring, 2*READ_FILES_IN_FLIGHT)) {
+        return;
+    }
+
+    TempArena scratch = scratch_begin(&arena, 1);
+    UringFile files[READ_FILES_IN_FLIGHT];
+    u64 free_slots[READ_FILES_IN_FLIGHT];
+    u64 free_slot_count = READ_FILES_IN_FLIGHT;
+    for (u64 i = 0; i < READ_FILES_IN_FLIGHT; i++) {
+        UringFile empty = {};
+        files[i] = empty;
+        files[i].fd = -1;
+        free_slots[i] = READ_FILES_IN_FLIGHT - 1 - i;
+    }
+
+    u64 next_index = 0;
+    u64 finished = 0;
+    while (finished < count) {
+        // Start new files while there are free slots. Every file needs at most 2 SQEs at the same time.
+        while (next_index < count && free_slot_count > 0) {
+            u64 slot = free_slots[--free_slot_count];
+            UringFile *file = &files[slot];
+            UringFile empty = {};
+            *file = empty;
+            file->index = next_index;
+            file->fd = -1;
+            file->ok = true;
+            file->pending = 2;
+
+            // @NOTE: the path must stay valid until the operations complete, so it's released after the loop
+            const char *path = string_to_cstring(scratch.arena, file_names[next_index]);
+            struct io_uring_sqe *sqe = uring_push_sqe(&ring, IORING_OP_OPENAT, AT_FDCWD, (u64)path, 0, 0, slot);
+            sqe->open_flags = O_RDONLY|O_CLOEXEC;
+            uring_push_sqe(&ring, IORING_OP_STATX, AT_FDCWD, (u64)path, STATX_TYPE|STATX_SIZE, (u64)&file->stx, slot);
+            next_index += 1;
+        }
+
+        if (!uring_submit_and_wait(&ring)) {
+            uring_abort_files(&ring, files, READ_FILES_IN_FLIGHT);
+            break;
+        }
+
+        u32 head = *ring.cq_head;
+        u32 tail = atomic_load_u32(ring.cq_tail);
+        for (; head != tail; head++) {
+            struct io_uring_cqe *cqe = &ring.cqes[head & ring.cq_mask];
+            u64 slot = cqe->user_data & 0xFFFFFFFF;
+            u8 opcode = (u8)(cqe->user_data >> 32);
+            UringFile *file = &files[slot];
+            Buffer *out_buffer = &out_files[file->index];
+            file->pending -= 1;
+
+            if (opcode == IORING_OP_CLOSE) {
+                file->fd = -1;
+            }
+            if (cqe->res < 0) {
+                file->ok = false;
+            } else if (opcode == IORING_OP_OPENAT) {
+                file->fd = cqe->res;
+            } else if (opcode == IORING_OP_READ) {
+                if (cqe->res == 0) {
+                    // The file is shorter than it was when it was stat'ed
+                    out_buffer->length = file->total_read;
+                } else {
+                    file->total_read += (u64)cqe->res;
+                }
+            }
+
+            if (file->pending == 0) {
+                uring_file_step(&ring, arena, file, slot, out_buffer);
+            }
+            if (file->pending == 0 && file->stage == URING_FILE_CLOSE) {
+                out_ok[file->index] = file->ok;
+                out_done[file->index] = true;
+                finished += 1;
+                free_slots[free_slot_count++] = slot;
+            }
+        }
+        atomic_store_u32(ring.cq_head, head);
+    }
+
+    scratch_end(scratch);
+    uring_free(&ring);
+}
+#endif
+
+bool read_entire_files(Arena *arena, const String *file_names, u64 count, u32 flags, Buffer *out_files, bool *out_ok) {
+    for (u64 i = 0; i < count; i++) {
+        Buffer empty = {};
+        out_files[i] = empty;
+        out_ok[i] = false;
+    }
+
+    TempArena scratch = scratch_begin(&arena, 1);
+    bool *done = arena_push(scratch.arena, bool, count);
+#ifdef __linux__
+    if (!(flags & READ_FILES_NO_IO_URING)) {
+        read_files_with_uring(arena, file_names, count, out_files, out_ok, done);
+    }
+#else
+    UNUSED(flags);
+#endif
+
+    // Read with threads the files that io_uring didn't, if it's not available or if it failed halfway
+    u64 *remaining = arena_push_nozero(scratch.arena, u64, count);
+    u64 remaining_count = 0;
+    for (u64 i = 0; i < count; i++) {
+        if (!done[i]) {
+            Buffer empty = {};
+            out_files[i] = empty;
+            remaining[remaining_count++] = i;
+        }
+    }
+    if (remaining_count > 0) {
+        read_files_with_threads(arena, file_names, remaining, remaining_count, out_files, out_ok);
+    }
+    scratch_end(scratch);
+
+    bool ok = true;
+    for (u64 i = 0; i < count; i++) {
+        ok = ok && out_ok[i];
+    }
+    return ok;
+}
+
+// ====================================================================================================================
+// Parallel reads of one file
+
+typedef struct {
+    u64 handle;
+    u8 *buffer;
+    u64 file_size;
+    u64 read_size;          // With direct I/O the file size is rounded up to whole pages
+    volatile u64 next_range;
+    volatile u32 failed;
+} ParallelReadContext;
+
+static void parallel_read_thread(void *arg) {
+    ParallelReadContext *context = (ParallelReadContext*)arg;
+#ifdef _WIN32
+    HANDLE event = CreateEventA(NULL, TRUE, FALSE, NULL);
+#endif
+    for (;;) {
+        u64 offset = atomic_fetch_add_u64(&context->next_range, 1)*READ_FILE_RANGE_SIZE;
+        if (offset >= context->read_size || atomic_load_u32(&context->failed)) {
+            break;
+        }
+
+        u64 end = MIN(offset + READ_FILE_RANGE_SIZE, context->read_size);
+        while (offset < end) {
+#ifdef _WIN32
+            OVERLAPPED overlapped = {};
+            overlapped.Offset = (DWORD)offset;
+            overlapped.OffsetHigh = (DWORD)(offset >> 32);
+            overlapped.hEvent = event;
+            DWORD bytes_read = 0;
+            BOOL read_ok = ReadFile((HANDLE)context->handle, context->buffer + offset, (DWORD)(end - offset), NULL, &overlapped);
+            if (read_ok || GetLastError() == ERROR_IO_PENDING) {
+                read_ok = GetOverlappedResult((HANDLE)context->handle, &overlapped, &bytes_read, TRUE);
+            }
+            if (!read_ok) {
+                bytes_read = 0;
+            }
+#elif __linux__
+            ssize_t bytes_read = pread((int)context->handle, context->buffer + offset, end - offset, (off_t)offset);
+            if (bytes_read == -1 && errno == EINTR) {
+                continue;
+            }
+#else
+    #error "Not implemented for your platform"
+#endif
+            if (bytes_read <= 0) {
+                break;
+            }
+            offset += (u64)bytes_read;
+        }
+
+        // @NOTE: with direct I/O the last range ends early because its size was rounded up past the end of the file
+        if (offset < MIN(end, context->file_size)) {
+            atomic_store_u32(&context->failed, 1);
+        }
+    }
+#ifdef _WIN32
+    CloseHandle(event);
+#endif
+}
+
+bool read_entire_file_parallel(Arena *arena, String file_name, u32 flags, Buffer *out_file_buffer) {
+    assert(out_file_buffer != 0);
+
+    u64 arena_original_pos = arena_get_pos(arena);
+    TempArena scratch = scratch_begin(&arena, 1);
+    const char *file_name_cstr = string_to_cstring(scratch.arena, file_name);
+
+    bool ok = true;
+    bool direct = (flags & READ_FILE_DIRECT) != 0;
+    u64 file_size = 0;
+
+#ifdef _WIN32
+    // @NOTE: reads of a synchronous handle are serialized, so the threads need an overlapped handle to run in parallel
+    DWORD attributes = FILE_FLAG_OVERLAPPED;
+    if (direct) {
+        attributes |= FILE_FLAG_NO_BUFFERING;
+    }
+    HANDLE fd = CreateFileA(file_name_cstr, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, attributes, NULL);
+    if (fd == INVALID_HANDLE_VALUE && direct) {
+        direct = false;
+        fd = CreateFileA(file_name_cstr, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, NULL);
+    }
+    if (fd == INVALID_HANDLE_VALUE) {
+        ok = false;
+    }
+
+    LARGE_INTEGER li_file_size = {};
+    bool has_size = ok && GetFileType(fd) == FILE_TYPE_DISK && GetFileSizeEx(fd, &li_file_size) && li_file_size.QuadPart > 0;
+    file_size = (u64)li_file_size.QuadPart;
+    if (ok && !has_size) {
+        // read_file_until_end() needs a synchronous handle
+        HANDLE synchronous_fd = ReOpenFile(fd, GENERIC_READ, FILE_SHARE_READ, 0);
+        CloseHandle(fd);
+        fd = synchronous_fd;
+        ok = fd != INVALID_HANDLE_VALUE;
+    }
+    u64 handle = (u64)fd;
+#elif __linux__
+    int fd = open(file_name_cstr, direct ? O_RDONLY|O_DIRECT : O_RDONLY);
+    if (fd == -1 && direct) {
+        // The file system doesn't support direct I/O, like tmpfs
+        direct = false;
+        fd = open(file_name_cstr, O_RDONLY);
+    }
+    if (fd == -1) {
+        ok = false;
+    }
+
+    struct stat st = {};
+    if (ok && fstat(fd, &st) == -1) {
+        ok = false;
+    }
+    bool has_size = ok && S_ISREG(st.st_mode) && st.st_size > 0;
+    file_size = (u64)st.st_size;
+    if (ok && !has_size && direct) {
+        // read_file_until_end() doesn't align its reads, so direct I/O is turned off
+        direct = false;
+        ok = fcntl(fd, F_SETFL, 0) != -1;
+    }
+    u64 handle = (u64)fd;
+#else
+    #error "Not implemented for your platform"
+#endif
+
+    u8 *buffer = 0;
+    if (ok && !has_size) {
+        // @NOTE: pipes and files that report a size of 0, like the ones in /proc, are read by this thread until the end
+        Buffer contents = {};
+        ok = read_file_until_end(arena, fd, &contents);
+        buffer = contents.data;
+        file_size = contents.length;
+    } else if (ok) {
+        ParallelReadContext context = {};
+        context.handle = handle;
+        context.file_size = file_size;
+        context.read_size = file_size;
+        if (direct) {
+            u64 page_size = get_page_size();
+            context.read_size = (file_size + page_size - 1)/page_size*page_size;
+            buffer = (u8*)ARENA_PUSH_DATA(arena, 1, MAX(context.read_size, page_size), page_size, 0);
+        } else {
+            buffer = arena_push_nozero(arena, u8, MAX(file_size, (u64)1));
+        }
+        context.buffer = buffer;
+
+        // The calling thread reads too
+        u64 range_count = (context.read_size + READ_FILE_RANGE_SIZE - 1)/READ_FILE_RANGE_SIZE;
+        u64 thread_count = MIN(range_count, (u64)READ_FILE_MAX_THREADS);
+        Thread threads[READ_FILE_MAX_THREADS];
+        for (u64 i = 1; i < thread_count; i++) {
+            threads[i] = thread_create(parallel_read_thread, &context);
+        }
+        parallel_read_thread(&context);
+        for (u64 i = 1; i < thread_count; i++) {
+            thread_join(threads[i]);
+        }
+        ok = context.failed == 0;
+    }
+
+#ifdef _WIN32
+    if (fd != INVALID_HANDLE_VALUE) {
+        CloseHandle(fd);
+    }
+#elif __linux__
+    if (fd != -1) {
+        close(fd);
+    }
+#endif
+
+    if (ok) {
+        out_file_buffer->data = buffer;
+        out_file_buffer->length = file_size;
+    } else {
+        // Failed to read file. Deallocate any memory used.
+        arena_set_pos(arena, arena_original_pos);
+    }
+
+    scratch_end(scratch);
+    return ok;
+}
+
+// ====================================================================================================================
+// Writing files
+#define WRITE_FILE_IOV_COUNT 64
+
+struct WriteBatchFile {
+    const char *temp_name;
+    const char *file_name;
+    u64 device;             // File system of the file, so each file system is flushed only once
+    bool failed;            // The rename failed, so the file can't be used to flush its file system
+    WriteBatchFile *next;
+};
+
+static volatile u64 write_file_temp_counter;
+
+// Unique name for a temporary file next to file_name. It must be in the same directory because rename() can't move files
+// between file systems.
+static const char *write_file_temp_name(Arena *arena, const char *file_name) {
+#ifdef _WIN32
+    u64 process_id = (u64)GetCurrentProcessId();
+#elif __linux__
+    u64 process_id = (u64)getpid();
+#else
+    #error "Not implemented for your platform"
+#endif
+    u64 counter = atomic_fetch_add_u64(&write_file_temp_counter, 1);
+    u64 size = strlen(file_name) + 64;
+    char *temp_name = arena_push_nozero(arena, char, size);
+    snprintf(temp_name, size, "%s.%llu.%llu.tmp", file_name, (unsigned long long)process_id, (unsigned long long)counter);
+    return temp_name;
+}
+
+// Path of the file that is replaced when writing to file_name. Symbolic links are resolved, because renaming over a link
+// would replace the link with a regular file instead of changing the file it points to.
+static const char *write_file_target(Arena *arena, const char *file_name) {
+#ifdef __linux__
+    struct stat st = {};
+    if (lstat(file_name, &st) == 0 && S_ISLNK(st.st_mode)) {
+        char *resolved = arena_push_nozero(arena, char, PATH_MAX);
+        if (realpath(file_name, resolved) != 0) {
+            return resolved;
+        }
+    }
+#else
+    UNUSED(arena);
+#endif
+    return file_name;
+}
+
+// Write every buffer, one after another, at the current position of the file
+#ifdef _WIN32
+static bool write_buffers(HANDLE fd, const Buffer *buffers, u64 count) {
+    for (u64 i = 0; i < count; i++) {
+        u64 total_written = 0;
+        while (total_written < buffers[i].length) {
+            DWORD bytes_written = 0;
+            DWORD bytes_to_write = (DWORD)MIN(buffers[i].length - total_written, (u64)GiB);
+            if (!WriteFile(fd, buffers[i].data + total_written, bytes_to_write, &bytes_written, NULL)) {
+                return false;
+            }
+            total_written += bytes_written;
+        }
+    }
+    return true;
+}
+#elif __linux__
+static bool write_buffers(int fd, const Buffer *buffers, u64 count) {
+    u64 index = 0;      // First buffer that is not completely written
+    u64 offset = 0;     // Bytes of buffers[index] already written
+    for (;;) {
+        while (index < count && offset == buffers[index].length) {
+            index += 1;
+            offset = 0;
+        }
+        if (index == count) {
+            return true;
+        }
+
+        struct iovec iov[WRITE_FILE_IOV_COUNT];
+        int iov_count = 0;
+        for (u64 i = index; i < count && iov_count < WRITE_FILE_IOV_COUNT; i++) {
+            u64 skip = i == index ? offset : 0;
+            if (buffers[i].length > skip) {
+                iov[iov_count].iov_base = buffers[i].data + skip;
+                iov[iov_count].iov_len = buffers[i].length - skip;
+                iov_count += 1;
+            }
+        }
+
+        ssize_t bytes_written = writev(fd, iov, iov_count);
+        if (bytes_written == -1 && errno == EINTR) {
+            continue;
+        }
+        if (bytes_written <= 0) {
+            return false;
+        }
+
+        // @NOTE: writes can be short, for example when a single writev() call reaches the 2 GiB limit of Linux
+        u64 remaining = (u64)bytes_written;
+        while (remaining > 0) {
+            u64 left = buffers[index].length - offset;
+            if (remaining < left) {
+                offset += remaining;
+                remaining = 0;
+            } else {
+                remaining -= left;
+                index += 1;
+                offset = 0;
+            }
+        }
+    }
+}
+#endif
+
+// Write the buffers into a new temporary file next to file_name. Returns its name, or 0 if it failed and it was deleted.
+static const char *write_temp_file(Arena *arena, const char *file_name, const Buffer *buffers, u64 count, bool sync, u64 *out_device) {
+    const char *temp_name = write_file_temp_name(arena, file_name);
+    bool ok = true;
+
+#ifdef _WIN32
+    HANDLE fd = CreateFileA(temp_name, GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fd == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+
+    ok = write_buffers(fd, buffers, count);
+    if (ok && sync && !FlushFileBuffers(fd)) {
+        ok = false;
+    }
+    if (!CloseHandle(fd)) {
+        ok = false;
+    }
+    *out_device = 0;
+
+    if (!ok) {
+        DeleteFileA(temp_name);
+    }
+#elif __linux__
+    // New files get 0666 minus the umask, like the ones created by fopen(). Replaced files keep their permissions.
+    int fd = open(temp_name, O_WRONLY|O_CREAT|O_EXCL|O_CLOEXEC, 0666);
+    if (fd == -1) {
+        return 0;
+    }
+
+    struct stat target = {};
+    if (stat(file_name, &target) == 0 && fchmod(fd, target.st_mode & 07777) == -1) {
+        ok = false;
+    }
+
+    ok = ok && write_buffers(fd, buffers, count);
+    if (ok && sync && fdatasync(fd) == -1) {
+        ok = false;
+    }
+    struct stat st = {};
+    if (ok && fstat(fd, &st) == -1) {
+        ok = false;
+    }
+    *out_device = (u64)st.st_dev;
+    if (close(fd) == -1) {
+        ok = false;
+    }
+
+    if (!ok) {
+        unlink(temp_name);
+    }
+#else
+    #error "Not implemented for your platform"
+#endif
+
+    return ok ? temp_name : 0;
+}
+
+// Atomically replace file_name with the temporary file. The temporary file is deleted if it fails.
+static bool write_file_replace(const char *temp_name, const char *file_name, bool sync) {
+#ifdef _WIN32
+    DWORD move_flags = MOVEFILE_REPLACE_EXISTING;
+    if (sync) {
+        move_flags |= MOVEFILE_WRITE_THROUGH;
+    }
+    bool ok = MoveFileExA(temp_name, file_name, move_flags) != 0;
+    if (!ok) {
+        DeleteFileA(temp_name);
+    }
+#elif __linux__
+    UNUSED(sync);
+    bool ok = rename(temp_name, file_name) == 0;
+    if (!ok) {
+        unlink(temp_name);
+    }
+#else
+    #error "Not implemented for your platform"
+#endif
+    return ok;
+}
+
+#ifdef __linux__
+// Flush the directory that contains file_name, so a rename into it survives a crash
+static bool sync_directory_of(Arena *arena, String file_name) {
+    String directory = string_from_cstring(".");
+    for (u64 i = file_name.length; i > 0; i--) {
+        if (file_name.data[i - 1] == '/') {
+            // @NOTE: files in the root directory keep the slash
+            directory = string_slice(file_name, 0, MAX(i - 1, (u64)1));
+            break;
+        }
+    }
+
+    int fd = open(string_to_cstring(arena, directory), O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+#endif
+
+bool write_entire_file(String file_name, Buffer data, u32 flags) {
+    bool ok = write_entire_file_gather(file_name, &data, 1, flags);
+    return ok;
+}
+
+bool write_entire_file_gather(String file_name, const Buffer *buffers, u64 count, u32 flags) {
+    assert(count == 0 || buffers != 0);
+
+    TempArena scratch = scratch_begin(0, 0);
+    const char *file_name_cstr = write_file_target(scratch.arena, string_to_cstring(scratch.arena, file_name));
+    bool sync = (flags & WRITE_FILE_SYNC) != 0;
+
+    u64 device = 0;
+    const char *temp_name = write_temp_file(scratch.arena, file_name_cstr, buffers, count, sync, &device);
+    bool ok = temp_name != 0 && write_file_replace(temp_name, file_name_cstr, sync);
+#ifdef __linux__
+    if (ok && sync) {
+        ok = sync_directory_of(scratch.arena, string_from_cstring(file_name_cstr));
+    }
+#endif
+
+    scratch_end(scratch);
+    return ok;
+}
+
+WriteBatch write_batch_begin(Arena *arena) {
+    WriteBatch batch = {};
+    batch._arena = arena;
+    return batch;
+}
+
+bool write_batch_add(WriteBatch *batch, String file_name, const Buffer *buffers, u64 count) {
+    assert(batch->_arena != 0);
+    assert(count == 0 || buffers != 0);
+
+    Arena *arena = batch->_arena;
+    u64 arena_original_pos = arena_get_pos(arena);
+
+    const char *file_name_cstr = write_file_target(arena, string_to_cstring(arena, file_name));
+    u64 device = 0;
+    const char *temp_name = write_temp_file(arena, file_name_cstr, buffers, count, false, &device);
+    if (temp_name == 0) {
+        arena_set_pos(arena, arena_original_pos);
+        return false;
+    }
+
+    WriteBatchFile *file = arena_push(arena, WriteBatchFile);
+    file->temp_name = temp_name;
+    file->file_name = file_name_cstr;
+    file->device = device;
+    if (batch->_last != 0) {
+        batch->_last->next = file;
+    } else {
+        batch->_first = file;
+    }
+    batch->_last = file;
+    return true;
+}
+
+#ifdef __linux__
+// Flush every file system with a file of the batch once. The files were closed, so they are opened again by name.
+static bool write_batch_sync(WriteBatch *batch, bool renamed) {
+    bool ok = true;
+    for (WriteBatchFile *file = batch->_first; file != 0; file = file->next) {
+        if (file->failed) {
+            continue;
+        }
+
+        // @NOTE: batches rarely span more than a couple of file systems, so the search stops almost right away
+        bool is_synced = false;
+        for (WriteBatchFile *prev = batch->_first; prev != file && !is_synced; prev = prev->next) {
+            is_synced = !prev->failed && prev->device == file->device;
+        }
+        if (is_synced) {
+            continue;
+        }
+
+        int fd = open(renamed ? file->file_name : file->temp_name, O_RDONLY|O_CLOEXEC);
+        if (fd == -1 || syncfs(fd) == -1) {
+            ok = false;
+        }
+        if (fd != -1) {
+            close(fd);
+        }
+    }
+    return ok;
+}
+#endif
+
+bool write_batch_commit(WriteBatch *batch) {
+    // Flush the data before any rename, otherwise a crash could replace a file with one that wasn't written yet
+#ifdef _WIN32
+    // @NOTE: flushing a whole volume requires administrator rights, so every file is flushed on its own
+    bool ok = true;
+    for (WriteBatchFile *file = batch->_first; file != 0 && ok; file = file->next) {
+        HANDLE fd = CreateFileA(file->temp_name, GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (fd == INVALID_HANDLE_VALUE) {
+            ok = false;
+            break;
+        }
+        ok = FlushFileBuffers(fd) != 0;
+        CloseHandle(fd);
+    }
+#elif __linux__
+    bool ok = write_batch_sync(batch, false);
+#else
+    #error "Not implemented for your platform"
+#endif
+    if (!ok) {
+        write_batch_cancel(batch);
+        return false;
+    }
+
+    for (WriteBatchFile *file = batch->_first; file != 0; file = file->next) {
+        if (!write_file_replace(file->temp_name, file->file_name, true)) {
+            file->failed = true;
+            ok = false;
+        }
+    }
+
+#ifdef __linux__
+    if (!write_batch_sync(batch, true)) {
+        ok = false;
+    }
+#endif
+
+    batch->_first = 0;
+    batch->_last = 0;
+    return ok;
+}
+
+void write_batch_cancel(WriteBatch *batch) {
+    for (WriteBatchFile *file = batch->_first; file != 0; file = file->next) {
+#ifdef _WIN32
+        DeleteFileA(file->temp_name);
+#elif __linux__
+        unlink(file->temp_name);
+#else
+    #error "Not implemented for your platform"
+#endif
+    }
+    batch->_first = 0;
+    batch->_last = 0;
+}
+
+// ####################################################################################################################
+// File cache
+
+// Version of a file. The inode catches files replaced with a rename even if they have the same size and modification
+// time. Windows can't tell the id of a file without opening it, so it's always 0 there.
+typedef struct {
+    u64 modification_time;
+    u64 size;
+    u64 file_id;
+} FileCacheStamp;
+
+// @NOTE: entries have the size of their file and they are released in any order, as files are evicted and buffers are
+// given back, so they live in a TLSF Heap. Arena-backed slabs would need a size class for every file size or waste the
+// end of each slot, and the memory of a slab could only be reused once every entry in it is gone.
+struct FileCacheEntry {
+    String path;                    // Key in the map. It points into the memory of the entry.
+    Buffer contents;                // Right after the entry
+    FileCacheStamp stamp;
+    FileCacheEntry *lru_prev;
+    FileCacheEntry *lru_next;
+    u64 block_size;                 // Bytes charged against the budget
+    u64 references;                 // Buffers returned by file_cache_read() that haven't been released
+    bool is_cached;                 // False once the entry is dropped. Its memory is released with the last reference.
+};
+
+struct FileCacheMapping {
+    MappedFile file;
+    FileCacheMapping *next;
+};
+
+static bool file_cache_stamp_equals(const FileCacheStamp *a, const FileCacheStamp *b) {
+    bool equals = a->modification_time == b->modification_time && a->size == b->size && a->file_id == b->file_id;
+    return equals;
+}
+
+#ifdef __linux__
+static FileCacheStamp file_cache_stamp_from_stat(const struct stat *st) {
+    FileCacheStamp stamp = {};
+    stamp.modification_time = (u64)st->st_mtim.tv_sec*1000000000ull + (u64)st->st_mtim.tv_nsec;
+    stamp.size = (u64)st->st_size;
+    stamp.file_id = (u64)st->st_ino;
+    return stamp;
+}
+#endif
+
+// Returns false if the file doesn't exist or it's not a regular file
+static bool file_cache_stat(const char *file_name, FileCacheStamp *out_stamp) {
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA data = {};
+    if (!GetFileAttributesExA(file_name, GetFileExInfoStandard, &data)) {
+        return false;
+    }
+    if (data.dwFileAttributes & (FILE_ATTRIBUTE_DIRECTORY|FILE_ATTRIBUTE_DEVICE)) {
+        return false;
+    }
+    FileCacheStamp stamp = {};
+    stamp.modification_time = ((u64)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+    stamp.size = ((u64)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+    *out_stamp = stamp;
+#elif __linux__
+    struct stat st = {};
+    if (stat(file_name, &st) == -1 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+    *out_stamp = file_cache_stamp_from_stat(&st);
+#else
+    #error "Not implemented for your platform"
+#endif
+    return true;
+}
+
+// Read the file into a new entry. The stamp is taken from the opened file before reading it, so if the file changes while
+// it's read the next read sees a different stamp and reads it again.
+static FileCacheEntry *file_cache_load(FileCache *cache, const char *file_name_cstr, String file_name) {
+    bool ok = true;
+    FileCacheStamp stamp = {};
+
+#ifdef _WIN32
+    HANDLE fd = CreateFileA(file_name_cstr, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fd == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+
+    BY_HANDLE_FILE_INFORMATION info = {};
+    if (!GetFileInformationByHandle(fd, &info) || (info.dwFileAttributes & (FILE_ATTRIBUTE_DIRECTORY|FILE_ATTRIBUTE_DEVICE))) {
+        ok = false;
+    }
+    stamp.modification_time = ((u64)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime;
+    stamp.size = ((u64)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+#elif __linux__
+    int fd = open(file_name_cstr, O_RDONLY|O_CLOEXEC);
+    if (fd == -1) {
+        return 0;
+    }
+
+    struct stat st = {};
+    if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+        ok = false;
+    }
+    stamp = file_cache_stamp_from_stat(&st);
+#else
+    #error "Not implemented for your platform"
+#endif
+
+    FileCacheEntry *entry = 0;
+    if (ok) {
+        u64 block_size = sizeof(FileCacheEntry) + stamp.size + file_name.length;
+        entry = (FileCacheEntry*)heap_push_data(&cache->_heap, block_size, alignof(FileCacheEntry), 0);
+        FileCacheEntry empty = {};
+        *entry = empty;
+        entry->contents.data = (u8*)(entry + 1);
+        entry->contents.length = stamp.size;
+        entry->stamp = stamp;
+        entry->block_size = block_size;
+
+        u8 *path = entry->contents.data + stamp.size;
+        memcpy(path, file_name.data, file_name.length);
+        entry->path.data = path;
+        entry->path.length = file_name.length;
+
+        // @NOTE: a file that shrinks while it's read fails, and it's read again next time
+        u64 total_read = 0;
+        while (total_read < stamp.size) {
+#ifdef _WIN32
+            DWORD bytes_read = 0;
+            DWORD bytes_to_read = (DWORD)MIN(stamp.size - total_read, (u64)GiB);
+            if (!ReadFile(fd, entry->contents.data + total_read, bytes_to_read, &bytes_read, NULL)) {
+                bytes_read = 0;
+            }
+#elif __linux__
+            ssize_t bytes_read = read(fd, entry->contents.data + total_read, stamp.size - total_read);
+            if (bytes_read == -1 && errno == EINTR) {
+                continue;
+            }
+#endif
+            if (bytes_read <= 0) {
+                ok = false;
+                break;
+            }
+            total_read += (u64)bytes_read;
+        }
+
+        if (!ok) {
+            heap_release(&cache->_heap, entry);
+            entry = 0;
+        }
+    }
+
+#ifdef _WIN32
+    CloseHandle(fd);
+#elif __linux__
+    close(fd);
+#endif
+
+    return entry;
+}
+
+// Files bigger than the budget would never be cached, and the heap can't hold files bigger than FILE_CACHE_CAPACITY, so
+// they are mapped instead of read
+static bool file_cache_map(FileCache *cache, Arena *scratch_arena, String file_name, Buffer *out_contents) {
+    FileCacheMapping *mapping = heap_push(&cache->_heap, FileCacheMapping);
+    // @NOTE: contents that can't be mapped are read into the scratch arena. That only happens if the file was replaced
+    // with something that isn't a regular file after it was stat'ed, so it fails.
+    bool ok = map_entire_file(scratch_arena, file_name, 0, &mapping->file) && mapping->file._is_mapped;
+    if (!ok) {
+        heap_release(&cache->_heap, mapping);
+        return false;
+    }
+
+    mapping->next = cache->_mappings;
+    cache->_mappings = mapping;
+    *out_contents = mapping->file.contents;
+    return true;
+}
+
+static void file_cache_lru_remove(FileCache *cache, FileCacheEntry *entry) {
+    if (entry->lru_prev != 0) {
+        entry->lru_prev->lru_next = entry->lru_next;
+    } else {
+        cache->_lru_first = entry->lru_next;
+    }
+    if (entry->lru_next != 0) {
+        entry->lru_next->lru_prev = entry->lru_prev;
+    } else {
+        cache->_lru_last = entry->lru_prev;
+    }
+    entry->lru_prev = 0;
+    entry->lru_next = 0;
+}
+
+static void file_cache_lru_push_front(FileCache *cache, FileCacheEntry *entry) {
+    entry->lru_next = cache->_lru_first;
+    if (cache->_lru_first != 0) {
+        cache->_lru_first->lru_prev = entry;
+    } else {
+        cache->_lru_last = entry;
+    }
+    cache->_lru_first = entry;
+}
+
+// Remove the entry from the cache. Its memory is released now or when its last buffer is released.
+static void file_cache_drop(FileCache *cache, FileCacheEntry *entry) {
+    string_map_remove(&cache->_map, entry->path);
+    file_cache_lru_remove(cache, entry);
+    cache->_stats.entry_count -= 1;
+    cache->_stats.used_size -= entry->block_size;
+    entry->is_cached = false;
+    if (entry->references == 0) {
+        heap_release(&cache->_heap, entry);
+    }
+}
+
+static void file_cache_insert(FileCache *cache, FileCacheEntry *entry) {
+    // Files bigger than the whole budget are returned without caching them
+    if (entry->block_size > cache->_budget) {
+        return;
+    }
+    while (cache->_stats.used_size + entry->block_size > cache->_budget) {
+        cache->_stats.evictions += 1;
+        file_cache_drop(cache, cache->_lru_last);
+    }
+
+    // @NOTE: removed keys leave deleted slots behind, so a map with many evictions rehashes into new tables from time to
+    // time and the old ones are never given back to the arena. The map is rebuilt when the arena is mostly old tables.
+    u64 table_size = cache->_map._capacity*(1 + sizeof(StringMapSlot<FileCacheEntry*>)) + STRING_MAP_GROUP_WIDTH;
+    if (arena_get_pos(cache->_map_arena) > 4*table_size) {
+        arena_clear(cache->_map_arena);
+        cache->_map = string_map_make(cache->_map_arena, FileCacheEntry*, cache->_map.length);
+        for (FileCacheEntry *cached = cache->_lru_first; cached != 0; cached = cached->lru_next) {
+            string_map_put(&cache->_map, cached->path, cached);
+        }
+    }
+
+    string_map_put(&cache->_map, entry->path, entry);
+    file_cache_lru_push_front(cache, entry);
+    entry->is_cached = true;
+    cache->_stats.entry_count += 1;
+    cache->_stats.used_size += entry->block_size;
+}
+
+FileCache file_cache_alloc(u64 budget) {
+    FileCache cache = {};
+    cache._heap = heap_alloc(FILE_CACHE_CAPACITY);
+    cache._map_arena = heap_push(&cache._heap, Arena);
+    *cache._map_arena = arena_alloc(GiB);
+    cache._map = string_map_make(cache._map_arena, FileCacheEntry*, 0);
+    cache._budget = budget;
+    return cache;
+}
+
+void file_cache_free(FileCache *cache) {
+    for (FileCacheEntry *entry = cache->_lru_first; entry != 0; entry = entry->lru_next) {
+        assert(entry->references == 0);
+    }
+    assert(cache->_mappings == 0);
+    arena_free(cache->_map_arena);
+    heap_free(&cache->_heap);
+
+    FileCache zero = {};
+    *cache = zero;
+}
+
+bool file_cache_read(FileCache *cache, String file_name, Buffer *out_contents) {
+    assert(out_contents != 0);
+
+    TempArena scratch = scratch_begin(0, 0);
+    const char *file_name_cstr = string_to_cstring(scratch.arena, file_name);
+
+    FileCacheStamp stamp = {};
+    bool exists = file_cache_stat(file_name_cstr, &stamp);
+
+    FileCacheEntry *entry = 0;
+    FileCacheEntry **cached = string_map_get(&cache->_map, file_name);
+    if (cached != 0) {
+        if (exists && file_cache_stamp_equals(&(*cached)->stamp, &stamp)) {
+            entry = *cached;
+            cache->_stats.hits += 1;
+            file_cache_lru_remove(cache, entry);
+            file_cache_lru_push_front(cache, entry);
+        } else {
+            cache->_stats.invalidations += 1;
+            file_cache_drop(cache, *cached);
+        }
+    }
+
+    if (entry == 0 && exists && stamp.size > cache->_budget) {
+        cache->_stats.misses += 1;
+        bool ok = file_cache_map(cache, scratch.arena, file_name, out_contents);
+        scratch_end(scratch);
+        return ok;
+    }
+
+    if (entry == 0 && exists) {
+        cache->_stats.misses += 1;
+        entry = file_cache_load(cache, file_name_cstr, file_name);
+        if (entry != 0) {
+            file_cache_insert(cache, entry);
+        }
+    }
+
+    scratch_end(scratch);
+    if (entry == 0) {
+        return false;
+    }
+
+    entry->references += 1;
+    *out_contents = entry->contents;
+    return true;
+}
+
+void file_cache_release(FileCache *cache, Buffer contents) {
+    bool in_heap = contents.data >= cache->_heap._memory_start
+                   && contents.data < cache->_heap._memory_start + cache->_heap._capacity;
+    if (!in_heap) {
+        FileCacheMapping **link = &cache->_mappings;
+        while (*link != 0 && (*link)->file.contents.data != contents.data) {
+            link = &(*link)->next;
+        }
+        // The buffer wasn't returned by file_cache_read(), or it was already released
+        assert(*link != 0);
+        FileCacheMapping *mapping = *link;
+        *link = mapping->next;
+        unmap_file(&mapping->file);
+        heap_release(&cache->_heap, mapping);
+        return;
+    }
+
+    FileCacheEntry *entry = (FileCacheEntry*)contents.data - 1;
+    assert(entry->references > 0);
+    entry->references -= 1;
+    if (entry->references == 0 && !entry->is_cached) {
+        heap_release(&cache->_heap, entry);
+    }
+}
+
+FileCacheStats file_cache_get_stats(FileCache *cache) {
+    return cache->_stats;
+}
+
+// ####################################################################################################################
+// Arena snapshots
+#define ARENA_SNAPSHOT_MAGIC            0x544F485350414E53ull // "SNAPSHOT" in little endian
+#define ARENA_SNAPSHOT_FORMAT_VERSION   1
+
+typedef struct {
+    u64 magic;
+    u32 format_version;     // Version of this file format
+    u32 version;            // Version of the data, chosen by the caller
+    u64 data_size;
+    u64 checksum;
+} ArenaSnapshotFooter;
+
+static u64 arena_snapshot_checksum(const u8 *data, u64 size) {
+    // string_hash() processes 8 bytes at a time and every byte affects the result, which is all we need to detect
+    // truncated or corrupted files
+    String str = { data, size };
+    return string_hash(str);
+}
+
+static bool arena_snapshot_check_footer(const ArenaSnapshotFooter *footer, u64 file_size, u32 version) {
+    bool ok = footer->magic == ARENA_SNAPSHOT_MAGIC
+        && footer->format_version == ARENA_SNAPSHOT_FORMAT_VERSION
+        && footer->version == version
+        && footer->data_size == file_size - sizeof(ArenaSnapshotFooter);
+    return ok;
+}
+
+bool arena_snapshot_save(Arena *arena, String file_name, u32 version) {
+    assert(arena->_prev_block == 0);
+
+    ArenaSnapshotFooter footer = {};
+    footer.magic = ARENA_SNAPSHOT_MAGIC;
+    footer.format_version = ARENA_SNAPSHOT_FORMAT_VERSION;
+    footer.version = version;
+    footer.data_size = (u64)(arena->_position - arena->_memory_start);
+    footer.checksum = arena_snapshot_checksum(arena->_memory_start, footer.data_size);
+
+    // @NOTE: the file is replaced instead of overwritten, so processes that loaded the previous snapshot keep their data
+    Buffer buffers[2] = {
+        { arena->_memory_start, footer.data_size },
+        { (u8*)&footer, sizeof(footer) },
+    };
+    bool ok = write_entire_file_gather(file_name, buffers, ARRAY_LENGTH(buffers), 0);
+    return ok;
+}
+
+bool arena_snapshot_load(Arena *out_arena, String file_name, u32 version, u64 capacity, bool verify_checksum) {
+    assert(out_arena != 0);
+
+    bool ok = true;
+    Arena arena = {};
+    ArenaSnapshotFooter footer = {};
+
+#ifdef __linux__
+    // Map the file over the beginning of the memory reserved by the arena. The mapping is private, so writing to the
+    // snapshot memory never changes the file.
+    TempArena scratch = scratch_begin(0, 0);
+    int fd = open(string_to_cstring(scratch.arena, file_name), O_RDONLY);
+    scratch_end(scratch);
+    if (fd == -1) {
+        return false;
+    }
+
+    struct stat st = {};
+    u64 file_size = 0;
+    if (fstat(fd, &st) == -1 || (u64)st.st_size < sizeof(footer)) {
+        ok = false;
+    }
+    if (ok) {
+        file_size = (u64)st.st_size;
+        ok = pread(fd, &footer, sizeof(footer), (off_t)(file_size - sizeof(footer))) == (ssize_t)sizeof(footer)
+            && arena_snapshot_check_footer(&footer, file_size, version)
+            && footer.data_size <= capacity;
+    }
+    if (ok) {
+        arena = arena_alloc(capacity);
+        if (footer.data_size > 0) {
+            void *mapping = mmap(arena._memory_start, footer.data_size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_FIXED, fd, 0);
+            if (mapping == MAP_FAILED) {
+                ok = false;
+            }
+        }
+    }
+
+    close(fd);
+
+    if (ok) {
+        arena._position = arena._memory_start + footer.data_size;
+        arena._next_reserved_page = arena._memory_start + ((footer.data_size + (arena._page_size - 1)) & -arena._page_size);
+    }
+#else
+    // Read the file into the arena. The snapshot data is the first thing pushed into the arena, so it's at the beginning
+    // of its memory, and the footer is popped afterwards. The size is checked first, because pushing more than the
+    // capacity of the arena aborts.
+    TempArena scratch = scratch_begin(0, 0);
+    HANDLE fd = CreateFileA(string_to_cstring(scratch.arena, file_name), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL, NULL);
+    scratch_end(scratch);
+    if (fd == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER li_file_size = {};
+    u64 file_size = 0;
+    u8 *data = 0;
+    if (!GetFileSizeEx(fd, &li_file_size) || (u64)li_file_size.QuadPart < sizeof(footer)
+        || (u64)li_file_size.QuadPart > capacity + sizeof(footer)) {
+        ok = false;
+    }
+    if (ok) {
+        file_size = (u64)li_file_size.QuadPart;
+        arena = arena_alloc(capacity + sizeof(footer));
+        data = arena_push_nozero(&arena, u8, file_size);
+    }
+
+    u64 total_read = 0;
+    while (ok && total_read < file_size) {
+        DWORD bytes_read = 0;
+        DWORD to_read = (DWORD)MIN(file_size - total_read, (u64)GiB);
+        ok = ReadFile(fd, data + total_read, to_read, &bytes_read, NULL) && bytes_read > 0;
+        total_read += bytes_read;
+    }
+
+    CloseHandle(fd);
+
+    if (ok) {
+        memcpy(&footer, data + file_size - sizeof(footer), sizeof(footer));
+        ok = arena_snapshot_check_footer(&footer, file_size, version);
+    }
+    if (ok) {
+        arena_set_pos(&arena, footer.data_size);
+    }
+#endif
+
+    if (ok && verify_checksum) {
+        ok = arena_snapshot_checksum(arena._memory_start, footer.data_size) == footer.checksum;
+    }
+
+    if (ok) {
+        *out_arena = arena;
+    } else {
+        arena_free(&arena);
+    }
+    return ok;
+}
+
+void *arena_snapshot_get_root(Arena *arena) {
+    assert(arena->_prev_block == 0);
+    return arena->_memory_start;
+}
+
+// ####################################################################################################################
+// Threads and synchronization
+
+// Threads receive the function and its argument through this struct, because the signature of the entry point of a
+// thread is different in every platform. The thread frees it as soon as it starts.
+typedef struct {
+    ThreadFunction func;
+    void *arg;
+} ThreadStart;
+
+#ifdef _WIN32
+static DWORD WINAPI thread_entry_point(LPVOID param) {
+    ThreadStart start = *(ThreadStart*)param;
+    free(param);
+    start.func(start.arg);
+    return 0;
+}
+#elif __linux__
+static void *thread_entry_point(void *param) {
+    ThreadStart start = *(ThreadStart*)param;
+    free(param);
+    start.func(start.arg);
+    return 0;
+}
+#endif
+
+Thread thread_create(ThreadFunction func, void *arg) {
+    assert(func != 0);
+
+    ThreadStart *start = (ThreadStart*)malloc(sizeof(ThreadStart));
+    start->func = func;
+    start->arg = arg;
+
+    Thread thread = {};
+#ifdef _WIN32
+    HANDLE handle = CreateThread(NULL, 0, thread_entry_point, start, 0, NULL);
+    if (handle == NULL) {
+        fprintf(stderr, "Failed to create thread\n");
+        abort();
+    }
+    thread._handle = (u64)handle;
+#elif __linux__
+    pthread_t handle;
+    if (pthread_create(&handle, NULL, thread_entry_point, start) != 0) {
+        fprintf(stderr, "Failed to create thread\n");
+        abort();
+    }
+    thread._handle = (u64)handle;
+#else
+    #error "Not implemented for your platform"
+#endif
+
+    return thread;
+}
+
+void thread_join(Thread thread) {
+#ifdef _WIN32
+    WaitForSingleObject((HANDLE)thread._handle, INFINITE);
+    CloseHandle((HANDLE)thread._handle);
+#elif __linux__
+    pthread_join((pthread_t)thread._handle, NULL);
+#else
+    #error "Not implemented for your platform"
+#endif
+}
+
+u32 get_cpu_count() {
+#ifdef _WIN32
+    SYSTEM_INFO sysinfo;
+    GetSystemInfo(&sysinfo);
+    return (u32)sysinfo.dwNumberOfProcessors;
+#elif __linux__
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (u32)count : 1;
+#else
+    #error "Not implemented for your platform"
+#endif
+}
+
+void thread_yield() {
+#ifdef _WIN32
+    SwitchToThread();
+#elif __linux__
+    sched_yield();
+#else
+    #error "Not implemented for your platform"
+#endif
+}
+
+void futex_wait(volatile u32 *address, u32 expected) {
+#ifdef _WIN32
+    WaitOnAddress(address, &expected, sizeof(expected), INFINITE);
+#elif __linux__
+    syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+#else
+    #error "Not implemented for your platform"
+#endif
+}
+
+void futex_wake_one(volatile u32 *address) {
+#ifdef _WIN32
+    WakeByAddressSingle((PVOID)address);
+#elif __linux__
+    syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#else
+    #error "Not implemented for your platform"
+#endif
+}
+
+void futex_wake_all(volatile u32 *address) {
+#ifdef _WIN32
+    WakeByAddressAll((PVOID)address);
+#elif __linux__
+    syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, INT32_MAX, NULL, NULL, 0);
+#else
+    #error "Not implemented for your platform"
+#endif
+}
+
+// @NOTE: Mutex states: 0 = unlocked, 1 = locked, 2 = locked and there may be threads waiting. Unlocking only has to make
+// a syscall to wake up a waiting thread when the state was 2. Source: "Futexes Are Tricky" by Ulrich Drepper.
+void mutex_lock(Mutex *mutex) {
+    u32 state = atomic_compare_exchange_u32(&mutex->_state, 0, 1);
+    if (state != 0) {
+        if (state != 2) {
+            state = atomic_exchange_u32(&mutex->_state, 2);
+        }
+        while (state != 0) {
+            futex_wait(&mutex->_state, 2);
+            state = atomic_exchange_u32(&mutex->_state, 2);
+        }
+    }
+}
+
+void mutex_unlock(Mutex *mutex) {
+    if (atomic_fetch_add_u32(&mutex->_state, (u32)-1) != 1) {
+        atomic_store_u32(&mutex->_state, 0);
+        futex_wake_one(&mutex->_state);
+    }
+}
+
+u32 event_count_prepare_wait(EventCount *event) {
+    u32 state = atomic_load_u32(&event->_state);
+    for (;;) {
+        u32 prev_state = atomic_compare_exchange_u32(&event->_state, state, state | 1);
+        if (prev_state == state) {
+            break;
+        }
+        state = prev_state;
+    }
+    return state | 1;
+}
+
+void event_count_wait(EventCount *event, u32 epoch) {
+    // @NOTE: it returns right away if a notification changed the state after event_count_prepare_wait()
+    futex_wait(&event->_state, epoch);
+}
+
+void event_count_notify(EventCount *event) {
+    // @NOTE: without the fence the load of the state could be reordered before the store that changed the condition,
+    // missing a waiter that checked the condition before that store
+    atomic_fence();
+    u32 state = atomic_load_u32(&event->_state);
+    while (state & 1) {
+        // Adding 1 clears the waiting bit and increments the number of notifications
+        u32 prev_state = atomic_compare_exchange_u32(&event->_state, state, state + 1);
+        if (prev_state == state) {
+            futex_wake_all(&event->_state);
+            break;
+        }
+        state = prev_state;
+    }
+}
+
+// ####################################################################################################################
+// Streaming file reader
+
+static void file_stream_reader_thread(void *arg) {
+    FileStream *stream = (FileStream*)arg;
+    for (u32 index = 0; ; index++) {
+        // Wait until the caller releases the buffer of this chunk
+        for (;;) {
+            u32 released = atomic_load_u32(&stream->_released);
+            if (atomic_load_u32(&stream->_stop)) {
+                return;
+            }
+            if (index - released < FILE_STREAM_BUFFER_COUNT) {
+                break;
+            }
+            futex_wait(&stream->_released, released);
+        }
+
+        // Fill the chunk unless the file ends before
+        u8 *data = stream->_buffers[index % FILE_STREAM_BUFFER_COUNT] + stream->_chunk_size;
+        u64 length = 0;
+        bool failed = false;
+        while (length < stream->_chunk_size) {
+#ifdef _WIN32
+            DWORD bytes_read = 0;
+            DWORD to_read = (DWORD)MIN(stream->_chunk_size - length, (u64)GiB);
+            if (!ReadFile((HANDLE)stream->_handle, data + length, to_read, &bytes_read, NULL)) {
+                failed = GetLastError() != ERROR_BROKEN_PIPE;
+                break;
+            }
+#elif __linux__
+            ssize_t bytes_read = read((int)stream->_handle, data + length, stream->_chunk_size - length);
+            if (bytes_read == -1 && errno == EINTR) {
+                continue;
+            }
+            if (bytes_read < 0) {
+                failed = true;
+                break;
+            }
+#else
+    #error "Not implemented for your platform"
+#endif
+            if (bytes_read == 0) {
+                break;
+            }
+            length += (u64)bytes_read;
+        }
+
+        // An empty chunk marks the end of the file
+        if (failed) {
+            atomic_store_u32(&stream->_failed, 1);
+            length = 0;
+        }
+        stream->_lengths[index % FILE_STREAM_BUFFER_COUNT] = length;
+        atomic_store_u32(&stream->_filled, index + 1);
+        futex_wake_one(&stream->_filled);
+        if (length == 0) {
+            return;
+        }
+    }
+}
+
+bool file_stream_open(Arena *arena, String file_name, u64 chunk_size, FileStream *out_stream) {
+    assert(out_stream != 0);
+    if (chunk_size == 0) {
+        chunk_size = FILE_STREAM_CHUNK_SIZE;
+    }
+
+    TempArena scratch = scratch_begin(&arena, 1);
+    const char *file_name_cstr = string_to_cstring(scratch.arena, file_name);
+
+#ifdef _WIN32
+    HANDLE fd = CreateFileA(file_name_cstr, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    bool ok = fd != INVALID_HANDLE_VALUE;
+    u64 handle = (u64)fd;
+#elif __linux__
+    int fd = open(file_name_cstr, O_RDONLY);
+    bool ok = fd != -1;
+    if (ok) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+    u64 handle = (u64)fd;
+#else
+    #error "Not implemented for your platform"
+#endif
+    scratch_end(scratch);
+    if (!ok) {
+        return false;
+    }
+
+    FileStream stream = {};
+    for (u32 i = 0; i < FILE_STREAM_BUFFER_COUNT; i++) {
+        stream._buffers[i] = arena_push_nozero(arena, u8, 2*chunk_size);
+    }
+    stream._chunk_size = chunk_size;
+    stream._handle = handle;
+    *out_stream = stream;
+    out_stream->_reader = thread_create(file_stream_reader_thread, out_stream);
+    return true;
+}
+
+bool file_stream_next(FileStream *stream, u64 unconsumed, Buffer *out_chunk) {
+    assert(unconsumed <= stream->_current.length);
+    assert(unconsumed <= stream->_chunk_size);
+
+    u32 index = stream->_next_chunk;
+    for (;;) {
+        u32 filled = atomic_load_u32(&stream->_filled);
+        if (filled != index) {
+            break;
+        }
+        futex_wait(&stream->_filled, filled);
+    }
+
+    const u8 *carried = stream->_current.data + stream->_current.length - unconsumed;
+    u8 *data = stream->_buffers[index % FILE_STREAM_BUFFER_COUNT] + stream->_chunk_size;
+    u64 length = stream->_lengths[index % FILE_STREAM_BUFFER_COUNT];
+    if (length == 0) {
+        // End of the file. The unconsumed bytes stay in the current buffer.
+        out_chunk->data = (u8*)carried;
+        out_chunk->length = unconsumed;
+        return false;
+    }
+
+    // Move the unconsumed bytes in front of the new chunk before the background thread can reuse their buffer
+    if (unconsumed > 0) {
+        memcpy(data - unconsumed, carried, unconsumed);
+    }
+    if (index > 0) {
+        atomic_store_u32(&stream->_released, index);
+        futex_wake_one(&stream->_released);
+    }
+
+    stream->_current.data = data - unconsumed;
+    stream->_current.length = length + unconsumed;
+    stream->_next_chunk = index + 1;
+    *out_chunk = stream->_current;
+    return true;
+}
+
+bool file_stream_close(FileStream *stream) {
+    // @NOTE: _released changes so the background thread can't go to sleep after it checked _stop
+    atomic_store_u32(&stream->_stop, 1);
+    atomic_fetch_add_u32(&stream->_released, 1);
+    futex_wake_one(&stream->_released);
+    thread_join(stream->_reader);
+
+#ifdef _WIN32
+    CloseHandle((HANDLE)stream->_handle);
+#elif __linux__
+    close((int)stream->_handle);
+#endif
+
+    bool ok = atomic_load_u32(&stream->_failed) == 0;
+    return ok;
+}
+
+// ####################################################################################################################
+// String interning
+
+// Open-addressing table with linear probing. Each slot stores the upper 32 bits of the hash of the string and its atom,
+// or 0 if it's empty. The table is never more than half full.
+struct InternerTable {
+    u64 mask;
+    volatile u64 slots[1];
+};
+
+#define INTERNER_MIN_TABLE_CAPACITY 64
+
+static InternerTable *interner_table_push(Interner *interner, u64 capacity) {
+    u64 size = offsetof(InternerTable, slots) + capacity*sizeof(u64);
+    InternerTable *table = (InternerTable*)arena_push_data(&interner->_tables, size, 1, alignof(InternerTable), 1);
+    table->mask = capacity - 1;
+    return table;
+}
+
+static InternerTable *interner_load_table(Interner *interner) {
+    InternerTable *table = (InternerTable*)atomic_load_u64((volatile u64*)&interner->_table);
+    return table;
+}
+
+static String *interner_atom_strings(Interner *interner) {
+    String *strings = (String*)interner->_atoms._memory_start;
+    return strings;
+}
+
+static void interner_table_insert(InternerTable *table, u64 hash, Atom atom) {
+    u64 index = hash & table->mask;
+    while (table->slots[index] != 0) {
+        index = (index + 1) & table->mask;
+    }
+
+    // The release store publishes the String of the atom to the threads that find this slot
+    atomic_store_u64(&table->slots[index], (hash >> 32) << 32 | atom);
+}
+
+static Atom interner_table_find(Interner *interner, InternerTable *table, String str, u64 hash) {
+    String *strings = interner_atom_strings(interner);
+    u64 index = hash & table->mask;
+    for (;;) {
+        u64 slot = atomic_load_u64(&table->slots[index]);
+        if (slot == 0) {
+            return 0;
+        }
+
+        Atom atom = (Atom)slot;
+        if (slot >> 32 == hash >> 32 && string_equals(strings[atom - 1], str)) {
+            return atom;
+        }
+        index = (index + 1) & table->mask;
+    }
+}
+
+Interner interner_alloc() {
+    Interner interner = {};
+    interner._strings = arena_alloc(INTERNER_STRINGS_CAPACITY);
+    interner._atoms = arena_alloc((u64)INTERNER_MAX_ATOMS*sizeof(String));
+
+    // The biggest table has at most 4 slots per atom because it's at least a quarter full when it's pushed. Tables
+    // double in size, so all of them together take less than twice the biggest one.
+    interner._tables = arena_alloc((u64)INTERNER_MAX_ATOMS*sizeof(u64)*8);
+    interner._table = interner_table_push(&interner, INTERNER_MIN_TABLE_CAPACITY);
+    return interner;
+}
+
+void interner_free(Interner *interner) {
+    arena_free(&interner->_strings);
+    arena_free(&interner->_atoms);
+    arena_free(&interner->_tables);
+    Interner zero = {};
+    *interner = zero;
+}
+
+Atom interner_find(Interner *interner, String str) {
+    u64 hash = string_hash(str);
+    Atom atom = interner_table_find(interner, interner_load_table(interner), str, hash);
+    return atom;
+}
+
+Atom interner_intern(Interner *interner, String str) {
+    // Fast path: the string has already been interned
+    u64 hash = string_hash(str);
+    Atom atom = interner_table_find(interner, interner_load_table(interner), str, hash);
+    if (atom != 0) {
+        return atom;
+    }
+
+    mutex_lock(&interner->_mutex);
+
+    // Another thread could have interned the string or grown the table since the first lookup. This thread is the only
+    // writer now, so the current table is complete.
+    InternerTable *table = interner_load_table(interner);
+    atom = interner_table_find(interner, table, str, hash);
+    if (atom == 0) {
+        u32 count = interner->_count;
+        if (count == INTERNER_MAX_ATOMS) {
+            fprintf(stderr, "Interner ran out of atoms. It can't hold more than %u strings.\n", INTERNER_MAX_ATOMS);
+            abort();
+        }
+
+        String copy = {};
+        if (str.length > 0) {
+            u8 *data = arena_push_nozero(&interner->_strings, u8, str.length);
+            memcpy(data, str.data, str.length);
+            copy.data = data;
+            copy.length = str.length;
+        }
+        *arena_push_nozero(&interner->_atoms, String, 1) = copy;
+        atom = count + 1;
+
+        if ((u64)(count + 1)*2 > table->mask + 1) {
+            // Readers that already loaded the old table keep using it. At worst they miss the newest strings and take
+            // the slow path.
+            InternerTable *new_table = interner_table_push(interner, (table->mask + 1)*2);
+            String *strings = interner_atom_strings(interner);
+            for (Atom a = 1; a <= count; a++) {
+                interner_table_insert(new_table, string_hash(strings[a - 1]), a);
+            }
+            atomic_store_u64((volatile u64*)&interner->_table, (u64)new_table);
+            table = new_table;
+        }
+
+        interner_table_insert(table, hash, atom);
+        atomic_store_u32(&interner->_count, count + 1);
+    }
+
+    mutex_unlock(&interner->_mutex);
+    return atom;
+}
+
+String interner_get_string(Interner *interner, Atom atom) {
+    assert(atom > 0 && atom <= atomic_load_u32(&interner->_count));
+    String str = interner_atom_strings(interner)[atom - 1];
+    return str;
+}
+
+u32 interner_get_count(Interner *interner) {
+    u32 count = atomic_load_u32(&interner->_count);
+    return count;
+}
+
+// ####################################################################################################################
+// Mirrored ring buffer
+
+RingBuffer ring_buffer_alloc(u64 capacity_hint) {
+    RingBuffer ring = {};
+
+#ifdef _WIN32
+    // Map a pagefile-backed section twice into a placeholder reservation. It requires Windows 10 version 1803 or later.
+    SYSTEM_INFO sysinfo;
+    GetSystemInfo(&sysinfo);
+    u64 granularity = (u64)sysinfo.dwAllocationGranularity;
+    u64 capacity = (MAX(capacity_hint, 1) + (granularity - 1)) & -granularity;
+
+    HANDLE section = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)(capacity >> 32), (DWORD)capacity, NULL);
+    u8 *memory = (u8*)VirtualAlloc2(NULL, NULL, 2*capacity, MEM_RESERVE|MEM_RESERVE_PLACEHOLDER, PAGE_NOACCESS, NULL, 0);
+    bool ok = section != NULL && memory != NULL;
     if (ok) {
-        // @NOTE: Microsoft documentation recommends to use GetFileSizeEx() instead of GetFileSize()
-        // Source (24/07/2025): https://learn.microsoft.com/en-us/windows/win32/api/fileapi/nf-fileapi-getfilesize
-        if (GetFileSizeEx(fd, &li_file_size) == 0) {
-            ok = false;
-        }
+        // Split the placeholder in two, one for each view
+        ok = VirtualFree(memory, capacity, MEM_RELEASE|MEM_PRESERVE_PLACEHOLDER)
+            && MapViewOfFile3(section, NULL, memory, 0, capacity, MEM_REPLACE_PLACEHOLDER, PAGE_READWRITE, NULL, 0) != NULL
+            && MapViewOfFile3(section, NULL, memory + capacity, 0, capacity, MEM_REPLACE_PLACEHOLDER, PAGE_READWRITE, NULL, 0) != NULL;
     }
+    if (section != NULL) {
+        // The views keep the section alive
+        CloseHandle(section);
+    }
+#elif __linux__
+    // Map an anonymous file twice over a reserved range, so the second mapping always ends up right after the first one
+    u64 page_size = get_page_size();
+    u64 capacity = (MAX(capacity_hint, 1) + (page_size - 1)) & -page_size;
 
-    // Read the entire file into RAM
+    int fd = (int)syscall(SYS_memfd_create, "ring_buffer", 0);
+    bool ok = fd != -1 && ftruncate(fd, (off_t)capacity) == 0;
+    u8 *memory = vm_reserve(2*capacity);
     if (ok) {
-        file_size = (u64)li_file_size.QuadPart;
-        file_buffer = arena_push(arena, u8, file_size);
+        ok = mmap(memory, capacity, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_FIXED, fd, 0) != MAP_FAILED
+            && mmap(memory + capacity, capacity, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_FIXED, fd, 0) != MAP_FAILED;
+    }
+    if (fd != -1) {
+        // The mappings keep the file alive
+        close(fd);
+    }
+#else
+    #error "Not implemented for your platform"
+#endif
 
-        u64 total_read = 0;
-        while (total_read < file_size) {
-            DWORD bytes_read = 0;
-            BOOL read_ok = ReadFile(
-                fd,                         // File descriptor
-                file_buffer + total_read,   // Output buffer
-                file_size - total_read,     // Bytes to read
-                &bytes_read,                // Pointer to number of bytes read
-                NULL
-            );
-            if (!read_ok) {
-                ok = false;
-                break;
+    if (!ok) {
+        fprintf(stderr, "Failed to map the memory of the ring buffer\n");
+        abort();
+    }
+
+    ring._memory = memory;
+    ring._capacity = capacity;
+    return ring;
+}
+
+void ring_buffer_free(RingBuffer *ring) {
+    if (ring->_memory != 0) {
+#ifdef _WIN32
+        UnmapViewOfFile(ring->_memory);
+        UnmapViewOfFile(ring->_memory + ring->_capacity);
+#else
+        vm_free_pages(ring->_memory, 2*ring->_capacity);
+#endif
+    }
+
+    RingBuffer zero = {};
+    *ring = zero;
+}
+
+Buffer ring_buffer_write_begin(RingBuffer *ring) {
+    u64 write_pos = ring->_write_pos;
+    u64 read_pos = atomic_load_u64(&ring->_read_pos);
+    Buffer free_space = {
+        ring->_memory + write_pos % ring->_capacity,
+        ring->_capacity - (write_pos - read_pos)
+    };
+    return free_space;
+}
+
+void ring_buffer_write_end(RingBuffer *ring, u64 count) {
+    assert(count <= ring->_capacity - (ring->_write_pos - ring->_read_pos));
+    atomic_store_u64(&ring->_write_pos, ring->_write_pos + count);
+}
+
+Buffer ring_buffer_read_begin(RingBuffer *ring) {
+    u64 read_pos = ring->_read_pos;
+    u64 write_pos = atomic_load_u64(&ring->_write_pos);
+    Buffer data = {
+        ring->_memory + read_pos % ring->_capacity,
+        write_pos - read_pos
+    };
+    return data;
+}
+
+void ring_buffer_read_end(RingBuffer *ring, u64 count) {
+    assert(count <= ring->_write_pos - ring->_read_pos);
+    atomic_store_u64(&ring->_read_pos, ring->_read_pos + count);
+}
+
+// ####################################################################################################################
+// Job system
+
+typedef struct {
+    JobFunction func;               // Either func or for_func is set
+    ParallelForFunction for_func;
+    void *arg;
+    u64 begin;                      // Range of parallel_for
+    u64 end;
+    u64 grain_size;
+    JobGroup *group;
+} Job;
+
+// Chase-Lev deque with a fixed capacity. Positions only grow, so bottom - top is the number of jobs in the deque.
+typedef struct {
+    alignas(64) volatile u64 top;   // Next job to steal. Thieves move it with a CAS.
+    alignas(64) volatile u64 bottom;// Next free slot. Only the owner changes it.
+    Job *jobs;
+} JobDeque;
+
+typedef struct {
+    JobDeque deque;
+    Arena arena;
+    JobSystem *system;
+    u64 random_state;               // Picks the first victim to steal from
+    Thread thread;
+} JobWorker;
+
+struct JobSystem {
+    Arena _arena;
+    JobWorker *_workers;
+    u32 _worker_count;
+    volatile u32 _stop;
+    alignas(64) EventCount _work_available;     // Idle workers sleep here
+    alignas(64) EventCount _group_done;         // Threads in job_group_wait() sleep here
+};
+
+static thread_local JobWorker *job_current_worker;
+
+static bool job_deque_push(JobDeque *deque, const Job *job) {
+    u64 bottom = deque->bottom;
+    u64 top = atomic_load_u64(&deque->top);
+    if (bottom - top >= JOB_DEQUE_CAPACITY) {
+        return false;
+    }
+
+    deque->jobs[bottom % JOB_DEQUE_CAPACITY] = *job;
+    atomic_store_u64(&deque->bottom, bottom + 1);
+    return true;
+}
+
+static bool job_deque_pop(JobDeque *deque, Job *out_job) {
+    // Claim the last job before looking at top, so a thief can't take it at the same time unless it's the only one left
+    u64 bottom = deque->bottom - 1;
+    atomic_store_u64(&deque->bottom, bottom);
+    atomic_fence();
+    u64 top = atomic_load_u64(&deque->top);
+
+    if ((i64)(bottom - top) < 0) {
+        atomic_store_u64(&deque->bottom, top);
+        return false;
+    }
+
+    *out_job = deque->jobs[bottom % JOB_DEQUE_CAPACITY];
+    if (bottom != top) {
+        return true;
+    }
+
+    // It's the last job. Race the thieves for it.
+    bool won = atomic_compare_exchange_u64(&deque->top, top, top + 1) == top;
+    atomic_store_u64(&deque->bottom, top + 1);
+    return won;
+}
+
+typedef enum {
+    JOB_STEAL_EMPTY,
+    JOB_STEAL_SUCCESS,
+    JOB_STEAL_CONTENDED,            // Another thread took the job first. There may be more jobs.
+} JobStealResult;
+
+static JobStealResult job_deque_steal(JobDeque *deque, Job *out_job) {
+    u64 top = atomic_load_u64(&deque->top);
+    atomic_fence();
+    u64 bottom = atomic_load_u64(&deque->bottom);
+    if ((i64)(bottom - top) <= 0) {
+        return JOB_STEAL_EMPTY;
+    }
+
+    // @NOTE: the owner may overwrite the slot while it's copied if other threads steal it and the owner wraps around,
+    // but then top has moved and the CAS below discards the copy
+    Job job = deque->jobs[top % JOB_DEQUE_CAPACITY];
+    if (atomic_compare_exchange_u64(&deque->top, top, top + 1) != top) {
+        return JOB_STEAL_CONTENDED;
+    }
+    *out_job = job;
+    return JOB_STEAL_SUCCESS;
+}
+
+// Pop a job from the deque of the worker or steal one from the others, starting from a random victim
+static bool job_find(JobWorker *worker, Job *out_job) {
+    if (job_deque_pop(&worker->deque, out_job)) {
+        return true;
+    }
+
+    JobSystem *system = worker->system;
+    worker->random_state = worker->random_state*6364136223846793005ull + 1442695040888963407ull;
+    u32 first_victim = (u32)((worker->random_state >> 33) % system->_worker_count);
+    for (;;) {
+        bool contended = false;
+        for (u32 i = 0; i < system->_worker_count; i++) {
+            JobWorker *victim = &system->_workers[(first_victim + i) % system->_worker_count];
+            if (victim == worker) {
+                continue;
             }
 
-            total_read += bytes_read;
+            JobStealResult result = job_deque_steal(&victim->deque, out_job);
+            if (result == JOB_STEAL_SUCCESS) {
+                return true;
+            }
+            contended = contended || result == JOB_STEAL_CONTENDED;
+        }
+
+        if (!contended) {
+            return false;
         }
     }
+}
 
-    if (fd != INVALID_HANDLE_VALUE) {
-        CloseHandle(fd);
+static void job_execute(JobWorker *worker, Job *job);
+
+static void job_push(JobWorker *worker, Job *job) {
+    if (job_deque_push(&worker->deque, job)) {
+        event_count_notify(&worker->system->_work_available);
+    } else {
+        job_execute(worker, job);
     }
+}
 
-#elif __linux__
-    int fd = open(file_name_cstr, O_RDONLY);
-    if (fd == -1) {
-        ok = false;
+static void job_execute(JobWorker *worker, Job *job) {
+    u64 arena_pos = arena_get_pos(&worker->arena);
+
+    if (job->func != 0) {
+        job->func(job->arg, &worker->arena);
+    } else {
+        // Give away the upper half of the range until it's small enough
+        u64 begin = job->begin;
+        u64 end = job->end;
+        while (end - begin > job->grain_size) {
+            u64 middle = begin + (end - begin)/2;
+            Job half = *job;
+            half.begin = middle;
+            half.end = end;
+            atomic_fetch_add_u64(&job->group->_pending, 1);
+            job_push(worker, &half);
+            end = middle;
+        }
+        job->for_func(job->arg, begin, end, &worker->arena);
     }
 
-    // Get file size
-    struct stat st = {};
-    if (ok) {
-        if (fstat(fd, &st) == -1) {
-            ok = false;
+    arena_set_pos(&worker->arena, arena_pos);
+    if (atomic_fetch_add_u64(&job->group->_pending, (u64)-1) == 1) {
+        event_count_notify(&worker->system->_group_done);
+    }
+}
+
+static void job_worker_thread(void *arg) {
+    JobWorker *worker = (JobWorker*)arg;
+    JobSystem *system = worker->system;
+    job_current_worker = worker;
+
+    Job job;
+    u32 spins = 0;
+    for (;;) {
+        if (job_find(worker, &job)) {
+            job_execute(worker, &job);
+            spins = 0;
+            continue;
+        }
+        if (spins < JOB_SPIN_COUNT) {
+            spins += 1;
+            atomic_pause();
+            continue;
+        }
+
+        u32 epoch = event_count_prepare_wait(&system->_work_available);
+        if (atomic_load_u32(&system->_stop)) {
+            break;
         }
+        if (job_find(worker, &job)) {
+            job_execute(worker, &job);
+            spins = 0;
+            continue;
+        }
+        event_count_wait(&system->_work_available, epoch);
     }
+}
 
-    // Read the entire file into RAM
-    if (ok) {
-        file_size = (u64)st.st_size;
-        file_buffer = arena_push(arena, u8, file_size);
+JobSystem *job_system_alloc(u32 worker_count) {
+    assert(job_current_worker == 0);
+    if (worker_count == 0) {
+        worker_count = get_cpu_count();
+    }
 
-        u64 total_read = 0;
-        while (total_read < file_size) {
-            u64 bytes_read = (u64)read(fd, file_buffer + total_read, file_size - total_read);
-            if (bytes_read == 0) {
-                ok = false;
-                break;
-            }
+    Arena arena = arena_alloc(GiB);
+    JobSystem *system = arena_push(&arena, JobSystem);
+    system->_workers = arena_push(&arena, JobWorker, worker_count);
+    system->_worker_count = worker_count;
+    for (u32 i = 0; i < worker_count; i++) {
+        JobWorker *worker = &system->_workers[i];
+        worker->deque.jobs = arena_push_nozero(&arena, Job, JOB_DEQUE_CAPACITY);
+        worker->arena = arena_alloc(JOB_ARENA_CAPACITY);
+        worker->system = system;
+        worker->random_state = i + 1;
+    }
+    system->_arena = arena;
 
-            total_read += bytes_read;
+    // The calling thread is the first worker
+    job_current_worker = &system->_workers[0];
+    for (u32 i = 1; i < worker_count; i++) {
+        system->_workers[i].thread = thread_create(job_worker_thread, &system->_workers[i]);
+    }
+    return system;
+}
+
+void job_system_free(JobSystem *system) {
+    assert(job_current_worker == &system->_workers[0]);
+    atomic_store_u32(&system->_stop, 1);
+    event_count_notify(&system->_work_available);
+    for (u32 i = 1; i < system->_worker_count; i++) {
+        thread_join(system->_workers[i].thread);
+    }
+
+    for (u32 i = 0; i < system->_worker_count; i++) {
+        arena_free(&system->_workers[i].arena);
+    }
+    job_current_worker = 0;
+    Arena arena = system->_arena;
+    arena_free(&arena);
+}
+
+u32 job_system_get_worker_count(JobSystem *system) {
+    return system->_worker_count;
+}
+
+void job_run(JobSystem *system, JobGroup *group, JobFunction func, void *arg) {
+    assert(job_current_worker != 0 && job_current_worker->system == system);
+    assert(func != 0);
+    UNUSED(system);
+
+    Job job = {};
+    job.func = func;
+    job.arg = arg;
+    job.group = group;
+    atomic_fetch_add_u64(&group->_pending, 1);
+    job_push(job_current_worker, &job);
+}
+
+void job_group_wait(JobSystem *system, JobGroup *group) {
+    assert(job_current_worker != 0 && job_current_worker->system == system);
+    JobWorker *worker = job_current_worker;
+
+    // Help with any job while the group isn't done. They may belong to other groups.
+    Job job;
+    u32 spins = 0;
+    while (atomic_load_u64(&group->_pending) != 0) {
+        if (job_find(worker, &job)) {
+            job_execute(worker, &job);
+            spins = 0;
+            continue;
+        }
+        if (spins < JOB_SPIN_COUNT) {
+            spins += 1;
+            atomic_pause();
+            continue;
+        }
+
+        u32 epoch = event_count_prepare_wait(&system->_group_done);
+        if (atomic_load_u64(&group->_pending) == 0) {
+            break;
         }
+        event_count_wait(&system->_group_done, epoch);
     }
+}
 
-    if (fd != -1) {
-        close(fd);
+void parallel_for(JobSystem *system, u64 count, u64 grain_size, ParallelForFunction func, void *arg) {
+    assert(job_current_worker != 0 && job_current_worker->system == system);
+    assert(func != 0);
+    if (count == 0) {
+        return;
+    }
+    if (grain_size == 0) {
+        grain_size = MAX(count/(8*(u64)system->_worker_count), (u64)1);
     }
 
-#else
-    // Fallback implementation with C-standard library
+    // The calling worker runs the first range, giving away halves that other workers can steal
+    JobGroup group = {};
+    group._pending = 1;
+    Job job = {};
+    job.for_func = func;
+    job.arg = arg;
+    job.begin = 0;
+    job.end = count;
+    job.grain_size = grain_size;
+    job.group = &group;
+    job_execute(job_current_worker, &job);
+    job_group_wait(system, &group);
+}
 
-    // Read in binary mode because some operating systems like Windows try to convert some characters and we don't want that
-    FILE *file = fopen(file_name_cstr, "rb");
-    if (file == 0) {
+// ####################################################################################################################
+// Directory walker
+#define WALK_BATCH_MIN_CAPACITY 16
+#define WALK_BATCH_MAX_CAPACITY 4096
+
+// Entries found by one directory. Batches of all directories are collected in a lock-free stack.
+typedef struct WalkBatch WalkBatch;
+struct WalkBatch {
+    DirectoryEntry *entries;
+    u64 count;
+    u64 capacity;
+    WalkBatch *next;
+};
+
+typedef struct Walk Walk;
+
+typedef struct WalkDirectory WalkDirectory;
+struct WalkDirectory {
+    Walk *walk;
+    WalkDirectory *parent;
+    String path;                    // Null-terminated
+    u64 name_offset;                // Start of the name of the directory inside path
+#ifdef __linux__
+    int fd;
+    volatile u64 references;        // The directory itself and its subdirectories that haven't been opened yet
+#endif
+    WalkDirectory *next_pending;    // Directories left to read when there's no job system
+};
+
+struct Walk {
+    ConcurrentArena memory;
+    JobSystem *jobs;
+    JobGroup group;
+    u32 flags;
+    volatile u64 batches;           // Top of the stack of WalkBatch
+    volatile u64 error_count;
+    WalkDirectory *pending;
+};
+
+static void walk_publish_batch(Walk *walk, WalkBatch *batch) {
+    u64 top = atomic_load_u64(&walk->batches);
+    for (;;) {
+        batch->next = (WalkBatch*)top;
+        u64 prev_top = atomic_compare_exchange_u64(&walk->batches, top, (u64)batch);
+        if (prev_top == top) {
+            break;
+        }
+        top = prev_top;
+    }
+}
+
+static void walk_directory_read(WalkDirectory *directory, Arena *temp_arena);
+
+static void walk_directory_job(void *arg, Arena *arena) {
+    walk_directory_read((WalkDirectory*)arg, arena);
+}
+
+// Add an entry of the directory to the batch, and read it later if it's a subdirectory
+static void walk_emit(WalkDirectory *directory, WalkBatch **batch, const char *name, u64 name_length, DirectoryEntryType type, u64 size) {
+    Walk *walk = directory->walk;
+
+    // @NOTE: the root may already end with a separator, like "/" or "C:\"
+    String parent_path = directory->path;
+    bool needs_separator = parent_path.length > 0 && parent_path.data[parent_path.length - 1] != '/';
+#ifdef _WIN32
+    needs_separator = needs_separator && parent_path.data[parent_path.length - 1] != '\\';
+#endif
+    u64 name_offset = parent_path.length + (needs_separator ? 1 : 0);
+    u8 *path = arena_push_nozero(&walk->memory, u8, name_offset + name_length + 1);
+    memcpy(path, parent_path.data, parent_path.length);
+    if (needs_separator) {
+        path[parent_path.length] = '/';
+    }
+    memcpy(path + name_offset, name, name_length);
+    path[name_offset + name_length] = 0;
+
+    // Small directories are the most common, so batches start small and grow
+    if (*batch == 0 || (*batch)->count == (*batch)->capacity) {
+        u64 capacity = WALK_BATCH_MIN_CAPACITY;
+        if (*batch != 0) {
+            capacity = MIN((*batch)->capacity*2, (u64)WALK_BATCH_MAX_CAPACITY);
+            walk_publish_batch(walk, *batch);
+        }
+        WalkBatch *new_batch = arena_push(&walk->memory, WalkBatch);
+        new_batch->entries = arena_push_nozero(&walk->memory, DirectoryEntry, capacity);
+        new_batch->capacity = capacity;
+        *batch = new_batch;
+    }
+    DirectoryEntry *entry = &(*batch)->entries[(*batch)->count];
+    (*batch)->count += 1;
+    entry->path.data = path;
+    entry->path.length = name_offset + name_length;
+    entry->size = size;
+    entry->type = type;
+
+    if (type == DIRECTORY_ENTRY_DIRECTORY) {
+        WalkDirectory *subdirectory = arena_push(&walk->memory, WalkDirectory);
+        subdirectory->walk = walk;
+        subdirectory->parent = directory;
+        subdirectory->path = entry->path;
+        subdirectory->name_offset = name_offset;
+#ifdef __linux__
+        // The subdirectory is opened relative to this directory, so it must stay open until then
+        atomic_fetch_add_u64(&directory->references, 1);
+#endif
+        if (walk->jobs != 0) {
+            job_run(walk->jobs, &walk->group, walk_directory_job, subdirectory);
+        } else {
+            subdirectory->next_pending = walk->pending;
+            walk->pending = subdirectory;
+        }
+    }
+}
+
+#ifdef __linux__
+// Layout of the records returned by getdents64()
+typedef struct {
+    u64 d_ino;
+    i64 d_off;
+    u16 d_reclen;
+    u8 d_type;
+    char d_name[1];
+} LinuxDirent64;
+
+static void walk_directory_release(WalkDirectory *directory) {
+    if (atomic_fetch_add_u64(&directory->references, (u64)-1) == 1) {
+        close(directory->fd);
+    }
+}
+
+static DirectoryEntryType walk_type_from_mode(mode_t mode) {
+    DirectoryEntryType type = DIRECTORY_ENTRY_OTHER;
+    if (S_ISREG(mode)) {
+        type = DIRECTORY_ENTRY_FILE;
+    } else if (S_ISDIR(mode)) {
+        type = DIRECTORY_ENTRY_DIRECTORY;
+    } else if (S_ISLNK(mode)) {
+        type = DIRECTORY_ENTRY_SYMLINK;
+    }
+    return type;
+}
+#endif
+
+// Read the entries of the directory. Returns false if it can't be opened.
+static bool walk_directory_open_and_read(WalkDirectory *directory, Arena *temp_arena) {
+    Walk *walk = directory->walk;
+    u64 temp_arena_pos = arena_get_pos(temp_arena);
+    WalkBatch *batch = 0;
+    bool ok = true;
+
+#ifdef _WIN32
+    String pattern_suffix = string_from_cstring("/*");
+    const char *pattern = string_to_cstring(temp_arena, string_concat(temp_arena, directory->path, pattern_suffix));
+    WIN32_FIND_DATAA data = {};
+    HANDLE find = FindFirstFileExA(pattern, FindExInfoBasic, &data, FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+    if (find == INVALID_HANDLE_VALUE) {
+        arena_set_pos(temp_arena, temp_arena_pos);
+        return false;
+    }
+
+    do {
+        const char *name = data.cFileName;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+            continue;
+        }
+
+        DirectoryEntryType type = DIRECTORY_ENTRY_FILE;
+        u64 size = ((u64)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) {
+            type = DIRECTORY_ENTRY_SYMLINK;
+            size = 0;
+        } else if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            type = DIRECTORY_ENTRY_DIRECTORY;
+            size = 0;
+        } else if (data.dwFileAttributes & FILE_ATTRIBUTE_DEVICE) {
+            type = DIRECTORY_ENTRY_OTHER;
+            size = 0;
+        }
+        walk_emit(directory, &batch, name, strlen(name), type, size);
+    } while (FindNextFileA(find, &data));
+
+    if (GetLastError() != ERROR_NO_MORE_FILES) {
         ok = false;
     }
+    FindClose(find);
 
-    if (ok) {
-        // Get file size
-        fseek(file, 0, SEEK_END);
-        file_size = (u64) ftell(file);
-        fseek(file, 0, SEEK_SET);
+#elif __linux__
+    // Subdirectories don't follow symbolic links, in case a directory was replaced by one after it was listed
+    int parent_fd = directory->parent != 0 ? directory->parent->fd : AT_FDCWD;
+    int open_flags = O_RDONLY|O_DIRECTORY|O_CLOEXEC;
+    if (directory->parent != 0) {
+        open_flags |= O_NOFOLLOW;
+    }
+    directory->fd = openat(parent_fd, (const char*)directory->path.data + directory->name_offset, open_flags);
+    if (directory->parent != 0) {
+        walk_directory_release(directory->parent);
+    }
+    if (directory->fd == -1) {
+        return false;
+    }
+    directory->references = 1;
 
-        // Read the entire file into RAM
-        file_buffer = arena_push(arena, u8, file_size);
-        u64 total_read = 0;
-        while (total_read < file_size) {
-            u64 bytes_read = (u64) fread(file_buffer + total_read, 1, file_size - total_read, file);
-            if (bytes_read == 0) {
-                ok = false;
-                break;
+    // @NOTE: records are aligned to 8 bytes inside the buffer
+    u8 *buffer = (u8*)ARENA_PUSH_DATA(temp_arena, 1, WALK_DIRECTORY_BUFFER_SIZE, 8, 0);
+    bool with_sizes = (walk->flags & WALK_DIRECTORY_SIZES) != 0;
+    for (;;) {
+        long bytes_read = syscall(SYS_getdents64, directory->fd, buffer, WALK_DIRECTORY_BUFFER_SIZE);
+        if (bytes_read == -1 && errno == EINTR) {
+            continue;
+        }
+        if (bytes_read <= 0) {
+            ok = bytes_read == 0;
+            break;
+        }
+
+        for (long offset = 0; offset < bytes_read;) {
+            LinuxDirent64 *record = (LinuxDirent64*)(buffer + offset);
+            offset += record->d_reclen;
+
+            const char *name = record->d_name;
+            if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0))) {
+                continue;
             }
 
-            total_read += bytes_read;
+            DirectoryEntryType type = DIRECTORY_ENTRY_UNKNOWN;
+            switch (record->d_type) {
+                case DT_REG: type = DIRECTORY_ENTRY_FILE; break;
+                case DT_DIR: type = DIRECTORY_ENTRY_DIRECTORY; break;
+                case DT_LNK: type = DIRECTORY_ENTRY_SYMLINK; break;
+                case DT_UNKNOWN: break;
+                default: type = DIRECTORY_ENTRY_OTHER; break;
+            }
+
+            // Some file systems don't fill d_type, so the type comes from fstatat() as well
+            u64 size = 0;
+            if (type == DIRECTORY_ENTRY_UNKNOWN || (with_sizes && type == DIRECTORY_ENTRY_FILE)) {
+                struct stat st = {};
+                if (fstatat(directory->fd, name, &st, AT_SYMLINK_NOFOLLOW) == 0) {
+                    type = walk_type_from_mode(st.st_mode);
+                    size = with_sizes && type == DIRECTORY_ENTRY_FILE ? (u64)st.st_size : 0;
+                }
+            }
+            walk_emit(directory, &batch, name, strlen(name), type, size);
         }
     }
 
-    if (file != 0) {
-        fclose(file);
-    }
+    walk_directory_release(directory);
 
+#else
+    #error "Not implemented for your platform"
 #endif
 
+    if (batch != 0) {
+        walk_publish_batch(walk, batch);
+    }
+    arena_set_pos(temp_arena, temp_arena_pos);
+    return ok;
+}
+
+static void walk_directory_read(WalkDirectory *directory, Arena *temp_arena) {
+    if (!walk_directory_open_and_read(directory, temp_arena)) {
+        atomic_fetch_add_u64(&directory->walk->error_count, 1);
+    }
+}
+
+bool walk_directory(Arena *arena, JobSystem *jobs, String root, u32 flags, DirectoryListing *out_listing) {
+    assert(out_listing != 0);
+
+    Walk walk = {};
+    walk.memory = concurrent_arena_alloc(WALK_DIRECTORY_CAPACITY);
+    walk.jobs = jobs;
+    walk.flags = flags;
+
+    WalkDirectory *root_directory = arena_push(&walk.memory, WalkDirectory);
+    u8 *root_path = arena_push_nozero(&walk.memory, u8, root.length + 1);
+    memcpy(root_path, root.data, root.length);
+    root_path[root.length] = 0;
+    root_directory->walk = &walk;
+    root_directory->path.data = root_path;
+    root_directory->path.length = root.length;
+
+    // The root is read by the calling thread, then the subdirectories by the job system or in a loop
+    TempArena scratch = scratch_begin(&arena, 1);
+    bool ok = walk_directory_open_and_read(root_directory, scratch.arena);
+    while (walk.pending != 0) {
+        WalkDirectory *directory = walk.pending;
+        walk.pending = directory->next_pending;
+        walk_directory_read(directory, scratch.arena);
+    }
+    scratch_end(scratch);
+    if (jobs != 0) {
+        job_group_wait(jobs, &walk.group);
+    }
+
+    // Copy the entries and their paths into the arena, one directory after another
+    DirectoryListing listing = {};
+    listing.error_count = walk.error_count;
     if (ok) {
-        out_file_buffer->data = file_buffer;
-        out_file_buffer->length = file_size;
-    } else {
-        // Failed to read file. Deallocate any memory used.
-        arena_set_pos(arena, arena_original_pos);
+        u64 path_bytes = 0;
+        for (WalkBatch *batch = (WalkBatch*)walk.batches; batch != 0; batch = batch->next) {
+            listing.count += batch->count;
+            for (u64 i = 0; i < batch->count; i++) {
+                path_bytes += batch->entries[i].path.length + 1;
+            }
+        }
+
+        listing.entries = arena_push_nozero(arena, DirectoryEntry, MAX(listing.count, (u64)1));
+        u8 *paths = arena_push_nozero(arena, u8, MAX(path_bytes, (u64)1));
+        u64 index = 0;
+        for (WalkBatch *batch = (WalkBatch*)walk.batches; batch != 0; batch = batch->next) {
+            for (u64 i = 0; i < batch->count; i++) {
+                DirectoryEntry entry = batch->entries[i];
+                memcpy(paths, entry.path.data, entry.path.length + 1);
+                entry.path.data = paths;
+                paths += entry.path.length + 1;
+                listing.entries[index] = entry;
+                index += 1;
+            }
+        }
     }
+    *out_listing = listing;
 
+    concurrent_arena_free(&walk.memory);
     return ok;
 }
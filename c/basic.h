@@ -6,13 +6,37 @@
  *  - Buffers
  *  - Strings
  *  - Arena and scratch arena
+ *  - Pool of fixed-size objects
+ *  - General-purpose heap
+ *  - Dynamic array
+ *  - Hash map keyed by strings
  *  - Basic file I/O
+ *  - File content cache
+ *  - Threads, atomics and synchronization primitives
+ *  - Streaming file reader
+ *  - String interning
+ *  - Mirrored ring buffer
+ *  - Lock-free queues
+ *  - Job system
+ *  - Directory walker
  *
  * Tests are defined in `basic_test.cpp`.
  * */
 
+#include <assert.h>
 #include <stdalign.h>
 #include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+#ifdef _MSC_VER
+#   include <intrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#   define BASIC_SSE2
+#   include <emmintrin.h>
+#endif
 
 // ####################################################################################################################
 // Primitive types
@@ -59,19 +83,125 @@ typedef double f64;
 #define CLAMP(val, min, max) (MIN(MAX(val, min), max))
 #define ABS(val) (val >= 0 ? val : -val)
 
+// Index of the lowest and highest set bit. The result is undefined if value is zero.
+#if defined(_MSC_VER) && !defined(__clang__)
+static inline u32 bit_scan_forward_u64(u64 value) { unsigned long index; _BitScanForward64(&index, value); return (u32)index; }
+static inline u32 bit_scan_reverse_u64(u64 value) { unsigned long index; _BitScanReverse64(&index, value); return (u32)index; }
+#else
+static inline u32 bit_scan_forward_u64(u64 value) { return (u32)__builtin_ctzll(value); }
+static inline u32 bit_scan_reverse_u64(u64 value) { return (u32)(63 - __builtin_clzll(value)); }
+#endif
+
 #define BUFFER_TO_STRING(buffer) (String){ .data = (const u8*) buffer.data, .length = buffer.length }
 
 // ====================================================================================================================
 // Arena
+
+// Arena flags
+#define ARENA_FLAG_GROWABLE       (1 << 0) // Chain a new block when the arena runs out of memory instead of aborting
+#define ARENA_FLAG_DECOMMIT       (1 << 1) // Return committed pages to the OS in arena_set_pos() and arena_clear()
+#define ARENA_FLAG_DECOMMIT_LAZY  (1 << 2) // Like ARENA_FLAG_DECOMMIT, but the OS reclaims the pages only under memory pressure
+#define ARENA_FLAG_PREFAULT       (1 << 3) // Fault in pages as soon as they are committed instead of on first access
+#define ARENA_FLAG_HUGE_PAGES     (1 << 4) // Back the arena with huge pages when the platform supports them
+#define ARENA_FLAG_DEBUG          (1 << 5) // Poison memory released by arena_set_pos() and add guard pages. See below.
+
+#define ARENA_DEFAULT_DECOMMIT_THRESHOLD  (256*KiB)
+#define ARENA_DEFAULT_COMMIT_GRANULARITY  (64*KiB)
+
+// With ARENA_FLAG_HUGE_PAGES the arena is reserved in ranges aligned to ARENA_HUGE_PAGE_SIZE, which is also used as the
+// page size of the arena. In Linux it uses pages from the hugetlbfs pool if there are enough of them, otherwise it falls
+// back to transparent huge pages. In Windows large pages can't be committed on demand, so regular pages are used instead.
+#define ARENA_HUGE_PAGE_SIZE              (2*MiB)
+
+// Debug mode catches code that keeps using memory after arena_set_pos(), arena_clear() or temp_arena_end() released it:
+// - With AddressSanitizer, the released memory and the memory past the position are poisoned, so any access is reported.
+// - Otherwise, released memory is filled with ARENA_DEBUG_POISON_BYTE and the pages that were released entirely are made
+//   inaccessible until they are pushed again. Pages are committed one at a time, so writing past the committed memory
+//   always hits an inaccessible page, and every block has a guard page after its end.
+// Without AddressSanitizer it costs a memset of the released bytes, plus one mprotect when whole pages are released and
+// another one when they are pushed again. Pushes that don't cross a page boundary cost the same as in regular arenas.
+// Enable it in every arena, including scratch arenas, by defining ARENA_DEBUG when compiling basic.cpp (for example,
+// with -DARENA_DEBUG).
+#define ARENA_DEBUG_POISON_BYTE           0xDD
+
+// Saved state of the previous block of a growable arena. It's stored at the beginning of the block that follows it.
+typedef struct ArenaBlock ArenaBlock;
+
+// Statistics. Define ARENA_STATS in every translation unit (for example, with -DARENA_STATS) to record them. When it's
+// not defined they compile to nothing and the push functions are exactly the same. Debug builds (NDEBUG not defined)
+// also record how many bytes were pushed from every __FILE__/__LINE__ through the arena_push() macros.
+#ifdef ARENA_STATS
+#   ifndef NDEBUG
+#       define ARENA_STATS_CALLSITES
+#   endif
+
+#define ARENA_STATS_MAX_CALLSITES 1024
+
+typedef struct {
+    u64 peak_pos;           // Highest position ever reached
+    u64 push_count;
+    u64 pushed_bytes;       // Bytes requested by pushes, without padding
+    u64 padding_bytes;      // Bytes wasted to align pushes
+    u64 commit_count;       // Syscalls made to commit memory
+    u64 decommit_count;     // Syscalls made to decommit memory
+    u64 block_count;        // Blocks reserved by growable arenas after the first one
+    u64 in_place_growths;   // arena_grow_in_place_or_realloc() calls that grew the memory in place
+    u64 reallocations;      // arena_grow_in_place_or_realloc() calls that had to clone the memory
+} ArenaStats;
+
+typedef struct {
+    const char *file;       // Null for unused entries
+    u32 line;
+    u64 push_count;
+    u64 pushed_bytes;
+} ArenaCallsite;
+#endif
+
 typedef struct {
     u8 *_memory_start;
     u8 *_position;
     u8 *_next_reserved_page;
+    u8 *_protected_end;         // Debug mode only. Released pages below it were made inaccessible but are still committed.
     u64 _capacity;
     u64 _page_size;
+
+    // Growable arenas only. Positions returned by arena_get_pos() are relative to the first block, so _base_pos is the
+    // position where the current block starts.
+    u64 _base_pos;
+    ArenaBlock *_prev_block;
+    u32 _flags;
+
+    // Decommit policy
+    u64 _retain_size;
+    u64 _decommit_threshold;
+
+    u64 _commit_granularity;
+
+#ifdef ARENA_STATS
+    ArenaStats _stats;
+    ArenaCallsite *_callsites;
+#endif
 } Arena;
 
+typedef struct {
+    u64 capacity;   // Memory reserved up front. Growable arenas reserve blocks of geometrically increasing size after it.
+    u32 flags;      // Any combination of ARENA_FLAG_* values
+
+    // Decommit policy, used only with ARENA_FLAG_DECOMMIT or ARENA_FLAG_DECOMMIT_LAZY. When the position of the arena goes
+    // back, the committed pages above MAX(position, retain_size) are decommitted, but only if they add up to at least
+    // decommit_threshold bytes. The threshold avoids committing and decommitting the same pages over and over when the
+    // position oscillates around the same value. A threshold of zero uses ARENA_DEFAULT_DECOMMIT_THRESHOLD.
+    u64 retain_size;
+    u64 decommit_threshold;
+
+    // Memory is committed in chunks of this size, so filling the arena with small objects doesn't make a syscall every
+    // time a push crosses a page boundary. It's rounded up to a power of two that is at least the page size. Zero uses
+    // ARENA_DEFAULT_COMMIT_GRANULARITY.
+    u64 commit_granularity;
+} ArenaParams;
+
 Arena arena_alloc(u64 capacity_hint);
+Arena arena_alloc_params(ArenaParams params);
 void  arena_free(Arena *arena);
 
 // Push macros and functions. Use the following macros with some example arguments:
@@ -81,24 +211,307 @@ void  arena_free(Arena *arena);
 // - arena_push_nozero(&arena, char, 30)
 #define GET_ARENA_PUSH_MACRO(_1, _2, _3, MACRO, ...) MACRO
 #define arena_push(...) GET_ARENA_PUSH_MACRO(__VA_ARGS__, arena_push_3, arena_push_2, arena_push_1)(__VA_ARGS__)
-#define arena_push_2(arena, type) (type*)arena_push_data(arena, sizeof(type), 1, alignof(type), 1)
-#define arena_push_3(arena, type, count) (type*)arena_push_data(arena, sizeof(type), count, alignof(type), 1)
+#define arena_push_2(arena, type) (type*)ARENA_PUSH_DATA(arena, sizeof(type), 1, alignof(type), 1)
+#define arena_push_3(arena, type, count) (type*)ARENA_PUSH_DATA(arena, sizeof(type), count, alignof(type), 1)
 #define arena_push_nozero(...) GET_ARENA_PUSH_MACRO(__VA_ARGS__, arena_push_nozero_3, arena_push_nozero_2, arena_push_nozero_1)(__VA_ARGS__)
-#define arena_push_nozero_2(arena, type) (type*)arena_push_data(arena, sizeof(type), 1, alignof(type), 0)
-#define arena_push_nozero_3(arena, type, count) (type*)arena_push_data(arena, sizeof(type), count, alignof(type), 0)
+#define arena_push_nozero_2(arena, type) (type*)ARENA_PUSH_DATA(arena, sizeof(type), 1, alignof(type), 0)
+#define arena_push_nozero_3(arena, type, count) (type*)ARENA_PUSH_DATA(arena, sizeof(type), count, alignof(type), 0)
 void *arena_push_data(Arena *arena, u64 type_size, u64 count, u64 alignment, b32 zero_data);
 
+#ifdef ARENA_STATS_CALLSITES
+#   define ARENA_PUSH_DATA(arena, type_size, count, alignment, zero_data) \
+        arena_push_data_callsite(arena, type_size, count, alignment, zero_data, __FILE__, __LINE__)
+void *arena_push_data_callsite(Arena *arena, u64 type_size, u64 count, u64 alignment, b32 zero_data, const char *file, u32 line);
+#else
+#   define ARENA_PUSH_DATA(arena, type_size, count, alignment, zero_data) \
+        arena_push_data(arena, type_size, count, alignment, zero_data)
+#endif
+
 // Grow the element pushed in the arena or reallocate it if there's not space left. It's discouraged to use this function
 // directly. Use any of the arena_push() or arena_push_nozero() macros instead.
 #define arena_grow_in_place_or_realloc(arena, type, prev_memory, prev_count, new_count) \
     (type*)arena_grow_in_place_or_realloc_impl(arena, prev_memory, sizeof(type)*prev_count, sizeof(type)*new_count, alignof(type))
 void *arena_grow_in_place_or_realloc_impl(Arena *arena, void *prev_memory, u64 prev_size, u64 new_size, u64 alignment);
 
+// Commit and fault in the memory needed to push size more bytes, so the first touch of those pages doesn't happen in a
+// latency-sensitive path later on. It never commits past the end of the current block.
+void arena_commit(Arena *arena, u64 size);
+
 u64  arena_get_capacity(Arena *arena);
 u64  arena_get_pos(Arena *arena);
 void arena_set_pos(Arena *arena, u64 pos);
 void arena_clear(Arena *arena);
 
+#ifdef ARENA_STATS
+ArenaStats arena_get_stats(Arena *arena);
+
+// Table of callsites with ARENA_STATS_MAX_CALLSITES entries. Unused entries have a null file. It's null if nothing has
+// been pushed from the arena_push() macros yet or if ARENA_STATS_CALLSITES isn't defined.
+const ArenaCallsite *arena_get_callsites(Arena *arena);
+
+// Print the statistics of the arena and its callsites sorted by pushed bytes to stdout
+void arena_print_stats(Arena *arena, const char *name);
+#endif
+
+// Temporary arena. It saves the position of an arena and restores it when it ends, so everything pushed in between is
+// deallocated at once.
+typedef struct {
+    Arena *arena;
+    u64 pos;
+} TempArena;
+
+TempArena temp_arena_begin(Arena *arena);
+void      temp_arena_end(TempArena temp);
+
+// ====================================================================================================================
+// Scratch arena
+//
+// Every thread has its own pool of scratch arenas that are reserved the first time they are used and reused for the
+// rest of the lifetime of the thread. Use them for temporary memory that never outlives the function that requested it:
+//
+//     TempArena scratch = scratch_begin(&arena, 1);
+//     ...
+//     scratch_end(scratch);
+//
+// scratch_begin() never returns an arena listed in conflicts. Pass the arenas where the caller pushes its results, so
+// the temporary memory doesn't clobber them (for example, when a function that uses scratch memory calls another one).
+#define SCRATCH_ARENA_COUNT 2
+#define SCRATCH_ARENA_CAPACITY ((u64)64*GiB)
+
+TempArena scratch_begin(Arena **conflicts, u64 conflict_count);
+void      scratch_end(TempArena scratch);
+
+// ====================================================================================================================
+// Concurrent arena
+//
+// Arena that can be pushed from several threads at the same time without locks. Every thread bump-allocates from its own
+// chunk of CONCURRENT_ARENA_CHUNK_SIZE bytes and only touches the shared position, with an atomic fetch-add, when the chunk
+// is exhausted. Pushes bigger than a quarter of a chunk bypass the chunk and are reserved directly from the shared
+// position. Threads commit pages on demand and publish the committed size with a compare-and-swap, so no thread ever waits
+// for another one.
+//
+// It supports the same push macros as Arena: arena_push(&concurrent_arena, MyStruct). The rest of operations
+// (concurrent_arena_clear(), concurrent_arena_free()) must not run at the same time as any push.
+#define CONCURRENT_ARENA_CHUNK_SIZE (32*KiB)
+
+typedef struct {
+    u8 *_memory_start;
+    u64 _capacity;
+    u64 _page_size;
+    u64 _commit_granularity;
+
+    // Identifies this arena in the per-thread chunk caches. It changes every time the arena is cleared, so the chunks
+    // cached by every thread become invalid at once.
+    u64 _id;
+
+    // Shared state. Each value lives in its own cache line to avoid false sharing between them.
+    alignas(64) volatile u64 _position;
+    alignas(64) volatile u64 _committed_size;
+} ConcurrentArena;
+
+ConcurrentArena concurrent_arena_alloc(u64 capacity_hint);
+void            concurrent_arena_free(ConcurrentArena *arena);
+void           *arena_push_data(ConcurrentArena *arena, u64 type_size, u64 count, u64 alignment, b32 zero_data);
+#ifdef ARENA_STATS_CALLSITES
+void           *arena_push_data_callsite(ConcurrentArena *arena, u64 type_size, u64 count, u64 alignment, b32 zero_data, const char *file, u32 line);
+#endif
+
+// Memory handed out to threads, including the part of their chunks they haven't used yet
+u64  concurrent_arena_get_pos(ConcurrentArena *arena);
+void concurrent_arena_clear(ConcurrentArena *arena);
+
+// ####################################################################################################################
+// Pool
+//
+// Allocator of objects of a fixed size that can be released one by one and reused. Objects are carved from slabs pushed
+// into an arena and released objects are kept in an intrusive free list, so pushing and releasing are O(1) and the system
+// allocator is never involved. The slabs belong to the arena, so their memory is deallocated with it.
+//
+//     Pool pool = pool_make(&arena, Connection, 256);
+//     Connection *connection = pool_push(&pool, Connection);
+//     ...
+//     pool_release(&pool, connection);
+typedef struct {
+    Arena *_arena;
+    void *_free_list;
+    u8 *_slab_position;
+    u8 *_slab_end;
+    u64 _object_size;
+    u64 _alignment;
+    u64 _objects_per_slab;
+} Pool;
+
+#define pool_make(arena, type, objects_per_slab) pool_make_impl(arena, sizeof(type), alignof(type), objects_per_slab)
+Pool pool_make_impl(Arena *arena, u64 object_size, u64 alignment, u64 objects_per_slab);
+
+#define pool_push(pool, type) (type*)pool_push_data(pool, sizeof(type), 1)
+#define pool_push_nozero(pool, type) (type*)pool_push_data(pool, sizeof(type), 0)
+void *pool_push_data(Pool *pool, u64 object_size, b32 zero_data);
+void  pool_release(Pool *pool, void *object);
+
+// ####################################################################################################################
+// Heap
+//
+// General-purpose allocator where every allocation can be released individually. It's a Two-Level Segregated Fit (TLSF)
+// allocator: free blocks are kept in lists segregated by size classes, and two levels of bitmaps find a free list with
+// a block big enough in constant time, so heap_push_data() and heap_release() are O(1) and their latency is bounded.
+// Released blocks are merged with their free neighbours right away.
+//
+// The heap reserves its whole capacity up front like an arena and commits pages on demand as it grows. It's not thread
+// safe.
+//
+//     Heap heap = heap_alloc(GiB);
+//     Message *message = heap_push(&heap, Message);
+//     u8 *payload = heap_push_nozero(&heap, u8, payload_size);
+//     ...
+//     heap_release(&heap, payload);
+//     heap_release(&heap, message);
+//     heap_free(&heap);
+#define HEAP_ALIGNMENT      16  // Minimum alignment of every allocation
+#define HEAP_SL_COUNT_LOG2  4
+#define HEAP_SL_COUNT       (1 << HEAP_SL_COUNT_LOG2)
+#define HEAP_FL_COUNT       41  // Enough size classes for blocks up to 2^48 bytes
+
+typedef struct HeapBlock HeapBlock;
+
+typedef struct {
+    u8 *_memory_start;
+    u8 *_top;               // End of the memory carved into blocks
+    u8 *_committed_end;
+    u64 _capacity;
+    u64 _used_size;
+    HeapBlock *_last_block; // Block right before _top
+
+    // First level: size classes by power of two. Second level: HEAP_SL_COUNT linear subdivisions of each first level.
+    u64 _fl_bitmap;
+    u32 _sl_bitmaps[HEAP_FL_COUNT];
+    HeapBlock *_free_lists[HEAP_FL_COUNT][HEAP_SL_COUNT];
+} Heap;
+
+typedef struct {
+    u64 used_size;      // Bytes in blocks that haven't been released, including their headers
+    u64 heap_size;      // Bytes carved into blocks, either used or free
+    u64 committed_size;
+} HeapStats;
+
+Heap heap_alloc(u64 capacity_hint);
+void heap_free(Heap *heap);
+
+// Push macros. They follow the same conventions as arena_push() and arena_push_nozero().
+#define heap_push(...) GET_ARENA_PUSH_MACRO(__VA_ARGS__, heap_push_3, heap_push_2, heap_push_1)(__VA_ARGS__)
+#define heap_push_2(heap, type) (type*)heap_push_data(heap, sizeof(type), alignof(type), 1)
+#define heap_push_3(heap, type, count) (type*)heap_push_data(heap, sizeof(type)*(count), alignof(type), 1)
+#define heap_push_nozero(...) GET_ARENA_PUSH_MACRO(__VA_ARGS__, heap_push_nozero_3, heap_push_nozero_2, heap_push_nozero_1)(__VA_ARGS__)
+#define heap_push_nozero_2(heap, type) (type*)heap_push_data(heap, sizeof(type), alignof(type), 0)
+#define heap_push_nozero_3(heap, type, count) (type*)heap_push_data(heap, sizeof(type)*(count), alignof(type), 0)
+void *heap_push_data(Heap *heap, u64 size, u64 alignment, b32 zero_data);
+void  heap_release(Heap *heap, void *memory);
+
+HeapStats heap_get_stats(Heap *heap);
+
+// ####################################################################################################################
+// Dynamic array
+//
+// Growable array of trivially copyable elements whose memory is pushed into an arena. When it runs out of room it grows
+// in place if its data is the last element of the arena, otherwise it pushes a buffer twice as big and copies the
+// elements. The new elements are not zeroed out because all of them are written before they are read.
+//
+// The array doesn't own its memory, so there's nothing to free. It's released with the arena.
+//
+//     Array<u32> numbers = array_make(&arena, u32, 0);
+//     array_push(&numbers, 42);
+//     u32 last = array_pop(&numbers);
+#define ARRAY_MIN_CAPACITY 8
+
+// Exclude a function parameter from template argument deduction, so array_push(&numbers, 42) works with Array<u32>
+template <typename T>
+struct NoDeduce {
+    typedef T Type;
+};
+
+template <typename T>
+struct Array {
+    static_assert(std::is_trivially_copyable<T>::value, "Array only supports trivially copyable types");
+
+    T *data;
+    u64 length;
+    u64 capacity;
+    Arena *_arena;
+
+    T &operator[](u64 index) {
+        assert(index < length);
+        return data[index];
+    }
+};
+
+#define array_make(arena, type, capacity) array_make_impl<type>(arena, capacity)
+
+// Make sure the array has room for at least `capacity` elements. It never shrinks.
+template <typename T>
+void array_reserve(Array<T> *array, u64 capacity) {
+    if (capacity <= array->capacity) {
+        return;
+    }
+
+    if (array->data == 0) {
+        array->data = arena_push_nozero(array->_arena, T, capacity);
+    } else {
+        array->data = arena_grow_in_place_or_realloc(array->_arena, T, array->data, array->capacity, capacity);
+    }
+    array->capacity = capacity;
+}
+
+template <typename T>
+Array<T> array_make_impl(Arena *arena, u64 capacity) {
+    Array<T> array = {};
+    array._arena = arena;
+    array_reserve(&array, capacity);
+    return array;
+}
+
+// Grow the array to hold at least `capacity` elements, doubling its capacity to keep pushes amortized O(1)
+template <typename T>
+void array_grow(Array<T> *array, u64 capacity) {
+    u64 new_capacity = MAX(MAX(array->capacity*2, capacity), (u64)ARRAY_MIN_CAPACITY);
+    array_reserve(array, new_capacity);
+}
+
+// Returns a pointer to the new element
+template <typename T>
+T *array_push(Array<T> *array, typename NoDeduce<T>::Type value) {
+    if (array->length == array->capacity) {
+        array_grow(array, array->length + 1);
+    }
+    T *element = &array->data[array->length];
+    *element = value;
+    array->length += 1;
+    return element;
+}
+
+template <typename T>
+void array_append(Array<T> *array, const T *elements, u64 count) {
+    if (count == 0) {
+        return;
+    }
+    if (array->length + count > array->capacity) {
+        array_grow(array, array->length + count);
+    }
+    memcpy(array->data + array->length, elements, sizeof(T)*count);
+    array->length += count;
+}
+
+template <typename T>
+T array_pop(Array<T> *array) {
+    assert(array->length > 0);
+    array->length -= 1;
+    return array->data[array->length];
+}
+
+template <typename T>
+void array_clear(Array<T> *array) {
+    array->length = 0;
+}
+
 // ####################################################################################################################
 // Buffer
 typedef struct {
@@ -168,8 +581,1013 @@ bool   string_ends_with  (String str, String search);
 String string_slice      (String str, u64 start, u64 end);
 String string_concat     (Arena *arena, String a, String b);
 
+// 64-bit hash of the bytes of the string. It's not cryptographically secure.
+u64    string_hash       (String str);
+
+// ####################################################################################################################
+// Hash map keyed by strings
+//
+// Open-addressing hash map in the style of Swiss tables. Each slot has a control byte that is either empty, deleted or
+// the lower 7 bits of the hash of its key. A lookup probes groups of 16 control bytes at once, with SSE2 when it's
+// available, and only compares the keys whose 7 bits match.
+//
+// The control bytes and the slots are pushed into an arena. When the map is 7/8 full it pushes a table twice as big and
+// moves every element into it. The old table stays in the arena until the arena is cleared.
+//
+// Keys are String views: the map doesn't copy them, so the memory they point to must outlive the map.
+//
+//     StringMap<u32> ports = string_map_make(&arena, u32, 0);
+//     string_map_put(&ports, S("http"), 80);
+//     u32 *port = string_map_get(&ports, S("http"));
+#define STRING_MAP_GROUP_WIDTH   16
+#define STRING_MAP_MIN_CAPACITY  16
+#define STRING_MAP_CTRL_EMPTY    ((u8)0x80)
+#define STRING_MAP_CTRL_DELETED  ((u8)0xFE)
+
+template <typename T>
+struct StringMapSlot {
+    String key;
+    T value;
+};
+
+template <typename T>
+struct StringMap {
+    static_assert(std::is_trivially_copyable<T>::value, "StringMap only supports trivially copyable values");
+
+    u64 length;
+    u8 *_ctrl;                  // _capacity control bytes followed by a copy of the first group, so groups never wrap
+    StringMapSlot<T> *_slots;
+    u64 _capacity;              // Power of two
+    u64 _growth_left;           // Empty slots that can be used before the map has to grow
+    Arena *_arena;
+};
+
+#define string_map_make(arena, type, capacity) string_map_make_impl<type>(arena, capacity)
+
+// Bit i of the result is set if byte i of the group equals value
+static inline u32 string_map_group_match(const u8 *group, u8 value) {
+#ifdef BASIC_SSE2
+    __m128i bytes = _mm_loadu_si128((const __m128i*)group);
+    u32 mask = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8((char)value)));
+    return mask;
+#else
+    u32 mask = 0;
+    for (u32 i = 0; i < STRING_MAP_GROUP_WIDTH; i++) {
+        mask |= (u32)(group[i] == value) << i;
+    }
+    return mask;
+#endif
+}
+
+// Bit i of the result is set if byte i of the group is empty or deleted. Both have the highest bit set.
+static inline u32 string_map_group_match_free(const u8 *group) {
+#ifdef BASIC_SSE2
+    u32 mask = (u32)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group));
+    return mask;
+#else
+    u32 mask = 0;
+    for (u32 i = 0; i < STRING_MAP_GROUP_WIDTH; i++) {
+        mask |= (u32)(group[i] >> 7) << i;
+    }
+    return mask;
+#endif
+}
+
+template <typename T>
+void string_map_set_ctrl(StringMap<T> *map, u64 index, u8 ctrl) {
+    map->_ctrl[index] = ctrl;
+    if (index < STRING_MAP_GROUP_WIDTH) {
+        map->_ctrl[map->_capacity + index] = ctrl;
+    }
+}
+
+// Index of the first empty or deleted slot in the probe sequence of the hash
+template <typename T>
+u64 string_map_find_free_slot(StringMap<T> *map, u64 hash) {
+    u64 mask = map->_capacity - 1;
+    u64 position = (hash >> 7) & mask;
+    for (u64 step = STRING_MAP_GROUP_WIDTH;; step += STRING_MAP_GROUP_WIDTH) {
+        u32 free_slots = string_map_group_match_free(map->_ctrl + position);
+        if (free_slots != 0) {
+            u64 index = (position + bit_scan_forward_u64(free_slots)) & mask;
+            return index;
+        }
+        position = (position + step) & mask;
+    }
+}
+
+template <typename T>
+void string_map_rehash(StringMap<T> *map, u64 capacity) {
+    assert(capacity >= STRING_MAP_MIN_CAPACITY && (capacity & (capacity - 1)) == 0);
+    StringMap<T> old = *map;
+
+    map->_ctrl = arena_push_nozero(map->_arena, u8, capacity + STRING_MAP_GROUP_WIDTH);
+    memset(map->_ctrl, STRING_MAP_CTRL_EMPTY, capacity + STRING_MAP_GROUP_WIDTH);
+    map->_slots = arena_push_nozero(map->_arena, StringMapSlot<T>, capacity);
+    map->_capacity = capacity;
+    map->_growth_left = capacity - capacity/8 - map->length;
+
+    for (u64 i = 0; i < old._capacity; i++) {
+        if ((old._ctrl[i] & 0x80) == 0) {
+            u64 hash = string_hash(old._slots[i].key);
+            u64 index = string_map_find_free_slot(map, hash);
+            string_map_set_ctrl(map, index, (u8)(hash & 0x7F));
+            map->_slots[index] = old._slots[i];
+        }
+    }
+}
+
+template <typename T>
+StringMap<T> string_map_make_impl(Arena *arena, u64 capacity) {
+    StringMap<T> map = {};
+    map._arena = arena;
+
+    // Room for `capacity` elements without growing
+    u64 table_capacity = STRING_MAP_MIN_CAPACITY;
+    while (table_capacity - table_capacity/8 < capacity) {
+        table_capacity *= 2;
+    }
+    string_map_rehash(&map, table_capacity);
+    return map;
+}
+
+// Index of the slot of the key, or _capacity if the key is not in the map
+template <typename T>
+u64 string_map_find_index(StringMap<T> *map, String key, u64 hash) {
+    u8 h2 = (u8)(hash & 0x7F);
+    u64 mask = map->_capacity - 1;
+    u64 position = (hash >> 7) & mask;
+    for (u64 step = STRING_MAP_GROUP_WIDTH;; step += STRING_MAP_GROUP_WIDTH) {
+        const u8 *group = map->_ctrl + position;
+        for (u32 matches = string_map_group_match(group, h2); matches != 0; matches &= matches - 1) {
+            u64 index = (position + bit_scan_forward_u64(matches)) & mask;
+            if (string_equals(map->_slots[index].key, key)) {
+                return index;
+            }
+        }
+
+        // An empty slot ends the probe sequence because an insertion would have used it
+        if (string_map_group_match(group, STRING_MAP_CTRL_EMPTY) != 0) {
+            return map->_capacity;
+        }
+        position = (position + step) & mask;
+    }
+}
+
+// Returns a pointer to the value of the key, or 0 if the key is not in the map
+template <typename T>
+T *string_map_get(StringMap<T> *map, String key) {
+    u64 index = string_map_find_index(map, key, string_hash(key));
+    T *value = index < map->_capacity ? &map->_slots[index].value : 0;
+    return value;
+}
+
+// Insert the key or overwrite its value if it's already in the map. Returns a pointer to the value.
+template <typename T>
+T *string_map_put(StringMap<T> *map, String key, typename NoDeduce<T>::Type value) {
+    u64 hash = string_hash(key);
+    u64 index = string_map_find_index(map, key, hash);
+    if (index < map->_capacity) {
+        map->_slots[index].value = value;
+        return &map->_slots[index].value;
+    }
+
+    index = string_map_find_free_slot(map, hash);
+    if (map->_ctrl[index] == STRING_MAP_CTRL_EMPTY && map->_growth_left == 0) {
+        // Grow if the map is mostly full of elements. Otherwise a good part of the used slots are deleted and rehashing
+        // into a table of the same size is enough to clean them up. Same threshold as Abseil's flat_hash_map.
+        u64 capacity = map->length*32 > map->_capacity*25 ? map->_capacity*2 : map->_capacity;
+        string_map_rehash(map, capacity);
+        index = string_map_find_free_slot(map, hash);
+    }
+
+    if (map->_ctrl[index] == STRING_MAP_CTRL_EMPTY) {
+        map->_growth_left -= 1;
+    }
+    string_map_set_ctrl(map, index, (u8)(hash & 0x7F));
+    map->_slots[index].key = key;
+    map->_slots[index].value = value;
+    map->length += 1;
+    return &map->_slots[index].value;
+}
+
+// Returns true if the key was in the map
+template <typename T>
+bool string_map_remove(StringMap<T> *map, String key) {
+    u64 index = string_map_find_index(map, key, string_hash(key));
+    if (index == map->_capacity) {
+        return false;
+    }
+
+    // @NOTE: the slot is marked as deleted instead of empty so it doesn't break the probe sequence of other keys
+    string_map_set_ctrl(map, index, STRING_MAP_CTRL_DELETED);
+    map->length -= 1;
+    return true;
+}
+
 // ####################################################################################################################
 // File I/O
 
 // Read the entire content of the file requested in file_name and store it into out_file_buffer. Return value indicates success.
 bool read_entire_file(Arena *arena, String file_name, Buffer *out_file_buffer);
+
+// File mapped into memory with map_entire_file(). The contents are read-only: writing to them crashes the program.
+typedef struct {
+    Buffer contents;
+    bool _is_mapped;    // False if the contents were copied into the arena
+} MappedFile;
+
+// Hints for map_entire_file()
+#define MAP_FILE_SEQUENTIAL (1 << 0)    // The file will be read from the beginning to the end, so read ahead aggressively
+#define MAP_FILE_WILL_NEED  (1 << 1)    // Start reading the whole file in the background right away
+
+// Map the file into memory instead of copying it, so pages are read from the page cache on demand and nothing is copied.
+// Pipes, character devices and files that don't report their size, like the ones in /proc, can't be mapped: their
+// contents are read into the arena instead. The arena is also used for temporary memory. Return value indicates success.
+bool map_entire_file(Arena *arena, String file_name, u32 flags, MappedFile *out_file);
+// Release the mapping. Contents that were copied into the arena are released with the arena.
+void unmap_file(MappedFile *file);
+
+// Read many files at once into the arena. In Linux the opens, stats, reads and closes of up to READ_FILES_IN_FLIGHT
+// files are submitted together through io_uring, so there's no syscall per file. Without io_uring, or with the flag
+// READ_FILES_NO_IO_URING, a pool of threads reads the files with blocking calls.
+//
+// out_files[i] and out_ok[i] receive the contents of file_names[i] and whether reading it succeeded. Buffers are pushed
+// into the arena in the order the files are read, and memory pushed for files that fail while being read is not given
+// back. Returns true if every file was read.
+#define READ_FILES_IN_FLIGHT 64
+#define READ_FILES_MAX_THREADS 16
+
+#define READ_FILES_NO_IO_URING (1 << 0)
+
+bool read_entire_files(Arena *arena, const String *file_names, u64 count, u32 flags, Buffer *out_files, bool *out_ok);
+
+// Read a big file with several threads at the same time, which is needed to keep fast SSDs busy. The file is split into
+// ranges of READ_FILE_RANGE_SIZE bytes that the threads read with positioned reads into a single buffer pushed into the
+// arena. Files that fit in one range are read by the calling thread alone, and so are pipes and files that don't report
+// their size, like the ones in /proc, which are read until the end.
+//
+// With READ_FILE_DIRECT the page cache is bypassed (O_DIRECT in Linux and FILE_FLAG_NO_BUFFERING in Windows): the buffer
+// is aligned to the page size and the reads are whole pages. It avoids a copy and doesn't evict other files from the
+// cache, but every read goes to the disk, even if the file was cached. If the file system doesn't support it, the file is
+// read normally. Return value indicates success.
+#define READ_FILE_RANGE_SIZE    (8*MiB)
+#define READ_FILE_MAX_THREADS   8
+
+#define READ_FILE_DIRECT (1 << 0)
+
+bool read_entire_file_parallel(Arena *arena, String file_name, u32 flags, Buffer *out_file_buffer);
+
+// Write data into a file, replacing it if it exists. The data is written into a new temporary file next to file_name that
+// is renamed over it at the end, so readers see either the old contents or the new ones, never half a file. A crash may
+// leave the temporary file behind with the name "<file_name>.<process id>.<counter>.tmp". A replaced file keeps its
+// permissions, and new files get 0666 minus the umask.
+//
+// In Linux, if file_name is a symbolic link, the file it points to is replaced and the link is kept. Links that point to
+// a file that doesn't exist are replaced by a regular file. In Windows the link itself is always replaced.
+//
+// Without WRITE_FILE_SYNC the contents may be lost if the machine crashes before the OS writes them to the disk. With it
+// the data is flushed (fdatasync in Linux) before the rename and the rename is flushed (fsync of the directory) before
+// returning. Return value indicates success.
+#define WRITE_FILE_SYNC (1 << 0)
+
+bool write_entire_file(String file_name, Buffer data, u32 flags);
+// Same as write_entire_file(), but the file is the concatenation of count buffers. They are written with gathered writes
+// (writev in Linux), so there's no need to copy them into a single buffer first.
+bool write_entire_file_gather(String file_name, const Buffer *buffers, u64 count, u32 flags);
+
+// Write many files durably with a single flush to the disk instead of one per file (group commit). The files are written
+// into temporary files as they are added, but nothing replaces the target files until write_batch_commit(), which:
+//  1. Flushes the data of every temporary file at once, with one syncfs() per file system in Linux.
+//  2. Renames the temporary files over their target files, in the order they were added.
+//  3. Flushes the renames, again with one syncfs() per file system.
+// syncfs() flushes every dirty file of the file system, not only the ones in the batch, so it's not a good fit if other
+// processes write a lot to the same disk. In Windows each file is flushed on its own.
+//
+// The bookkeeping is pushed into the arena, which must outlive the batch.
+//
+//     WriteBatch batch = write_batch_begin(&arena);
+//     write_batch_add(&batch, S("a.bin"), &a, 1);
+//     write_batch_add(&batch, S("b.bin"), &b, 1);
+//     bool ok = write_batch_commit(&batch);
+typedef struct WriteBatchFile WriteBatchFile;
+
+typedef struct {
+    Arena *_arena;
+    WriteBatchFile *_first;
+    WriteBatchFile *_last;
+} WriteBatch;
+
+WriteBatch write_batch_begin(Arena *arena);
+// Write the buffers into the temporary file of file_name. If it fails the file is not part of the batch.
+bool write_batch_add(WriteBatch *batch, String file_name, const Buffer *buffers, u64 count);
+// Returns true if every file added to the batch replaced its target and the batch is durable. The batch can't be used
+// again.
+bool write_batch_commit(WriteBatch *batch);
+// Delete the temporary files without replacing any target file
+void write_batch_cancel(WriteBatch *batch);
+
+// ####################################################################################################################
+// File cache
+//
+// Cache of the contents of files that are read again and again, like templates and configuration files. Every read
+// checks the modification time, size and inode of the file with a single stat() and returns the cached contents if they
+// didn't change, without copying them. Otherwise the file is read again.
+//
+// The contents of a file, its path and its bookkeeping live in one block of a Heap. When the cached files take more
+// than the budget, the least recently used ones are evicted. Files bigger than the whole budget are never cached: they
+// are mapped with map_entire_file() every time they are read, and unmapped when their buffer is released. Buffers
+// returned by file_cache_read() stay valid until they are given back with file_cache_release(), even if their file is
+// evicted or changes in the meantime, so the memory in use may go over the budget while many buffers are held.
+//
+// Only regular files are cached. File systems with coarse timestamps may miss a change that keeps the size of a file
+// and happens within the same tick as the previous one, unless the file is replaced with a rename. It's not thread safe.
+//
+//     FileCache cache = file_cache_alloc(64*MiB);
+//     Buffer page = {};
+//     if (file_cache_read(&cache, S("templates/index.html"), &page)) {
+//         ...
+//         file_cache_release(&cache, page);
+//     }
+#define FILE_CACHE_CAPACITY ((u64)64*GiB)   // Reserved memory for the contents, including buffers held over the budget
+
+typedef struct FileCacheEntry FileCacheEntry;
+typedef struct FileCacheMapping FileCacheMapping;
+
+typedef struct {
+    u64 hits;
+    u64 misses;             // Reads of files that weren't cached or had changed
+    u64 invalidations;      // Entries dropped because their file changed or disappeared
+    u64 evictions;          // Entries dropped to stay within the budget
+    u64 entry_count;
+    u64 used_size;          // Bytes of the cached entries, including their paths and bookkeeping
+} FileCacheStats;
+
+typedef struct {
+    Heap _heap;
+    Arena *_map_arena;              // Pushed into the heap, so the map still points to it after the cache is copied
+    StringMap<FileCacheEntry*> _map;
+    FileCacheEntry *_lru_first;     // Most recently used entry
+    FileCacheEntry *_lru_last;
+    FileCacheMapping *_mappings;    // Files over the budget whose buffers haven't been released
+    u64 _budget;
+    FileCacheStats _stats;
+} FileCache;
+
+FileCache file_cache_alloc(u64 budget);
+// Every buffer must have been released
+void      file_cache_free(FileCache *cache);
+
+// Return the contents of the file from the cache, reading it first if it's not cached or it changed. The buffer must be
+// given back with file_cache_release(). Return value indicates success.
+bool file_cache_read(FileCache *cache, String file_name, Buffer *out_contents);
+void file_cache_release(FileCache *cache, Buffer contents);
+
+FileCacheStats file_cache_get_stats(FileCache *cache);
+
+// ####################################################################################################################
+// Arena snapshots
+//
+// Save the used memory of an arena into a file and load it back later, at any address, with a single mmap in Linux. It's
+// meant for data that is expensive to build but never changes, like parsed configuration or lookup tables. The loaded
+// arena is a regular arena: it can keep pushing data after the snapshot.
+//
+// Pointers are only valid at the address where they were created, so the structures in a snapshot must link to each
+// other with RelPtr. The first element pushed into the arena before saving it is at arena_snapshot_get_root() after
+// loading it.
+//
+// The file is the snapshot data followed by a footer with a magic number, the version of the data, its size and its
+// checksum. Placing the validation data at the end keeps the snapshot data at file offset 0, which is page-aligned and
+// can be mapped directly.
+
+// Pointer stored as the distance between the pointer and the target, so it remains valid when the memory that contains
+// both is mapped somewhere else. An offset of 0 is the null pointer.
+template <typename T>
+struct RelPtr {
+    i64 _offset;
+};
+
+template <typename T>
+void rel_ptr_set(RelPtr<T> *ptr, T *target) {
+    ptr->_offset = target != 0 ? (i64)((u8*)target - (u8*)ptr) : 0;
+}
+
+template <typename T>
+T *rel_ptr_get(const RelPtr<T> *ptr) {
+    T *target = ptr->_offset != 0 ? (T*)((u8*)ptr + ptr->_offset) : 0;
+    return target;
+}
+
+// Save the memory used by the arena. Growable arenas that have chained more than one block are not supported. The version
+// is chosen by the caller and arena_snapshot_load() fails if it doesn't match, so bump it when the data layout changes.
+bool  arena_snapshot_save(Arena *arena, String file_name, u32 version);
+
+// Load a snapshot into a new arena with room for `capacity` bytes, which must be enough for the snapshot. It returns
+// false if the file can't be read or the footer doesn't match the file. Verifying the checksum reads the whole
+// snapshot, so skip it to load the pages lazily when the file is trusted.
+bool  arena_snapshot_load(Arena *out_arena, String file_name, u32 version, u64 capacity, bool verify_checksum);
+void *arena_snapshot_get_root(Arena *arena);
+
+// ####################################################################################################################
+// Atomics
+//
+// Read-modify-write operations are sequentially consistent. Loads have acquire semantics and stores have release
+// semantics. Every function that returns a value returns the value stored before the operation. atomic_fence() is a full
+// memory barrier. atomic_pause() is a hint for the CPU inside spin loops.
+#if defined(_MSC_VER) && !defined(__clang__)
+static inline u32  atomic_load_u32(volatile u32 *p)                                { u32 v = *p; _ReadWriteBarrier(); return v; }
+static inline u64  atomic_load_u64(volatile u64 *p)                                { u64 v = *p; _ReadWriteBarrier(); return v; }
+static inline void atomic_store_u32(volatile u32 *p, u32 v)                        { _ReadWriteBarrier(); *p = v; }
+static inline void atomic_store_u64(volatile u64 *p, u64 v)                        { _ReadWriteBarrier(); *p = v; }
+static inline u32  atomic_fetch_add_u32(volatile u32 *p, u32 v)                    { return (u32)_InterlockedExchangeAdd((volatile long*)p, (long)v); }
+static inline u64  atomic_fetch_add_u64(volatile u64 *p, u64 v)                    { return (u64)_InterlockedExchangeAdd64((volatile __int64*)p, (__int64)v); }
+static inline u32  atomic_exchange_u32(volatile u32 *p, u32 v)                     { return (u32)_InterlockedExchange((volatile long*)p, (long)v); }
+static inline u64  atomic_exchange_u64(volatile u64 *p, u64 v)                     { return (u64)_InterlockedExchange64((volatile __int64*)p, (__int64)v); }
+static inline void atomic_pause()                                                  { _mm_pause(); }
+static inline void atomic_fence()                                                  { _mm_mfence(); }
+
+static inline u32 atomic_compare_exchange_u32(volatile u32 *p, u32 expected, u32 desired) {
+    return (u32)_InterlockedCompareExchange((volatile long*)p, (long)desired, (long)expected);
+}
+
+static inline u64 atomic_compare_exchange_u64(volatile u64 *p, u64 expected, u64 desired) {
+    return (u64)_InterlockedCompareExchange64((volatile __int64*)p, (__int64)desired, (__int64)expected);
+}
+#else
+static inline u32  atomic_load_u32(volatile u32 *p)                                { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+static inline u64  atomic_load_u64(volatile u64 *p)                                { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+static inline void atomic_store_u32(volatile u32 *p, u32 v)                        { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+static inline void atomic_store_u64(volatile u64 *p, u64 v)                        { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+static inline u32  atomic_fetch_add_u32(volatile u32 *p, u32 v)                    { return __atomic_fetch_add(p, v, __ATOMIC_SEQ_CST); }
+static inline u64  atomic_fetch_add_u64(volatile u64 *p, u64 v)                    { return __atomic_fetch_add(p, v, __ATOMIC_SEQ_CST); }
+static inline u32  atomic_exchange_u32(volatile u32 *p, u32 v)                     { return __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST); }
+static inline u64  atomic_exchange_u64(volatile u64 *p, u64 v)                     { return __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST); }
+static inline void atomic_fence()                                                  { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+#if defined(__x86_64__) || defined(__i386__)
+static inline void atomic_pause()                                                  { __builtin_ia32_pause(); }
+#else
+static inline void atomic_pause()                                                  {}
+#endif
+
+static inline u32 atomic_compare_exchange_u32(volatile u32 *p, u32 expected, u32 desired) {
+    __atomic_compare_exchange_n(p, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return expected;
+}
+
+static inline u64 atomic_compare_exchange_u64(volatile u64 *p, u64 expected, u64 desired) {
+    __atomic_compare_exchange_n(p, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return expected;
+}
+#endif
+
+// ####################################################################################################################
+// Threads and synchronization
+
+typedef void (*ThreadFunction)(void *arg);
+
+typedef struct {
+    u64 _handle;
+} Thread;
+
+// Start a new thread that runs func(arg). Every thread must be joined with thread_join().
+Thread thread_create(ThreadFunction func, void *arg);
+void   thread_join(Thread thread);
+
+// Number of logical processors available to this process
+u32 get_cpu_count();
+
+// Give the rest of the time slice of this thread to other threads that are ready to run
+void thread_yield();
+
+// Block the thread while *address == expected. It can return spuriously, so always check the condition again in a loop.
+void futex_wait(volatile u32 *address, u32 expected);
+void futex_wake_one(volatile u32 *address);
+void futex_wake_all(volatile u32 *address);
+
+// Mutex built on top of futexes. A zero-initialized Mutex is unlocked and it doesn't need to be destroyed.
+typedef struct {
+    volatile u32 _state;
+} Mutex;
+
+void mutex_lock(Mutex *mutex);
+void mutex_unlock(Mutex *mutex);
+
+// Event count: lets threads sleep until a condition that other threads change without locks becomes true. The waiter
+// announces itself before checking the condition one last time, so a notification can't be lost in between:
+//
+//     while (!condition()) {
+//         u32 epoch = event_count_prepare_wait(&event);
+//         if (condition()) {
+//             break;
+//         }
+//         event_count_wait(&event, epoch);
+//     }
+//
+// The notifier changes the condition first and then calls event_count_notify(), which wakes up every waiting thread. It
+// only makes a syscall if some thread announced itself since the previous notification. A zero-initialized EventCount is
+// valid.
+typedef struct {
+    volatile u32 _state;    // Bit 0 is set if some thread may be waiting. The rest is the number of notifications.
+} EventCount;
+
+u32  event_count_prepare_wait(EventCount *event);
+void event_count_wait(EventCount *event, u32 epoch);
+void event_count_notify(EventCount *event);
+
+// ####################################################################################################################
+// Streaming file reader
+//
+// Reader for files of any size, including the ones bigger than RAM. It returns the file in chunks of a fixed size from
+// two buffers pushed into an arena: a background thread reads the next chunk while the caller parses the current one.
+//
+// Records can span chunks. The caller tells how many bytes at the end of the chunk it didn't consume, and they are copied
+// in front of the next chunk, so a record always lives in contiguous memory. Records must not be longer than a chunk.
+//
+//     FileStream stream;
+//     file_stream_open(&arena, S("server.log"), 0, &stream);
+//     Buffer chunk = {};
+//     u64 unconsumed = 0;
+//     while (file_stream_next(&stream, unconsumed, &chunk)) {
+//         u64 consumed = parse_complete_lines(chunk);
+//         unconsumed = chunk.length - consumed;
+//     }
+//     // Now chunk holds the bytes that were never consumed, like a last line without a line break
+//     bool ok = file_stream_close(&stream);
+#define FILE_STREAM_BUFFER_COUNT 2
+#define FILE_STREAM_CHUNK_SIZE (4*MiB)      // Default chunk size
+
+typedef struct {
+    // Every buffer has room for chunk_size bytes carried over from the previous chunk followed by chunk_size bytes read
+    // from the file
+    u8 *_buffers[FILE_STREAM_BUFFER_COUNT];
+    volatile u64 _lengths[FILE_STREAM_BUFFER_COUNT];
+    u64 _chunk_size;
+    u64 _handle;
+    Thread _reader;
+
+    // Only used by the caller
+    u32 _next_chunk;
+    Buffer _current;
+
+    alignas(64) volatile u32 _filled;       // Chunks read by the background thread
+    alignas(64) volatile u32 _released;     // Chunks the caller is done with
+    volatile u32 _stop;
+    volatile u32 _failed;
+} FileStream;
+
+// Open the file and start reading it in the background. A chunk_size of 0 uses FILE_STREAM_CHUNK_SIZE. The stream is
+// used by address, so it must not be copied. Return value indicates success.
+bool file_stream_open(Arena *arena, String file_name, u64 chunk_size, FileStream *out_stream);
+// Get the next chunk, with the last `unconsumed` bytes of the previous chunk in front of it. It returns false at the end
+// of the file, or if reading the file failed, and then out_chunk holds only the unconsumed bytes.
+bool file_stream_next(FileStream *stream, u64 unconsumed, Buffer *out_chunk);
+// Stop reading and close the file. It can be called before reaching the end. Returns false if reading the file failed.
+bool file_stream_close(FileStream *stream);
+
+// ####################################################################################################################
+// String interning
+//
+// Deduplicates strings and gives each distinct string a 32-bit atom, so comparing or hashing interned strings is an
+// integer operation. Atoms start at 1; the atom 0 means "no string".
+//
+// Lookups are lock-free and can run concurrently from any number of threads. Inserting a new string takes a mutex. The
+// interned strings are copied, so the original memory can be released right after interning it.
+#define INTERNER_MAX_ATOMS          (1 << 24)
+#define INTERNER_STRINGS_CAPACITY   ((u64)4*GiB)
+
+typedef u32 Atom;
+
+typedef struct InternerTable InternerTable;
+
+typedef struct {
+    Arena _strings;             // Bytes of every string
+    Arena _atoms;               // String of every atom, indexed by atom - 1. It never moves.
+    Arena _tables;              // Hash tables. Old tables are kept because other threads may still be reading them.
+    InternerTable *volatile _table;
+    volatile u32 _count;
+    Mutex _mutex;
+} Interner;
+
+Interner interner_alloc();
+void     interner_free(Interner *interner);
+
+// Return the atom of the string, interning it if it's new
+Atom     interner_intern(Interner *interner, String str);
+
+// Return the atom of the string, or 0 if it hasn't been interned. It never takes the mutex.
+Atom     interner_find(Interner *interner, String str);
+
+// The returned String is valid until the interner is freed
+String   interner_get_string(Interner *interner, Atom atom);
+u32      interner_get_count(Interner *interner);
+
+// ####################################################################################################################
+// Mirrored ring buffer
+//
+// Ring buffer of bytes whose memory is mapped twice, one copy right after the other. Writing past the end of the first
+// mapping writes to the beginning of the buffer, so the free space and the unread data can always be returned as a single
+// contiguous Buffer, even when they wrap around. It's safe to use from one producer thread and one consumer thread at the
+// same time. In Windows it needs Windows 10 version 1803 or later, which added VirtualAlloc2() and MapViewOfFile3().
+//
+//     // Producer
+//     Buffer free_space = ring_buffer_write_begin(&ring);
+//     u64 count = produce(free_space.data, free_space.length);
+//     ring_buffer_write_end(&ring, count);
+//
+//     // Consumer
+//     Buffer data = ring_buffer_read_begin(&ring);
+//     u64 count = consume(data.data, data.length);
+//     ring_buffer_read_end(&ring, count);
+typedef struct {
+    u8 *_memory;
+    u64 _capacity;                      // Multiple of the page size, or of the allocation granularity in Windows
+    alignas(64) volatile u64 _write_pos; // Total bytes written. Only the producer changes it.
+    alignas(64) volatile u64 _read_pos;  // Total bytes read. Only the consumer changes it.
+} RingBuffer;
+
+RingBuffer ring_buffer_alloc(u64 capacity_hint);
+void       ring_buffer_free(RingBuffer *ring);
+
+// Free space after the unread data. Its length is 0 if the ring buffer is full.
+Buffer     ring_buffer_write_begin(RingBuffer *ring);
+// Publish the first count bytes written into the Buffer returned by ring_buffer_write_begin()
+void       ring_buffer_write_end(RingBuffer *ring, u64 count);
+
+// Data that hasn't been read yet. Its length is 0 if the ring buffer is empty.
+Buffer     ring_buffer_read_begin(RingBuffer *ring);
+// Release the first count bytes of the Buffer returned by ring_buffer_read_begin()
+void       ring_buffer_read_end(RingBuffer *ring, u64 count);
+
+// ####################################################################################################################
+// Lock-free queues
+//
+// Bounded queues of trivially copyable elements whose memory is pushed into an arena. Their capacity is rounded up to a
+// power of two. The variables written by producers and the ones written by consumers live in different cache lines.
+//  - SpscQueue: one producer thread and one consumer thread. Each side keeps a copy of the position of the other side
+//    and only reads the shared one when its copy says the queue is full or empty.
+//  - MpmcQueue: any number of producers and consumers. It's Dmitry Vyukov's bounded queue: every cell has a sequence
+//    number that tells whether it's ready to be written or read in the current lap, so threads only contend on a CAS
+//    of the position they are moving.
+//
+// push and pop never block: they return false when the queue is full or empty. Queues made with QUEUE_FLAG_BLOCKING
+// also support push_wait and pop_wait, which spin for a while and then sleep on a futex. Every push and pop of a blocking
+// queue costs one more atomic read-modify-write to find out if it has to wake up a sleeping thread.
+//
+//     SpscQueue<Job*> jobs = spsc_queue_make(&arena, Job*, 1024, QUEUE_FLAG_BLOCKING);
+//     spsc_queue_push_wait(&jobs, job);       // Producer
+//     Job *job = spsc_queue_pop_wait(&jobs);  // Consumer
+//
+// The queues are shared by address, so don't copy them once other threads are using them.
+#define QUEUE_FLAG_BLOCKING (1 << 0)
+
+// Number of failed attempts of push_wait and pop_wait before they sleep
+#define QUEUE_SPIN_COUNT 64
+
+static inline u64 queue_round_capacity(u64 capacity) {
+    u64 result = capacity <= 2 ? 2 : (u64)1 << (bit_scan_reverse_u64(capacity - 1) + 1);
+    return result;
+}
+
+// ====================================================================================================================
+// Single-producer single-consumer queue
+template <typename T>
+struct SpscQueue {
+    static_assert(std::is_trivially_copyable<T>::value, "SpscQueue only supports trivially copyable types");
+
+    T *_items;
+    u64 _mask;
+    u32 _flags;
+
+    // Producer side
+    alignas(64) volatile u64 _write_pos;    // Total elements pushed
+    u64 _cached_read_pos;                   // Last _read_pos seen by the producer
+    EventCount _not_empty;                  // Consumers sleep here
+
+    // Consumer side
+    alignas(64) volatile u64 _read_pos;     // Total elements popped
+    u64 _cached_write_pos;                  // Last _write_pos seen by the consumer
+    EventCount _not_full;                   // Producers sleep here
+};
+
+#define spsc_queue_make(arena, type, capacity, flags) spsc_queue_make_impl<type>(arena, capacity, flags)
+
+template <typename T>
+SpscQueue<T> spsc_queue_make_impl(Arena *arena, u64 capacity, u32 flags) {
+    u64 rounded_capacity = queue_round_capacity(capacity);
+    SpscQueue<T> queue = {};
+    queue._items = arena_push_nozero(arena, T, rounded_capacity);
+    queue._mask = rounded_capacity - 1;
+    queue._flags = flags;
+    return queue;
+}
+
+template <typename T>
+bool spsc_queue_push(SpscQueue<T> *queue, typename NoDeduce<T>::Type value) {
+    u64 pos = queue->_write_pos;
+    if (pos - queue->_cached_read_pos > queue->_mask) {
+        queue->_cached_read_pos = atomic_load_u64(&queue->_read_pos);
+        if (pos - queue->_cached_read_pos > queue->_mask) {
+            return false;
+        }
+    }
+
+    queue->_items[pos & queue->_mask] = value;
+    atomic_store_u64(&queue->_write_pos, pos + 1);
+    if (queue->_flags & QUEUE_FLAG_BLOCKING) {
+        event_count_notify(&queue->_not_empty);
+    }
+    return true;
+}
+
+template <typename T>
+bool spsc_queue_pop(SpscQueue<T> *queue, T *out_value) {
+    u64 pos = queue->_read_pos;
+    if (pos == queue->_cached_write_pos) {
+        queue->_cached_write_pos = atomic_load_u64(&queue->_write_pos);
+        if (pos == queue->_cached_write_pos) {
+            return false;
+        }
+    }
+
+    *out_value = queue->_items[pos & queue->_mask];
+    atomic_store_u64(&queue->_read_pos, pos + 1);
+    if (queue->_flags & QUEUE_FLAG_BLOCKING) {
+        event_count_notify(&queue->_not_full);
+    }
+    return true;
+}
+
+// Push the element, waiting while the queue is full. It requires QUEUE_FLAG_BLOCKING.
+template <typename T>
+void spsc_queue_push_wait(SpscQueue<T> *queue, typename NoDeduce<T>::Type value) {
+    assert(queue->_flags & QUEUE_FLAG_BLOCKING);
+    for (u32 spins = 0; !spsc_queue_push(queue, value); spins++) {
+        if (spins < QUEUE_SPIN_COUNT) {
+            atomic_pause();
+            continue;
+        }
+
+        u32 epoch = event_count_prepare_wait(&queue->_not_full);
+        if (spsc_queue_push(queue, value)) {
+            break;
+        }
+        event_count_wait(&queue->_not_full, epoch);
+    }
+}
+
+// Pop an element, waiting while the queue is empty. It requires QUEUE_FLAG_BLOCKING.
+template <typename T>
+T spsc_queue_pop_wait(SpscQueue<T> *queue) {
+    assert(queue->_flags & QUEUE_FLAG_BLOCKING);
+    T value;
+    for (u32 spins = 0; !spsc_queue_pop(queue, &value); spins++) {
+        if (spins < QUEUE_SPIN_COUNT) {
+            atomic_pause();
+            continue;
+        }
+
+        u32 epoch = event_count_prepare_wait(&queue->_not_empty);
+        if (spsc_queue_pop(queue, &value)) {
+            break;
+        }
+        event_count_wait(&queue->_not_empty, epoch);
+    }
+    return value;
+}
+
+// ====================================================================================================================
+// Multi-producer multi-consumer queue
+template <typename T>
+struct MpmcQueueCell {
+    // The cell of position pos can be written when sequence == pos and read when sequence == pos + 1. Reading it sets
+    // sequence to pos + capacity, the position that writes the cell in the next lap.
+    volatile u64 sequence;
+    T value;
+};
+
+template <typename T>
+struct MpmcQueue {
+    static_assert(std::is_trivially_copyable<T>::value, "MpmcQueue only supports trivially copyable types");
+
+    MpmcQueueCell<T> *_cells;
+    u64 _mask;
+    u32 _flags;
+
+    // Producer side
+    alignas(64) volatile u64 _write_pos;
+    EventCount _not_empty;
+
+    // Consumer side
+    alignas(64) volatile u64 _read_pos;
+    EventCount _not_full;
+};
+
+#define mpmc_queue_make(arena, type, capacity, flags) mpmc_queue_make_impl<type>(arena, capacity, flags)
+
+template <typename T>
+MpmcQueue<T> mpmc_queue_make_impl(Arena *arena, u64 capacity, u32 flags) {
+    u64 rounded_capacity = queue_round_capacity(capacity);
+    MpmcQueue<T> queue = {};
+    queue._cells = arena_push_nozero(arena, MpmcQueueCell<T>, rounded_capacity);
+    for (u64 i = 0; i < rounded_capacity; i++) {
+        queue._cells[i].sequence = i;
+    }
+    queue._mask = rounded_capacity - 1;
+    queue._flags = flags;
+    return queue;
+}
+
+template <typename T>
+bool mpmc_queue_push(MpmcQueue<T> *queue, typename NoDeduce<T>::Type value) {
+    MpmcQueueCell<T> *cell;
+    u64 pos = atomic_load_u64(&queue->_write_pos);
+    for (;;) {
+        cell = &queue->_cells[pos & queue->_mask];
+        i64 diff = (i64)(atomic_load_u64(&cell->sequence) - pos);
+        if (diff == 0) {
+            // The cell is free in this lap. Claim it unless another producer did it first.
+            u64 prev_pos = atomic_compare_exchange_u64(&queue->_write_pos, pos, pos + 1);
+            if (prev_pos == pos) {
+                break;
+            }
+            pos = prev_pos;
+        } else if (diff < 0) {
+            // The cell still holds the element of the previous lap
+            return false;
+        } else {
+            // Another producer already wrote this cell
+            pos = atomic_load_u64(&queue->_write_pos);
+        }
+    }
+
+    cell->value = value;
+    atomic_store_u64(&cell->sequence, pos + 1);
+    if (queue->_flags & QUEUE_FLAG_BLOCKING) {
+        event_count_notify(&queue->_not_empty);
+    }
+    return true;
+}
+
+template <typename T>
+bool mpmc_queue_pop(MpmcQueue<T> *queue, T *out_value) {
+    MpmcQueueCell<T> *cell;
+    u64 pos = atomic_load_u64(&queue->_read_pos);
+    for (;;) {
+        cell = &queue->_cells[pos & queue->_mask];
+        i64 diff = (i64)(atomic_load_u64(&cell->sequence) - (pos + 1));
+        if (diff == 0) {
+            u64 prev_pos = atomic_compare_exchange_u64(&queue->_read_pos, pos, pos + 1);
+            if (prev_pos == pos) {
+                break;
+            }
+            pos = prev_pos;
+        } else if (diff < 0) {
+            // Nothing has been written into the cell in this lap
+            return false;
+        } else {
+            // Another consumer already read this cell
+            pos = atomic_load_u64(&queue->_read_pos);
+        }
+    }
+
+    *out_value = cell->value;
+    atomic_store_u64(&cell->sequence, pos + queue->_mask + 1);
+    if (queue->_flags & QUEUE_FLAG_BLOCKING) {
+        event_count_notify(&queue->_not_full);
+    }
+    return true;
+}
+
+// Push the element, waiting while the queue is full. It requires QUEUE_FLAG_BLOCKING.
+template <typename T>
+void mpmc_queue_push_wait(MpmcQueue<T> *queue, typename NoDeduce<T>::Type value) {
+    assert(queue->_flags & QUEUE_FLAG_BLOCKING);
+    for (u32 spins = 0; !mpmc_queue_push(queue, value); spins++) {
+        if (spins < QUEUE_SPIN_COUNT) {
+            atomic_pause();
+            continue;
+        }
+
+        u32 epoch = event_count_prepare_wait(&queue->_not_full);
+        if (mpmc_queue_push(queue, value)) {
+            break;
+        }
+        event_count_wait(&queue->_not_full, epoch);
+    }
+}
+
+// Pop an element, waiting while the queue is empty. It requires QUEUE_FLAG_BLOCKING.
+template <typename T>
+T mpmc_queue_pop_wait(MpmcQueue<T> *queue) {
+    assert(queue->_flags & QUEUE_FLAG_BLOCKING);
+    T value;
+    for (u32 spins = 0; !mpmc_queue_pop(queue, &value); spins++) {
+        if (spins < QUEUE_SPIN_COUNT) {
+            atomic_pause();
+            continue;
+        }
+
+        u32 epoch = event_count_prepare_wait(&queue->_not_empty);
+        if (mpmc_queue_pop(queue, &value)) {
+            break;
+        }
+        event_count_wait(&queue->_not_empty, epoch);
+    }
+    return value;
+}
+
+// ####################################################################################################################
+// Job system
+//
+// Thread pool that runs jobs with work stealing. Every worker has a Chase-Lev deque: it pushes and pops jobs at the
+// bottom of its own deque and idle workers steal from the top of the others, so the jobs that a job spawns usually run on
+// the same core. Workers that don't find anything to steal spin for a while and then sleep until there's work again.
+//
+// The thread that calls job_system_alloc() is the first worker. Jobs can only be started from it and from inside other
+// jobs, and it only runs jobs while it waits for a group. job_system_free() must be called from that same thread.
+//
+// Every worker owns an arena for temporary allocations. Jobs receive it as a parameter, and its position is restored
+// with arena_set_pos() when the job returns, so everything the job pushed is released at once. Results that must
+// outlive the job go to memory owned by whoever waits for its group.
+//
+//     JobGroup group = {};
+//     job_run(jobs, &group, compress_file, &files[0]);
+//     job_run(jobs, &group, compress_file, &files[1]);
+//     job_group_wait(jobs, &group);
+//
+//     parallel_for(jobs, pixel_count, 4096, shade_pixels, &image);
+#define JOB_DEQUE_CAPACITY  4096                // Jobs that don't fit in the deque of the worker run right away
+#define JOB_ARENA_CAPACITY  ((u64)64*GiB)       // Reserved memory of the arena of every worker
+#define JOB_SPIN_COUNT      256                 // Failed attempts to find a job before a thread sleeps
+
+typedef void (*JobFunction)(void *arg, Arena *arena);
+typedef void (*ParallelForFunction)(void *arg, u64 begin, u64 end, Arena *arena);
+
+typedef struct JobSystem JobSystem;
+
+// Set of jobs that can be waited for. A zero-initialized JobGroup is empty. It must not be released while it has jobs.
+typedef struct {
+    volatile u64 _pending;
+} JobGroup;
+
+// Start worker_count - 1 threads. If worker_count is 0 it uses one worker per logical processor.
+JobSystem *job_system_alloc(u32 worker_count);
+void       job_system_free(JobSystem *system);
+u32        job_system_get_worker_count(JobSystem *system);
+
+// Add func(arg, arena) to the group and queue it to run in any worker
+void job_run(JobSystem *system, JobGroup *group, JobFunction func, void *arg);
+
+// Run jobs until every job of the group has finished
+void job_group_wait(JobSystem *system, JobGroup *group);
+
+// Call func(arg, begin, end, arena) over ranges that cover [0, count) and wait for all of them. Ranges are split in halves
+// until they have at most grain_size indices, and idle workers steal the halves. A grain_size of 0 picks one that gives
+// every worker a few ranges.
+void parallel_for(JobSystem *system, u64 count, u64 grain_size, ParallelForFunction func, void *arg);
+
+// ####################################################################################################################
+// Directory walker
+//
+// List every file under a directory tree. In Linux directories are read with getdents64() into big buffers and opened
+// relative to the file descriptor of their parent with openat(), so the kernel never resolves a full path again. With a
+// job system every subdirectory is a job, so idle workers steal whole subtrees from the busy ones.
+//
+// Paths start with the root as it was passed, use '/' as separator and are null-terminated, so (const char*)path.data can
+// be given to functions that take C-strings. The order of the entries is unspecified. Symbolic links are listed but not
+// followed.
+//
+//     DirectoryListing listing = {};
+//     walk_directory(&arena, jobs, S("assets"), 0, &listing);
+//     for (u64 i = 0; i < listing.count; i++) {
+//         if (listing.entries[i].type == DIRECTORY_ENTRY_FILE) ...
+//     }
+#define WALK_DIRECTORY_BUFFER_SIZE  (256*KiB)       // Bytes read with each getdents64() call
+#define WALK_DIRECTORY_CAPACITY     ((u64)64*GiB)   // Reserved memory for the paths while walking
+
+// Also get the size of every file. It's free in Windows, but in Linux it needs an fstatat() per entry.
+#define WALK_DIRECTORY_SIZES (1 << 0)
+
+typedef enum {
+    DIRECTORY_ENTRY_UNKNOWN,    // The entry disappeared before its type could be found
+    DIRECTORY_ENTRY_FILE,
+    DIRECTORY_ENTRY_DIRECTORY,
+    DIRECTORY_ENTRY_SYMLINK,
+    DIRECTORY_ENTRY_OTHER,      // Devices, pipes and sockets
+} DirectoryEntryType;
+
+typedef struct {
+    String path;
+    u64 size;                   // Size of regular files with WALK_DIRECTORY_SIZES, otherwise 0
+    DirectoryEntryType type;
+} DirectoryEntry;
+
+typedef struct {
+    DirectoryEntry *entries;
+    u64 count;
+    u64 error_count;            // Subdirectories that couldn't be read. Their entries are missing.
+} DirectoryListing;
+
+// The entries and their paths are pushed into the arena. jobs can be 0 to walk the tree in the calling thread, and
+// otherwise it must be called from a thread that can start jobs. Returns false if the root can't be read.
+bool walk_directory(Arena *arena, JobSystem *jobs, String root, u32 flags, DirectoryListing *out_listing);
@@ -0,0 +1,1179 @@
+#include <stdio.h>
+#include <string.h>
+#include <filesystem>
+
+#ifdef _WIN32
+#   include <direct.h>
+#elif __linux__
+#   include <fcntl.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+#include "basic.h"
+#include "bench_suite.cpp"
+
+// Benchmarks of the utilities of basic.h that aren't allocators. The allocators are measured in `arena_bench.cpp`.
+
+// ####################################################################################################################
+// String interning
+
+#define INTERNER_IDENTIFIERS 4096
+#define INTERNER_COMPARISONS (50*1000*1000)
+#define INTERNER_LOOKUPS (10*1000*1000)
+
+typedef struct {
+    Interner *interner;
+    String *identifiers;
+    u64 lookups;
+} InternerBenchContext;
+
+static void interner_lookup_thread(void *arg) {
+    InternerBenchContext *context = (InternerBenchContext*)arg;
+    u64 state = (u64)arg;
+    u64 sum = 0;
+    for (u64 i = 0; i < context->lookups; i++) {
+        state = state*6364136223846793005ull + 1442695040888963407ull;
+        sum += interner_intern(context->interner, context->identifiers[(state >> 33) % INTERNER_IDENTIFIERS]);
+    }
+    bench_sink += sum;
+}
+
+static void bench_interner() {
+    Arena arena = arena_alloc(GiB);
+    Interner interner = interner_alloc();
+
+    // Identifiers with a common prefix, like the symbols of a program, so string_equals() has to compare several bytes
+    String *identifiers = arena_push_nozero(&arena, String, INTERNER_IDENTIFIERS);
+    Atom *atoms = arena_push_nozero(&arena, Atom, INTERNER_IDENTIFIERS);
+    for (u64 i = 0; i < INTERNER_IDENTIFIERS; i++) {
+        char *identifier = arena_push_nozero(&arena, char, 64);
+        int length = snprintf(identifier, 64, "module_namespace_symbol_%04llu", (unsigned long long)i);
+        identifiers[i] = (String){ (const u8*)identifier, (u64)length };
+        atoms[i] = interner_intern(&interner, identifiers[i]);
+    }
+
+    // Pairs of identifiers to compare. A quarter of them are equal.
+    u32 *pairs = arena_push_nozero(&arena, u32, 2*INTERNER_COMPARISONS/1000);
+    u64 state = 11;
+    for (u64 i = 0; i < 2*INTERNER_COMPARISONS/1000; i += 2) {
+        state = state*6364136223846793005ull + 1442695040888963407ull;
+        pairs[i] = (u32)((state >> 33) % INTERNER_IDENTIFIERS);
+        pairs[i + 1] = (state >> 20) % 4 == 0 ? pairs[i] : (u32)((state >> 40) % INTERNER_IDENTIFIERS);
+    }
+
+    u64 start = bench_now_ns();
+    u64 equal = 0;
+    for (u64 round = 0; round < 1000; round++) {
+        for (u64 i = 0; i < 2*INTERNER_COMPARISONS/1000; i += 2) {
+            equal += string_equals(identifiers[pairs[i]], identifiers[pairs[i + 1]]);
+        }
+    }
+    bench_sink += equal;
+    bench_print("string_equals", INTERNER_COMPARISONS, bench_now_ns() - start);
+
+    start = bench_now_ns();
+    equal = 0;
+    for (u64 round = 0; round < 1000; round++) {
+        for (u64 i = 0; i < 2*INTERNER_COMPARISONS/1000; i += 2) {
+            equal += atoms[pairs[i]] == atoms[pairs[i + 1]];
+        }
+    }
+    bench_sink += equal;
+    bench_print("Atom ==", INTERNER_COMPARISONS, bench_now_ns() - start);
+
+    u32 max_threads = MIN(get_cpu_count(), 64);
+    for (u32 thread_count = 1; thread_count <= max_threads; thread_count *= 2) {
+        InternerBenchContext contexts[64];
+        Thread threads[64];
+        start = bench_now_ns();
+        for (u32 i = 0; i < thread_count; i++) {
+            contexts[i].interner = &interner;
+            contexts[i].identifiers = identifiers;
+            contexts[i].lookups = INTERNER_LOOKUPS/thread_count;
+            threads[i] = thread_create(interner_lookup_thread, &contexts[i]);
+        }
+        for (u32 i = 0; i < thread_count; i++) {
+            thread_join(threads[i]);
+        }
+        u64 elapsed = bench_now_ns() - start;
+
+        char name[128];
+        snprintf(name, sizeof(name), "interner_intern of an interned string, %u threads", thread_count);
+        bench_print(name, (INTERNER_LOOKUPS/thread_count)*thread_count, elapsed);
+    }
+
+    interner_free(&interner);
+    arena_free(&arena);
+}
+
+// ####################################################################################################################
+// Mirrored ring buffer
+
+#define RING_BENCH_BYTES ((u64)GiB)
+#define RING_BENCH_CAPACITY (256*KiB)
+
+// Ring buffer over regular memory, like the ones that split the copies at the wrap point
+typedef struct {
+    u8 *data;
+    u64 capacity;
+    alignas(64) volatile u64 write_pos;
+    alignas(64) volatile u64 read_pos;
+} SplitRing;
+
+typedef struct {
+    RingBuffer *ring;
+    SplitRing *split_ring;
+    u64 message_size;
+} RingBenchContext;
+
+static u8 ring_bench_message[64*KiB];
+
+// Spin for a while and then let the other thread run, in case both share the same CPU
+static void bench_wait(u32 *spins) {
+    *spins += 1;
+    if (*spins % 64 == 0) {
+        thread_yield();
+    } else {
+        atomic_pause();
+    }
+}
+
+static void ring_bench_mirrored_producer(void *arg) {
+    RingBenchContext *context = (RingBenchContext*)arg;
+    u64 size = context->message_size;
+    for (u64 written = 0; written < RING_BENCH_BYTES; written += size) {
+        Buffer free_space = ring_buffer_write_begin(context->ring);
+        u32 spins = 0;
+        while (free_space.length < size) {
+            bench_wait(&spins);
+            free_space = ring_buffer_write_begin(context->ring);
+        }
+        memcpy(free_space.data, ring_bench_message, size);
+        ring_buffer_write_end(context->ring, size);
+    }
+}
+
+static void ring_bench_split_producer(void *arg) {
+    RingBenchContext *context = (RingBenchContext*)arg;
+    SplitRing *ring = context->split_ring;
+    u64 size = context->message_size;
+    for (u64 written = 0; written < RING_BENCH_BYTES; written += size) {
+        u32 spins = 0;
+        while (ring->capacity - (ring->write_pos - atomic_load_u64(&ring->read_pos)) < size) {
+            bench_wait(&spins);
+        }
+        u64 offset = ring->write_pos % ring->capacity;
+        u64 first = MIN(size, ring->capacity - offset);
+        memcpy(ring->data + offset, ring_bench_message, first);
+        memcpy(ring->data, ring_bench_message + first, size - first);
+        atomic_store_u64(&ring->write_pos, ring->write_pos + size);
+    }
+}
+
+// The consumer needs every message in contiguous memory, like a parser
+static u64 ring_bench_consume(const u8 *message, u64 size) {
+    u64 sum = message[0] + message[size/2] + message[size - 1];
+    return sum;
+}
+
+static void bench_ring_buffer(u64 message_size) {
+    RingBuffer ring = ring_buffer_alloc(RING_BENCH_CAPACITY);
+    RingBenchContext context = { &ring, 0, message_size };
+
+    u64 start = bench_now_ns();
+    Thread producer = thread_create(ring_bench_mirrored_producer, &context);
+    u64 sum = 0;
+    for (u64 read = 0; read < RING_BENCH_BYTES; read += message_size) {
+        Buffer data = ring_buffer_read_begin(&ring);
+        u32 spins = 0;
+        while (data.length < message_size) {
+            bench_wait(&spins);
+            data = ring_buffer_read_begin(&ring);
+        }
+        sum += ring_bench_consume(data.data, message_size);
+        ring_buffer_read_end(&ring, message_size);
+    }
+    thread_join(producer);
+    u64 elapsed = bench_now_ns() - start;
+    bench_sink += sum;
+
+    char name[128];
+    snprintf(name, sizeof(name), "mirrored ring buffer, %llu-byte messages", (unsigned long long)message_size);
+    bench_print_bandwidth(name, RING_BENCH_BYTES, elapsed);
+    ring_buffer_free(&ring);
+
+    Arena arena = arena_alloc(GiB);
+    SplitRing split_ring = {};
+    split_ring.data = arena_push(&arena, u8, RING_BENCH_CAPACITY);
+    split_ring.capacity = RING_BENCH_CAPACITY;
+    u8 *copy = arena_push(&arena, u8, message_size);
+    context.split_ring = &split_ring;
+
+    start = bench_now_ns();
+    producer = thread_create(ring_bench_split_producer, &context);
+    sum = 0;
+    for (u64 read = 0; read < RING_BENCH_BYTES; read += message_size) {
+        u32 spins = 0;
+        while (atomic_load_u64(&split_ring.write_pos) - split_ring.read_pos < message_size) {
+            bench_wait(&spins);
+        }
+
+        // Copy the message when it wraps around
+        u64 offset = split_ring.read_pos % split_ring.capacity;
+        u64 first = MIN(message_size, split_ring.capacity - offset);
+        const u8 *message = split_ring.data + offset;
+        if (first < message_size) {
+            memcpy(copy, split_ring.data + offset, first);
+            memcpy(copy + first, split_ring.data, message_size - first);
+            message = copy;
+        }
+        sum += ring_bench_consume(message, message_size);
+        atomic_store_u64(&split_ring.read_pos, split_ring.read_pos + message_size);
+    }
+    thread_join(producer);
+    elapsed = bench_now_ns() - start;
+    bench_sink += sum;
+
+    snprintf(name, sizeof(name), "split copies at the wrap point, %llu-byte messages", (unsigned long long)message_size);
+    bench_print_bandwidth(name, RING_BENCH_BYTES, elapsed);
+    arena_free(&arena);
+}
+
+// ####################################################################################################################
+// Lock-free queues
+
+#define QUEUE_BENCH_ITEMS (4*1000*1000)
+#define QUEUE_BENCH_CAPACITY 1024
+#define QUEUE_BENCH_ROUND_TRIPS (100*1000)
+#define QUEUE_BENCH_MAX_THREADS 8
+
+// Queue protected by a mutex, where threads sleep while it's full or empty like with a condition variable
+typedef struct {
+    Mutex mutex;
+    u64 *items;
+    u64 mask;
+    u64 write_pos;
+    u64 read_pos;
+    EventCount not_empty;
+    EventCount not_full;
+} MutexQueue;
+
+static MutexQueue mutex_queue_make(Arena *arena, u64 capacity) {
+    MutexQueue queue = {};
+    queue.items = arena_push_nozero(arena, u64, capacity);
+    queue.mask = capacity - 1;
+    return queue;
+}
+
+static bool mutex_queue_try_push(MutexQueue *queue, u64 value) {
+    mutex_lock(&queue->mutex);
+    bool pushed = queue->write_pos - queue->read_pos <= queue->mask;
+    if (pushed) {
+        queue->items[queue->write_pos & queue->mask] = value;
+        queue->write_pos += 1;
+    }
+    mutex_unlock(&queue->mutex);
+    return pushed;
+}
+
+static bool mutex_queue_try_pop(MutexQueue *queue, u64 *out_value) {
+    mutex_lock(&queue->mutex);
+    bool popped = queue->write_pos != queue->read_pos;
+    if (popped) {
+        *out_value = queue->items[queue->read_pos & queue->mask];
+        queue->read_pos += 1;
+    }
+    mutex_unlock(&queue->mutex);
+    return popped;
+}
+
+static void mutex_queue_push(MutexQueue *queue, u64 value) {
+    while (!mutex_queue_try_push(queue, value)) {
+        u32 epoch = event_count_prepare_wait(&queue->not_full);
+        if (mutex_queue_try_push(queue, value)) {
+            break;
+        }
+        event_count_wait(&queue->not_full, epoch);
+    }
+    event_count_notify(&queue->not_empty);
+}
+
+static u64 mutex_queue_pop(MutexQueue *queue) {
+    u64 value;
+    while (!mutex_queue_try_pop(queue, &value)) {
+        u32 epoch = event_count_prepare_wait(&queue->not_empty);
+        if (mutex_queue_try_pop(queue, &value)) {
+            break;
+        }
+        event_count_wait(&queue->not_empty, epoch);
+    }
+    event_count_notify(&queue->not_full);
+    return value;
+}
+
+typedef enum {
+    QUEUE_BENCH_MUTEX,
+    QUEUE_BENCH_SPSC,           // Blocking
+    QUEUE_BENCH_SPSC_SPIN,      // Non-blocking push and pop in a spin loop
+    QUEUE_BENCH_MPMC,           // Blocking
+    QUEUE_BENCH_MPMC_SPIN,      // Non-blocking push and pop in a spin loop
+} QueueBenchKind;
+
+static const char *queue_bench_names[] = {
+    "mutex queue",
+    "SpscQueue, blocking",
+    "SpscQueue, spinning",
+    "MpmcQueue, blocking",
+    "MpmcQueue, spinning",
+};
+
+typedef struct {
+    QueueBenchKind kind;
+    MutexQueue *mutex_queue;
+    SpscQueue<u64> *spsc_queue;
+    MpmcQueue<u64> *mpmc_queue;
+    u64 count;
+} QueueBenchContext;
+
+static void queue_bench_push(QueueBenchContext *context, u64 value) {
+    u32 spins = 0;
+    switch (context->kind) {
+        case QUEUE_BENCH_MUTEX:         mutex_queue_push(context->mutex_queue, value); break;
+        case QUEUE_BENCH_SPSC:          spsc_queue_push_wait(context->spsc_queue, value); break;
+        case QUEUE_BENCH_MPMC:          mpmc_queue_push_wait(context->mpmc_queue, value); break;
+        case QUEUE_BENCH_SPSC_SPIN:     while (!spsc_queue_push(context->spsc_queue, value)) bench_wait(&spins); break;
+        case QUEUE_BENCH_MPMC_SPIN:     while (!mpmc_queue_push(context->mpmc_queue, value)) bench_wait(&spins); break;
+    }
+}
+
+static u64 queue_bench_pop(QueueBenchContext *context) {
+    u64 value = 0;
+    u32 spins = 0;
+    switch (context->kind) {
+        case QUEUE_BENCH_MUTEX:         value = mutex_queue_pop(context->mutex_queue); break;
+        case QUEUE_BENCH_SPSC:          value = spsc_queue_pop_wait(context->spsc_queue); break;
+        case QUEUE_BENCH_MPMC:          value = mpmc_queue_pop_wait(context->mpmc_queue); break;
+        case QUEUE_BENCH_SPSC_SPIN:     while (!spsc_queue_pop(context->spsc_queue, &value)) bench_wait(&spins); break;
+        case QUEUE_BENCH_MPMC_SPIN:     while (!mpmc_queue_pop(context->mpmc_queue, &value)) bench_wait(&spins); break;
+    }
+    return value;
+}
+
+static void queue_bench_producer(void *arg) {
+    QueueBenchContext *context = (QueueBenchContext*)arg;
+    for (u64 i = 0; i < context->count; i++) {
+        queue_bench_push(context, i);
+    }
+}
+
+static void queue_bench_consumer(void *arg) {
+    QueueBenchContext *context = (QueueBenchContext*)arg;
+    u64 sum = 0;
+    for (u64 i = 0; i < context->count; i++) {
+        sum += queue_bench_pop(context);
+    }
+    bench_sink += sum;
+}
+
+// Queues for a benchmark, pushed into the arena so they are aligned to the cache line
+static QueueBenchContext queue_bench_make(Arena *arena, QueueBenchKind kind) {
+    QueueBenchContext context = {};
+    context.kind = kind;
+    if (kind == QUEUE_BENCH_MUTEX) {
+        context.mutex_queue = arena_push(arena, MutexQueue);
+        *context.mutex_queue = mutex_queue_make(arena, QUEUE_BENCH_CAPACITY);
+    } else if (kind == QUEUE_BENCH_SPSC || kind == QUEUE_BENCH_SPSC_SPIN) {
+        u32 flags = kind == QUEUE_BENCH_SPSC ? QUEUE_FLAG_BLOCKING : 0;
+        context.spsc_queue = arena_push(arena, SpscQueue<u64>);
+        *context.spsc_queue = spsc_queue_make(arena, u64, QUEUE_BENCH_CAPACITY, flags);
+    } else {
+        u32 flags = kind == QUEUE_BENCH_MPMC ? QUEUE_FLAG_BLOCKING : 0;
+        context.mpmc_queue = arena_push(arena, MpmcQueue<u64>);
+        *context.mpmc_queue = mpmc_queue_make(arena, u64, QUEUE_BENCH_CAPACITY, flags);
+    }
+    return context;
+}
+
+static void bench_queue_throughput(QueueBenchKind kind, u32 producer_count, u32 consumer_count) {
+    Arena arena = arena_alloc(GiB);
+    QueueBenchContext queue = queue_bench_make(&arena, kind);
+
+    QueueBenchContext contexts[2*QUEUE_BENCH_MAX_THREADS];
+    Thread threads[2*QUEUE_BENCH_MAX_THREADS];
+    u64 start = bench_now_ns();
+    for (u32 i = 0; i < producer_count + consumer_count; i++) {
+        bool is_producer = i < producer_count;
+        contexts[i] = queue;
+        contexts[i].count = QUEUE_BENCH_ITEMS/(is_producer ? producer_count : consumer_count);
+        threads[i] = thread_create(is_producer ? queue_bench_producer : queue_bench_consumer, &contexts[i]);
+    }
+    for (u32 i = 0; i < producer_count + consumer_count; i++) {
+        thread_join(threads[i]);
+    }
+    u64 elapsed = bench_now_ns() - start;
+
+    char name[128];
+    snprintf(name, sizeof(name), "%s, %u producers, %u consumers", queue_bench_names[kind], producer_count, consumer_count);
+    bench_print(name, QUEUE_BENCH_ITEMS, elapsed);
+    arena_free(&arena);
+}
+
+typedef struct {
+    QueueBenchContext request;
+    QueueBenchContext response;
+} QueuePingPong;
+
+static void queue_bench_echo(void *arg) {
+    QueuePingPong *ping_pong = (QueuePingPong*)arg;
+    for (u64 i = 0; i < QUEUE_BENCH_ROUND_TRIPS; i++) {
+        queue_bench_push(&ping_pong->response, queue_bench_pop(&ping_pong->request));
+    }
+}
+
+// Round trip of a message to another thread that sends it back through a second queue
+static void bench_queue_latency(QueueBenchKind kind) {
+    Arena arena = arena_alloc(GiB);
+    QueuePingPong ping_pong = { queue_bench_make(&arena, kind), queue_bench_make(&arena, kind) };
+    u64 *latencies = arena_push_nozero(&arena, u64, QUEUE_BENCH_ROUND_TRIPS);
+
+    Thread echo = thread_create(queue_bench_echo, &ping_pong);
+    for (u64 i = 0; i < QUEUE_BENCH_ROUND_TRIPS; i++) {
+        u64 start = bench_now_ns();
+        queue_bench_push(&ping_pong.request, i);
+        bench_sink += queue_bench_pop(&ping_pong.response);
+        latencies[i] = bench_now_ns() - start;
+    }
+    thread_join(echo);
+
+    char name[128];
+    snprintf(name, sizeof(name), "%s, round trip", queue_bench_names[kind]);
+    bench_print_latencies(name, latencies, QUEUE_BENCH_ROUND_TRIPS);
+    arena_free(&arena);
+}
+
+static void bench_queues() {
+    QueueBenchKind spsc_kinds[] = { QUEUE_BENCH_MUTEX, QUEUE_BENCH_SPSC, QUEUE_BENCH_SPSC_SPIN, QUEUE_BENCH_MPMC, QUEUE_BENCH_MPMC_SPIN };
+    for (u64 i = 0; i < ARRAY_LENGTH(spsc_kinds); i++) {
+        bench_queue_throughput(spsc_kinds[i], 1, 1);
+    }
+
+    u32 thread_counts[][2] = { { 1, 4 }, { 4, 1 }, { 4, 4 }, { 8, 8 } };
+    QueueBenchKind mpmc_kinds[] = { QUEUE_BENCH_MUTEX, QUEUE_BENCH_MPMC, QUEUE_BENCH_MPMC_SPIN };
+    for (u64 i = 0; i < ARRAY_LENGTH(thread_counts); i++) {
+        for (u64 j = 0; j < ARRAY_LENGTH(mpmc_kinds); j++) {
+            bench_queue_throughput(mpmc_kinds[j], thread_counts[i][0], thread_counts[i][1]);
+        }
+    }
+
+    for (u64 i = 0; i < ARRAY_LENGTH(spsc_kinds); i++) {
+        bench_queue_latency(spsc_kinds[i]);
+    }
+}
+
+// ####################################################################################################################
+// Job system
+
+#define JOB_BENCH_ELEMENTS (32*1000*1000)
+#define JOB_BENCH_TINY_JOBS (1000*1000)
+#define JOB_BENCH_FIBONACCI 24
+
+static void job_bench_polynomial(void *arg, u64 begin, u64 end, Arena *arena) {
+    UNUSED(arena);
+    f32 *values = (f32*)arg;
+    for (u64 i = begin; i < end; i++) {
+        f32 x = values[i];
+        for (u32 j = 0; j < 16; j++) {
+            x = x*0.999f + 0.5f;
+        }
+        values[i] = x;
+    }
+}
+
+static void job_bench_tiny(void *arg, u64 begin, u64 end, Arena *arena) {
+    UNUSED(arena);
+    volatile u64 *sums = (volatile u64*)arg;
+    sums[(begin % 8)*8] += end - begin;
+}
+
+typedef struct {
+    JobSystem *jobs;
+    u32 n;
+    u64 result;
+} FibonacciBenchJob;
+
+static void job_bench_fibonacci(void *arg, Arena *arena) {
+    FibonacciBenchJob *job = (FibonacciBenchJob*)arg;
+    if (job->n < 2) {
+        job->result = job->n;
+        return;
+    }
+
+    FibonacciBenchJob *children = arena_push_nozero(arena, FibonacciBenchJob, 2);
+    children[0] = (FibonacciBenchJob){ job->jobs, job->n - 1, 0 };
+    children[1] = (FibonacciBenchJob){ job->jobs, job->n - 2, 0 };
+    JobGroup group = {};
+    job_run(job->jobs, &group, job_bench_fibonacci, &children[0]);
+    job_run(job->jobs, &group, job_bench_fibonacci, &children[1]);
+    job_group_wait(job->jobs, &group);
+    job->result = children[0].result + children[1].result;
+}
+
+static void bench_job_system(u32 worker_count, Arena *arena) {
+    JobSystem *jobs = job_system_alloc(worker_count);
+    char name[128];
+
+    // Compute-bound loop split in ranges of 64 Ki elements
+    u64 arena_pos = arena_get_pos(arena);
+    f32 *values = arena_push(arena, f32, JOB_BENCH_ELEMENTS);
+    u64 start = bench_now_ns();
+    parallel_for(jobs, JOB_BENCH_ELEMENTS, 64*KiB, job_bench_polynomial, values);
+    u64 elapsed = bench_now_ns() - start;
+    bench_sink += (u64)values[JOB_BENCH_ELEMENTS/2];
+    snprintf(name, sizeof(name), "parallel_for, %u workers, grain 64Ki, per element", worker_count);
+    bench_print(name, JOB_BENCH_ELEMENTS, elapsed);
+    arena_set_pos(arena, arena_pos);
+
+    // Scheduling overhead: one job per index
+    u64 *sums = arena_push(arena, u64, 64);
+    start = bench_now_ns();
+    parallel_for(jobs, JOB_BENCH_TINY_JOBS, 1, job_bench_tiny, sums);
+    elapsed = bench_now_ns() - start;
+    snprintf(name, sizeof(name), "parallel_for, %u workers, grain 1, per job", worker_count);
+    bench_print(name, JOB_BENCH_TINY_JOBS, elapsed);
+    arena_set_pos(arena, arena_pos);
+
+    // Nested groups: every job spawns two jobs and waits for them
+    FibonacciBenchJob fibonacci = { jobs, JOB_BENCH_FIBONACCI, 0 };
+    JobGroup group = {};
+    start = bench_now_ns();
+    job_run(jobs, &group, job_bench_fibonacci, &fibonacci);
+    job_group_wait(jobs, &group);
+    elapsed = bench_now_ns() - start;
+    bench_sink += fibonacci.result;
+    // fibonacci(n) makes 2*fibonacci(n + 1) - 1 calls
+    u64 a = 0, b = 1;
+    for (u32 i = 0; i < JOB_BENCH_FIBONACCI + 1; i++) {
+        u64 next = a + b;
+        a = b;
+        b = next;
+    }
+    u64 job_count = 2*a - 1;
+    snprintf(name, sizeof(name), "nested job groups, %u workers, per job", worker_count);
+    bench_print(name, job_count, elapsed);
+
+    job_system_free(jobs);
+}
+
+// ####################################################################################################################
+// Mapped files
+
+// Files up to 1 GiB by default. Build with -DFILE_BENCH_MAX_SIZE=8*GiB to include the 8 GiB file, which needs enough
+// free disk space, and enough RAM for read_entire_file().
+#ifndef FILE_BENCH_MAX_SIZE
+#   define FILE_BENCH_MAX_SIZE GiB
+#endif
+#define FILE_BENCH_NAME "basic_bench_file.bin"
+
+static void file_bench_create(u64 size) {
+    FILE *file = fopen(FILE_BENCH_NAME, "wb");
+    if (file == 0) {
+        fprintf(stderr, "Failed to create " FILE_BENCH_NAME "\n");
+        abort();
+    }
+
+    static u64 chunk[MiB/sizeof(u64)];
+    for (u64 i = 0; i < ARRAY_LENGTH(chunk); i++) {
+        chunk[i] = i*0x9E3779B97F4A7C15ull;
+    }
+    for (u64 written = 0; written < size; written += sizeof(chunk)) {
+        fwrite(chunk, 1, MIN((u64)sizeof(chunk), size - written), file);
+    }
+    fclose(file);
+}
+
+// Evict the file from the page cache, so the next read comes from the disk. It's only supported in Linux.
+static bool file_bench_evict(const char *file_name = FILE_BENCH_NAME) {
+#ifdef __linux__
+    int fd = open(file_name, O_RDONLY);
+    bool ok = fd != -1 && fdatasync(fd) == 0 && posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    if (fd != -1) {
+        close(fd);
+    }
+    return ok;
+#else
+    UNUSED(file_name);
+    return false;
+#endif
+}
+
+// The reader looks at every byte, like a parser
+static u64 file_bench_consume(Buffer contents) {
+    const u64 *words = (const u64*)contents.data;
+    u64 sum = 0;
+    for (u64 i = 0; i < contents.length/sizeof(u64); i++) {
+        sum += words[i];
+    }
+    return sum;
+}
+
+static void bench_read_file(u64 size, bool cold) {
+    if (cold && !file_bench_evict()) {
+        return;
+    }
+    Arena arena = arena_alloc(MAX(2*size, (u64)GiB));
+    Buffer contents = {};
+    u64 start = bench_now_ns();
+    bool ok = read_entire_file(&arena, S(FILE_BENCH_NAME), &contents);
+    bench_sink += file_bench_consume(contents);
+    u64 elapsed = bench_now_ns() - start;
+    assert(ok && contents.length == size);
+    UNUSED(ok);
+    arena_free(&arena);
+
+    char name[128];
+    snprintf(name, sizeof(name), "read_entire_file, %llu MiB, %s cache", (unsigned long long)(size/MiB), cold ? "cold" : "warm");
+    bench_print_bandwidth(name, size, elapsed);
+}
+
+static void bench_map_file(u64 size, bool cold) {
+    if (cold && !file_bench_evict()) {
+        return;
+    }
+    Arena arena = arena_alloc(GiB);
+    MappedFile file = {};
+    u64 start = bench_now_ns();
+    bool ok = map_entire_file(&arena, S(FILE_BENCH_NAME), MAP_FILE_SEQUENTIAL|MAP_FILE_WILL_NEED, &file);
+    bench_sink += file_bench_consume(file.contents);
+    unmap_file(&file);
+    u64 elapsed = bench_now_ns() - start;
+    assert(ok);
+    UNUSED(ok);
+    arena_free(&arena);
+
+    char name[128];
+    snprintf(name, sizeof(name), "map_entire_file, %llu MiB, %s cache", (unsigned long long)(size/MiB), cold ? "cold" : "warm");
+    bench_print_bandwidth(name, size, elapsed);
+}
+
+static void bench_read_file_parallel(u64 size, u32 flags, bool cold) {
+    if (cold && !file_bench_evict()) {
+        return;
+    }
+    Arena arena = arena_alloc(MAX(2*size, (u64)GiB));
+    Buffer contents = {};
+    u64 start = bench_now_ns();
+    bool ok = read_entire_file_parallel(&arena, S(FILE_BENCH_NAME), flags, &contents);
+    bench_sink += file_bench_consume(contents);
+    u64 elapsed = bench_now_ns() - start;
+    assert(ok && contents.length == size);
+    UNUSED(ok);
+    arena_free(&arena);
+
+    char name[128];
+    snprintf(name, sizeof(name), "read_entire_file_parallel%s, %llu MiB, %s cache", flags & READ_FILE_DIRECT ? " direct" : "",
+             (unsigned long long)(size/MiB), cold ? "cold" : "warm");
+    bench_print_bandwidth(name, size, elapsed);
+}
+
+static void bench_stream_file(u64 size, bool cold) {
+    if (cold && !file_bench_evict()) {
+        return;
+    }
+    Arena arena = arena_alloc(GiB);
+    FileStream stream;
+    u64 start = bench_now_ns();
+    bool ok = file_stream_open(&arena, S(FILE_BENCH_NAME), 0, &stream);
+    Buffer chunk = {};
+    u64 unconsumed = 0;
+    while (file_stream_next(&stream, unconsumed, &chunk)) {
+        bench_sink += file_bench_consume(chunk);
+        unconsumed = chunk.length % sizeof(u64);
+    }
+    ok = file_stream_close(&stream) && ok;
+    u64 elapsed = bench_now_ns() - start;
+    assert(ok);
+    UNUSED(ok);
+
+    char name[128];
+    snprintf(name, sizeof(name), "FileStream, %llu MiB, %s cache, %llu MiB of memory", (unsigned long long)(size/MiB),
+             cold ? "cold" : "warm", (unsigned long long)(arena_get_pos(&arena)/MiB));
+    bench_print_bandwidth(name, size, elapsed);
+    arena_free(&arena);
+}
+
+static void bench_files() {
+    u64 sizes[] = { MiB, 64*MiB, GiB, (u64)8*GiB };
+    for (u64 i = 0; i < ARRAY_LENGTH(sizes) && sizes[i] <= (u64)FILE_BENCH_MAX_SIZE; i++) {
+        file_bench_create(sizes[i]);
+        bench_read_file(sizes[i], true);
+        bench_read_file_parallel(sizes[i], 0, true);
+        bench_read_file_parallel(sizes[i], READ_FILE_DIRECT, true);
+        bench_map_file(sizes[i], true);
+        bench_stream_file(sizes[i], true);
+        bench_read_file(sizes[i], false);
+        bench_read_file_parallel(sizes[i], 0, false);
+        bench_read_file_parallel(sizes[i], READ_FILE_DIRECT, false);
+        bench_map_file(sizes[i], false);
+        bench_stream_file(sizes[i], false);
+        remove(FILE_BENCH_NAME);
+    }
+}
+
+// ####################################################################################################################
+// Reading many files
+
+#define MANY_FILES_COUNT 20000
+#define MANY_FILES_DIRECTORY "basic_bench_files"
+
+static String *many_files_create(Arena *arena) {
+#ifdef _WIN32
+    _mkdir(MANY_FILES_DIRECTORY);
+#else
+    mkdir(MANY_FILES_DIRECTORY, 0755);
+#endif
+
+    // Files between 512 bytes and 16 KiB, like configuration files and templates
+    static u8 contents[16*KiB];
+    memset(contents, 'x', sizeof(contents));
+    String *file_names = arena_push_nozero(arena, String, MANY_FILES_COUNT);
+    for (u64 i = 0; i < MANY_FILES_COUNT; i++) {
+        char *file_name = arena_push_nozero(arena, char, 64);
+        int length = snprintf(file_name, 64, MANY_FILES_DIRECTORY "/file_%05llu.txt", (unsigned long long)i);
+        file_names[i] = (String){ (const u8*)file_name, (u64)length };
+
+        FILE *file = fopen(file_name, "wb");
+        fwrite(contents, 1, 512 + (i*7919) % (sizeof(contents) - 512), file);
+        fclose(file);
+    }
+    return file_names;
+}
+
+static void many_files_delete(String *file_names) {
+    for (u64 i = 0; i < MANY_FILES_COUNT; i++) {
+        remove((const char*)file_names[i].data);
+    }
+#ifdef _WIN32
+    _rmdir(MANY_FILES_DIRECTORY);
+#else
+    rmdir(MANY_FILES_DIRECTORY);
+#endif
+}
+
+static bool many_files_evict(String *file_names) {
+    for (u64 i = 0; i < MANY_FILES_COUNT; i++) {
+        if (!file_bench_evict((const char*)file_names[i].data)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// flags is ~0 to read the files one by one with read_entire_file()
+static void bench_read_many_files(String *file_names, u32 flags, bool cold) {
+    if (cold && !many_files_evict(file_names)) {
+        return;
+    }
+
+    Arena arena = arena_alloc(GiB);
+    Buffer *files = arena_push(&arena, Buffer, MANY_FILES_COUNT);
+    bool *ok = arena_push(&arena, bool, MANY_FILES_COUNT);
+    // Measure the I/O, not the page faults of the arena
+    arena_commit(&arena, MANY_FILES_COUNT*16*KiB);
+    u64 start = bench_now_ns();
+    if (flags == ~0u) {
+        for (u64 i = 0; i < MANY_FILES_COUNT; i++) {
+            ok[i] = read_entire_file(&arena, file_names[i], &files[i]);
+        }
+    } else {
+        read_entire_files(&arena, file_names, MANY_FILES_COUNT, flags, files, ok);
+    }
+    u64 elapsed = bench_now_ns() - start;
+    for (u64 i = 0; i < MANY_FILES_COUNT; i++) {
+        assert(ok[i]);
+        bench_sink += files[i].length;
+    }
+    arena_free(&arena);
+
+    const char *method = flags == ~0u ? "read_entire_file loop" :
+                         flags == READ_FILES_NO_IO_URING ? "read_entire_files, threads" : "read_entire_files, io_uring";
+    char name[128];
+    snprintf(name, sizeof(name), "%s, %s cache, per file", method, cold ? "cold" : "warm");
+    bench_print(name, MANY_FILES_COUNT, elapsed);
+}
+
+static void bench_many_files() {
+    Arena arena = arena_alloc(GiB);
+    String *file_names = many_files_create(&arena);
+    for (u32 cold = 0; cold < 2; cold++) {
+        bench_read_many_files(file_names, ~0u, cold);
+        bench_read_many_files(file_names, 0, cold);
+        bench_read_many_files(file_names, READ_FILES_NO_IO_URING, cold);
+    }
+    many_files_delete(file_names);
+    arena_free(&arena);
+}
+
+// ####################################################################################################################
+// Writing files
+
+#define WRITE_BENCH_COUNT 1000
+#define WRITE_BENCH_DIRECTORY "basic_bench_writes"
+#define WRITE_BENCH_SIZE (4*KiB)
+
+typedef enum {
+    WRITE_BENCH_FWRITE,
+    WRITE_BENCH_REPLACE,
+    WRITE_BENCH_REPLACE_SYNC,
+    WRITE_BENCH_BATCH,
+} WriteBenchKind;
+
+static const char *write_bench_names[] = {
+    "fopen + fwrite, not durable",
+    "write_entire_file, not durable",
+    "write_entire_file, WRITE_FILE_SYNC",
+    "write_batch_commit",
+};
+
+static void bench_write_many_files(String *file_names, WriteBenchKind kind) {
+    static u8 contents[WRITE_BENCH_SIZE];
+    memset(contents, 'x', sizeof(contents));
+    Buffer data = { contents, sizeof(contents) };
+
+    Arena arena = arena_alloc(GiB);
+    u64 start = bench_now_ns();
+    if (kind == WRITE_BENCH_BATCH) {
+        WriteBatch batch = write_batch_begin(&arena);
+        for (u64 i = 0; i < WRITE_BENCH_COUNT; i++) {
+            bool ok = write_batch_add(&batch, file_names[i], &data, 1);
+            assert(ok);
+            UNUSED(ok);
+        }
+        bool ok = write_batch_commit(&batch);
+        assert(ok);
+        UNUSED(ok);
+    } else {
+        for (u64 i = 0; i < WRITE_BENCH_COUNT; i++) {
+            if (kind == WRITE_BENCH_FWRITE) {
+                FILE *file = fopen((const char*)file_names[i].data, "wb");
+                fwrite(data.data, 1, data.length, file);
+                fclose(file);
+            } else {
+                bool ok = write_entire_file(file_names[i], data, kind == WRITE_BENCH_REPLACE_SYNC ? WRITE_FILE_SYNC : 0);
+                assert(ok);
+                UNUSED(ok);
+            }
+        }
+    }
+    u64 elapsed = bench_now_ns() - start;
+    arena_free(&arena);
+
+    char name[128];
+    snprintf(name, sizeof(name), "%s, per file", write_bench_names[kind]);
+    bench_print(name, WRITE_BENCH_COUNT, elapsed);
+}
+
+// A file made of many small buffers, written with one call versus concatenated into a single buffer first
+static void bench_write_gather() {
+    u64 buffer_count = 16*1024;
+    u64 buffer_size = 4*KiB;
+    Arena arena = arena_alloc(GiB);
+    Buffer *buffers = arena_push_nozero(&arena, Buffer, buffer_count);
+    for (u64 i = 0; i < buffer_count; i++) {
+        buffers[i].data = arena_push_nozero(&arena, u8, buffer_size);
+        buffers[i].length = buffer_size;
+        memset(buffers[i].data, (int)i, buffer_size);
+    }
+
+    for (u32 gather = 0; gather < 2; gather++) {
+        u64 arena_pos = arena_get_pos(&arena);
+        u64 start = bench_now_ns();
+        if (gather) {
+            bool ok = write_entire_file_gather(S(FILE_BENCH_NAME), buffers, buffer_count, 0);
+            assert(ok);
+            UNUSED(ok);
+        } else {
+            Buffer data = { arena_push_nozero(&arena, u8, buffer_count*buffer_size), buffer_count*buffer_size };
+            for (u64 i = 0; i < buffer_count; i++) {
+                memcpy(data.data + i*buffer_size, buffers[i].data, buffer_size);
+            }
+            bool ok = write_entire_file(S(FILE_BENCH_NAME), data, 0);
+            assert(ok);
+            UNUSED(ok);
+        }
+        u64 elapsed = bench_now_ns() - start;
+        arena_set_pos(&arena, arena_pos);
+
+        const char *name = gather ? "64 MiB, write_entire_file_gather, per 4 KiB buffer" :
+                                    "64 MiB, concatenate + write_entire_file, per 4 KiB";
+        bench_print(name, buffer_count, elapsed);
+    }
+
+    remove(FILE_BENCH_NAME);
+    arena_free(&arena);
+}
+
+static void bench_write_files() {
+#ifdef _WIN32
+    _mkdir(WRITE_BENCH_DIRECTORY);
+#else
+    mkdir(WRITE_BENCH_DIRECTORY, 0755);
+#endif
+
+    Arena arena = arena_alloc(GiB);
+    String *file_names = arena_push_nozero(&arena, String, WRITE_BENCH_COUNT);
+    for (u64 i = 0; i < WRITE_BENCH_COUNT; i++) {
+        char *file_name = arena_push_nozero(&arena, char, 64);
+        int length = snprintf(file_name, 64, WRITE_BENCH_DIRECTORY "/file_%04llu.bin", (unsigned long long)i);
+        file_names[i] = (String){ (const u8*)file_name, (u64)length };
+    }
+
+    bench_write_many_files(file_names, WRITE_BENCH_FWRITE);
+    bench_write_many_files(file_names, WRITE_BENCH_REPLACE);
+    bench_write_many_files(file_names, WRITE_BENCH_REPLACE_SYNC);
+    bench_write_many_files(file_names, WRITE_BENCH_BATCH);
+    bench_write_gather();
+
+    for (u64 i = 0; i < WRITE_BENCH_COUNT; i++) {
+        remove((const char*)file_names[i].data);
+    }
+#ifdef _WIN32
+    _rmdir(WRITE_BENCH_DIRECTORY);
+#else
+    rmdir(WRITE_BENCH_DIRECTORY);
+#endif
+    arena_free(&arena);
+}
+
+// ####################################################################################################################
+// Walking directories
+
+#define WALK_BENCH_DIRECTORY "basic_bench_tree"
+#define WALK_BENCH_FANOUT 20        // Subdirectories of the root and of each of them
+#define WALK_BENCH_FILES 100        // Files in every directory of the last level
+
+// Tree of 20*20 directories with 100 empty files each
+static void walk_bench_tree(bool create) {
+    char path[128];
+    for (u32 i = 0; i <= WALK_BENCH_FANOUT*(WALK_BENCH_FANOUT + 1); i++) {
+        // Parents come first when the tree is created and last when it's removed
+        u32 index = create ? i : WALK_BENCH_FANOUT*(WALK_BENCH_FANOUT + 1) - i;
+        u32 level = index == 0 ? 0 : index <= WALK_BENCH_FANOUT ? 1 : 2;
+        if (level == 0) {
+            snprintf(path, sizeof(path), WALK_BENCH_DIRECTORY);
+        } else if (level == 1) {
+            snprintf(path, sizeof(path), WALK_BENCH_DIRECTORY "/dir_%02u", index - 1);
+        } else {
+            u32 leaf = index - WALK_BENCH_FANOUT - 1;
+            snprintf(path, sizeof(path), WALK_BENCH_DIRECTORY "/dir_%02u/dir_%02u", leaf/WALK_BENCH_FANOUT, leaf % WALK_BENCH_FANOUT);
+        }
+
+        if (create) {
+#ifdef _WIN32
+            _mkdir(path);
+#else
+            mkdir(path, 0755);
+#endif
+        }
+        if (level == 2) {
+            char file_name[160];
+            for (u32 f = 0; f < WALK_BENCH_FILES; f++) {
+                snprintf(file_name, sizeof(file_name), "%s/file_%03u.txt", path, f);
+                if (create) {
+                    FILE *file = fopen(file_name, "wb");
+                    fclose(file);
+                } else {
+                    remove(file_name);
+                }
+            }
+        }
+        if (!create) {
+#ifdef _WIN32
+            _rmdir(path);
+#else
+            rmdir(path);
+#endif
+        }
+    }
+}
+
+static void bench_walk_std_filesystem(u64 entry_count, bool with_sizes) {
+    u64 start = bench_now_ns();
+    u64 count = 0;
+    u64 sum = 0;
+    for (const std::filesystem::directory_entry &entry : std::filesystem::recursive_directory_iterator(WALK_BENCH_DIRECTORY)) {
+        count += 1;
+        sum += entry.path().native().size() + entry.is_directory();
+        if (with_sizes && entry.is_regular_file()) {
+            sum += entry.file_size();
+        }
+    }
+    u64 elapsed = bench_now_ns() - start;
+    assert(count == entry_count);
+    bench_sink += sum;
+
+    bench_print(with_sizes ? "recursive_directory_iterator, file_size, per entry" :
+                             "recursive_directory_iterator, per entry", entry_count, elapsed);
+}
+
+static void bench_walk_directory(u64 entry_count, JobSystem *jobs, u32 flags) {
+    Arena arena = arena_alloc(GiB);
+    u64 start = bench_now_ns();
+    DirectoryListing listing = {};
+    bool ok = walk_directory(&arena, jobs, S(WALK_BENCH_DIRECTORY), flags, &listing);
+    u64 elapsed = bench_now_ns() - start;
+    assert(ok && listing.count == entry_count);
+    UNUSED(ok);
+    bench_sink += listing.count;
+    arena_free(&arena);
+
+    char name[128];
+    snprintf(name, sizeof(name), "walk_directory, %s%s, per entry", jobs != 0 ? "job system" : "1 thread",
+             flags & WALK_DIRECTORY_SIZES ? ", sizes" : "");
+    bench_print(name, entry_count, elapsed);
+}
+
+static void bench_walk() {
+    walk_bench_tree(true);
+    u64 entry_count = WALK_BENCH_FANOUT + WALK_BENCH_FANOUT*WALK_BENCH_FANOUT*(1 + WALK_BENCH_FILES);
+
+    JobSystem *jobs = job_system_alloc(0);
+    for (u32 with_sizes = 0; with_sizes < 2; with_sizes++) {
+        u32 flags = with_sizes ? WALK_DIRECTORY_SIZES : 0;
+        bench_walk_std_filesystem(entry_count, with_sizes);
+        bench_walk_directory(entry_count, 0, flags);
+        bench_walk_directory(entry_count, jobs, flags);
+    }
+    job_system_free(jobs);
+
+    walk_bench_tree(false);
+}
+
+// ####################################################################################################################
+// File cache
+
+#define CACHE_BENCH_FILES 200
+#define CACHE_BENCH_READS 200000
+#define CACHE_BENCH_DIRECTORY "basic_bench_cache"
+
+// Reads spread over files of 1 KiB to 16 KiB, like the templates of a web server, with budgets that hold every file or
+// half of them. budget is 0 to read every file with read_entire_file().
+static void bench_file_cache(String *file_names, u64 budget) {
+    Arena arena = arena_alloc(GiB);
+    FileCache cache = file_cache_alloc(budget);
+    u64 random_state = 1;
+    u64 sum = 0;
+
+    u64 start = bench_now_ns();
+    for (u64 i = 0; i < CACHE_BENCH_READS; i++) {
+        random_state = random_state*6364136223846793005ull + 1442695040888963407ull;
+        String file_name = file_names[(random_state >> 33) % CACHE_BENCH_FILES];
+        Buffer contents = {};
+        if (budget == 0) {
+            u64 arena_pos = arena_get_pos(&arena);
+            bool ok = read_entire_file(&arena, file_name, &contents);
+            assert(ok);
+            UNUSED(ok);
+            sum += contents.data[0];
+            arena_set_pos(&arena, arena_pos);
+        } else {
+            bool ok = file_cache_read(&cache, file_name, &contents);
+            assert(ok);
+            UNUSED(ok);
+            sum += contents.data[0];
+            file_cache_release(&cache, contents);
+        }
+    }
+    u64 elapsed = bench_now_ns() - start;
+    bench_sink += sum;
+
+    char name[128];
+    if (budget == 0) {
+        snprintf(name, sizeof(name), "read_entire_file, per read");
+    } else {
+        FileCacheStats stats = file_cache_get_stats(&cache);
+        snprintf(name, sizeof(name), "file_cache_read, %llu KiB budget, %.0f%% hits, per read",
+                 (unsigned long long)(budget/KiB), 100.0*(f64)stats.hits/(f64)(stats.hits + stats.misses));
+    }
+    bench_print(name, CACHE_BENCH_READS, elapsed);
+
+    file_cache_free(&cache);
+    arena_free(&arena);
+}
+
+static void bench_file_caches() {
+#ifdef _WIN32
+    _mkdir(CACHE_BENCH_DIRECTORY);
+#else
+    mkdir(CACHE_BENCH_DIRECTORY, 0755);
+#endif
+
+    Arena arena = arena_alloc(GiB);
+    static u8 contents[16*KiB];
+    memset(contents, 'x', sizeof(contents));
+    String *file_names = arena_push_nozero(&arena, String, CACHE_BENCH_FILES);
+    u64 total_size = 0;
+    for (u64 i = 0; i < CACHE_BENCH_FILES; i++) {
+        char *file_name = arena_push_nozero(&arena, char, 64);
+        int length = snprintf(file_name, 64, CACHE_BENCH_DIRECTORY "/template_%03llu.html", (unsigned long long)i);
+        file_names[i] = (String){ (const u8*)file_name, (u64)length };
+
+        Buffer data = { contents, KiB + (i*7919) % (sizeof(contents) - KiB) };
+        bool ok = write_entire_file(file_names[i], data, 0);
+        assert(ok);
+        UNUSED(ok);
+        total_size += data.length;
+    }
+
+    bench_file_cache(file_names, 0);
+    bench_file_cache(file_names, 2*total_size);
+    bench_file_cache(file_names, total_size/2);
+
+    for (u64 i = 0; i < CACHE_BENCH_FILES; i++) {
+        remove((const char*)file_names[i].data);
+    }
+#ifdef _WIN32
+    _rmdir(CACHE_BENCH_DIRECTORY);
+#else
+    rmdir(CACHE_BENCH_DIRECTORY);
+#endif
+    arena_free(&arena);
+}
+
+int main(void) {
+    bench_print_header("String interning: 4096 identifiers");
+    bench_interner();
+
+    bench_print_header("Ring buffer: 1 GiB from one producer to one consumer");
+    bench_ring_buffer(1000);
+    bench_ring_buffer(30000);
+
+    bench_print_header("Queues: 4M elements of 8 bytes, 1024 slots");
+    bench_queues();
+
+    bench_print_header("Job system: from 1 worker to one per logical processor");
+    Arena arena = arena_alloc(GiB);
+    u32 cpu_count = get_cpu_count();
+    for (u32 worker_count = 1; worker_count < cpu_count; worker_count *= 2) {
+        bench_job_system(worker_count, &arena);
+    }
+    bench_job_system(cpu_count, &arena);
+    arena_free(&arena);
+
+    bench_print_header("Reading big files");
+    bench_files();
+
+    bench_print_header("Reading 20000 files of 512 bytes to 16 KiB");
+    bench_many_files();
+
+    bench_print_header("Writing 1000 files of 4 KiB");
+    bench_write_files();
+
+    bench_print_header("Walking a tree of 420 directories and 40000 files");
+    bench_walk();
+
+    bench_print_header("File cache: 200000 random reads of 200 files of 1 KiB to 16 KiB");
+    bench_file_caches();
+
+    return 0;
+}
@@ -1,5 +1,13 @@
+#include <stdio.h>
 #include <string.h>
 
+#ifdef _WIN32
+#   include <direct.h>
+#elif __linux__
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
 #include "basic.h"
 #include "test_suite.cpp"
 
@@ -625,11 +633,968 @@ static void test_read_entire_file_does_not_exist(void *context) {
     EXPECT(arena_pos_after_reading_file == arena_pos_before_reading_file);
 }
 
+static void test_map_entire_file(void *context) {
+    Arena *arena = (Arena*)context;
+    u64 arena_pos_before_mapping_file = arena_get_pos(arena);
+
+    // @NOTE: The file test_file.txt must exist and must contain exactly the following sentence:
+    String expected = S("The quick brown fox jumps over the lazy dog.");
+
+    MappedFile file = {};
+    bool ret = map_entire_file(arena, S("test_file.txt"), MAP_FILE_SEQUENTIAL|MAP_FILE_WILL_NEED, &file);
+    EXPECT(ret);
+    EXPECT(file._is_mapped);
+    EXPECT(string_equals(BUFFER_TO_STRING(file.contents), expected));
+
+    // Mapped files don't use memory from the arena
+    EXPECT(arena_get_pos(arena) == arena_pos_before_mapping_file);
+    unmap_file(&file);
+    EXPECT(file.contents.data == 0);
+
+    ret = map_entire_file(arena, S("test_file_does_not_exist.txt"), 0, &file);
+    EXPECT(ret == false);
+    EXPECT(arena_get_pos(arena) == arena_pos_before_mapping_file);
+}
+
+static void test_map_entire_file_copies_files_without_size(void *context) {
+#ifdef __linux__
+    Arena *arena = (Arena*)context;
+
+    // Files in /proc report a size of 0, so they are read into the arena until the end
+    MappedFile file = {};
+    bool ret = map_entire_file(arena, S("/proc/self/status"), 0, &file);
+    EXPECT(ret);
+    EXPECT(!file._is_mapped);
+    EXPECT(string_starts_with(BUFFER_TO_STRING(file.contents), S("Name:")));
+    unmap_file(&file);
+#else
+    UNUSED(context);
+#endif
+}
+
+#define FILE_STREAM_TEST_LINES 20000
+
+static void test_file_stream_carries_records_across_chunks(void *context) {
+    Arena *arena = (Arena*)context;
+
+    // Lines of different lengths, so they cross the chunk boundaries at every possible offset. The last one doesn't end
+    // with a line break.
+    FILE *file = fopen("file_stream_test.txt", "wb");
+    EXPECT(file != 0);
+    for (u64 i = 0; i < FILE_STREAM_TEST_LINES; i++) {
+        fprintf(file, "%llu:%.*s%s", (unsigned long long)i, (int)(i % 97), "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz",
+                i + 1 < FILE_STREAM_TEST_LINES ? "\n" : "");
+    }
+    fclose(file);
+
+    FileStream stream;
+    EXPECT(file_stream_open(arena, S("file_stream_test.txt"), 4*KiB, &stream));
+
+    u64 line_count = 0;
+    bool ok = true;
+    Buffer chunk = {};
+    u64 unconsumed = 0;
+    while (file_stream_next(&stream, unconsumed, &chunk)) {
+        // Every complete line must be "<line number>:<line number % 97 letters>"
+        u64 line_start = 0;
+        for (u64 i = 0; i < chunk.length; i++) {
+            if (chunk.data[i] != '\n') {
+                continue;
+            }
+            char expected[128];
+            int length = snprintf(expected, sizeof(expected), "%llu:%.*s", (unsigned long long)line_count, (int)(line_count % 97),
+                                  "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz");
+            String line = { chunk.data + line_start, i - line_start };
+            ok = ok && string_equals(line, (String){ (const u8*)expected, (u64)length });
+            line_count += 1;
+            line_start = i + 1;
+        }
+        unconsumed = chunk.length - line_start;
+    }
+    EXPECT(ok);
+    EXPECT(line_count == FILE_STREAM_TEST_LINES - 1);
+    EXPECT(string_starts_with(BUFFER_TO_STRING(chunk), S("19999:")));
+    EXPECT(file_stream_close(&stream));
+
+    // Close the stream before the end of the file
+    EXPECT(file_stream_open(arena, S("file_stream_test.txt"), 4*KiB, &stream));
+    EXPECT(file_stream_next(&stream, 0, &chunk));
+    EXPECT(chunk.length == 4*KiB);
+    EXPECT(file_stream_close(&stream));
+
+    EXPECT(!file_stream_open(arena, S("test_file_does_not_exist.txt"), 0, &stream));
+    remove("file_stream_test.txt");
+}
+
+static void test_read_entire_files(void *context) {
+    Arena *arena = (Arena*)context;
+
+    // Enough copies of test_file.txt to need several rounds of files in flight, and files that can't be read
+    String file_names[3*READ_FILES_IN_FLIGHT];
+    for (u64 i = 0; i < ARRAY_LENGTH(file_names); i++) {
+        file_names[i] = S("test_file.txt");
+    }
+    file_names[5] = S("test_file_does_not_exist.txt");
+#ifdef __linux__
+    file_names[6] = S("/proc/self/status");
+#endif
+
+    u32 modes[] = { 0, READ_FILES_NO_IO_URING };
+    for (u64 m = 0; m < ARRAY_LENGTH(modes); m++) {
+        Buffer files[ARRAY_LENGTH(file_names)];
+        bool ok[ARRAY_LENGTH(file_names)];
+        EXPECT(!read_entire_files(arena, file_names, ARRAY_LENGTH(file_names), modes[m], files, ok));
+
+        for (u64 i = 0; i < ARRAY_LENGTH(file_names); i++) {
+            if (i == 5) {
+                EXPECT(!ok[i]);
+                EXPECT(files[i].length == 0);
+#ifdef __linux__
+            } else if (i == 6) {
+                EXPECT(ok[i]);
+                EXPECT(string_starts_with(BUFFER_TO_STRING(files[i]), S("Name:")));
+#endif
+            } else {
+                EXPECT(ok[i]);
+                EXPECT(string_equals(BUFFER_TO_STRING(files[i]), S("The quick brown fox jumps over the lazy dog.")));
+            }
+        }
+    }
+}
+
+static void test_read_entire_file_parallel(void *context) {
+    Arena *arena = (Arena*)context;
+
+    // Several ranges and a partial page at the end
+    u64 file_size = 2*READ_FILE_RANGE_SIZE + 5000;
+    u32 *pattern = arena_push_nozero(arena, u32, file_size/sizeof(u32) + 1);
+    for (u64 i = 0; i < file_size/sizeof(u32) + 1; i++) {
+        pattern[i] = (u32)(i*2654435761u);
+    }
+    FILE *file = fopen("parallel_read_test.bin", "wb");
+    EXPECT(file != 0);
+    fwrite(pattern, 1, file_size, file);
+    fclose(file);
+
+    u32 modes[] = { 0, READ_FILE_DIRECT };
+    for (u64 m = 0; m < ARRAY_LENGTH(modes); m++) {
+        Buffer contents = {};
+        EXPECT(read_entire_file_parallel(arena, S("parallel_read_test.bin"), modes[m], &contents));
+        EXPECT(contents.length == file_size);
+        EXPECT(memcmp(contents.data, pattern, file_size) == 0);
+
+        EXPECT(read_entire_file_parallel(arena, S("test_file.txt"), modes[m], &contents));
+        EXPECT(string_equals(BUFFER_TO_STRING(contents), S("The quick brown fox jumps over the lazy dog.")));
+
+#ifdef __linux__
+        // Files in /proc report a size of 0, so they are read until the end
+        EXPECT(read_entire_file_parallel(arena, S("/proc/self/status"), modes[m], &contents));
+        EXPECT(string_starts_with(BUFFER_TO_STRING(contents), S("Name:")));
+#endif
+
+        u64 arena_pos = arena_get_pos(arena);
+        EXPECT(!read_entire_file_parallel(arena, S("test_file_does_not_exist.txt"), modes[m], &contents));
+        EXPECT(arena_get_pos(arena) == arena_pos);
+    }
+
+    remove("parallel_read_test.bin");
+}
+
+static void test_write_entire_file(void *context) {
+    Arena *arena = (Arena*)context;
+
+    u8 old_data[] = "old contents";
+    Buffer old_contents = { old_data, sizeof(old_data) - 1 };
+    EXPECT(write_entire_file(S("write_test.txt"), old_contents, 0));
+
+    // More buffers than a single gathered write takes, and some of them are empty
+    Buffer buffers[3*64];
+    u8 digits[] = "0123456789";
+    for (u64 i = 0; i < ARRAY_LENGTH(buffers); i++) {
+        buffers[i].data = digits;
+        buffers[i].length = i % 3 == 0 ? 0 : i % 10 + 1;
+    }
+    EXPECT(write_entire_file_gather(S("write_test.txt"), buffers, ARRAY_LENGTH(buffers), WRITE_FILE_SYNC));
+
+    Buffer contents = {};
+    EXPECT(read_entire_file(arena, S("write_test.txt"), &contents));
+    u64 offset = 0;
+    for (u64 i = 0; i < ARRAY_LENGTH(buffers); i++) {
+        EXPECT(offset + buffers[i].length <= contents.length);
+        EXPECT(memcmp(contents.data + offset, buffers[i].data, buffers[i].length) == 0);
+        offset += buffers[i].length;
+    }
+    EXPECT(offset == contents.length);
+
+    Buffer empty = {};
+    EXPECT(write_entire_file(S("write_test.txt"), empty, WRITE_FILE_SYNC));
+    EXPECT(read_entire_file_parallel(arena, S("write_test.txt"), 0, &contents));
+    EXPECT(contents.length == 0);
+
+    EXPECT(!write_entire_file(S("directory_does_not_exist/write_test.txt"), old_contents, 0));
+
+#ifdef __linux__
+    // New files get 0666 minus the umask, and replacing a file keeps its permissions
+    mode_t mask = umask(0);
+    umask(mask);
+    struct stat st = {};
+    remove("write_test.txt");
+    EXPECT(write_entire_file(S("write_test.txt"), old_contents, 0));
+    EXPECT(stat("write_test.txt", &st) == 0 && (st.st_mode & 07777) == (0666 & ~mask));
+    EXPECT(chmod("write_test.txt", 0600) == 0);
+    EXPECT(write_entire_file(S("write_test.txt"), old_contents, 0));
+    EXPECT(stat("write_test.txt", &st) == 0 && (st.st_mode & 07777) == 0600);
+
+    // Writing through a symbolic link replaces the file it points to and keeps the link
+    u8 new_data[] = "new contents";
+    Buffer new_contents = { new_data, sizeof(new_data) - 1 };
+    remove("write_test_link.txt");
+    EXPECT(symlink("write_test.txt", "write_test_link.txt") == 0);
+    EXPECT(write_entire_file(S("write_test_link.txt"), new_contents, WRITE_FILE_SYNC));
+    EXPECT(lstat("write_test_link.txt", &st) == 0 && S_ISLNK(st.st_mode));
+    EXPECT(read_entire_file(arena, S("write_test.txt"), &contents));
+    EXPECT(string_equals(BUFFER_TO_STRING(contents), S("new contents")));
+    remove("write_test_link.txt");
+#endif
+
+    remove("write_test.txt");
+}
+
+static void test_write_batch_replaces_files_on_commit(void *context) {
+    Arena *arena = (Arena*)context;
+
+    u8 old_data[] = "old";
+    u8 new_data[] = "new";
+    u8 newer_data[] = "newer";
+    Buffer old_contents = { old_data, sizeof(old_data) - 1 };
+    Buffer data = { new_data, sizeof(new_data) - 1 };
+    Buffer newer = { newer_data, sizeof(newer_data) - 1 };
+
+    String file_names[] = { S("write_batch_test_0.txt"), S("write_batch_test_1.txt") };
+    for (u64 i = 0; i < ARRAY_LENGTH(file_names); i++) {
+        EXPECT(write_entire_file(file_names[i], old_contents, 0));
+    }
+
+    // Nothing changes until the batch is committed
+    WriteBatch batch = write_batch_begin(arena);
+    for (u64 i = 0; i < ARRAY_LENGTH(file_names); i++) {
+        EXPECT(write_batch_add(&batch, file_names[i], &data, 1));
+    }
+    EXPECT(!write_batch_add(&batch, S("directory_does_not_exist/write_batch_test.txt"), &data, 1));
+
+    Buffer contents = {};
+    EXPECT(read_entire_file(arena, file_names[0], &contents));
+    EXPECT(string_equals(BUFFER_TO_STRING(contents), S("old")));
+
+    EXPECT(write_batch_commit(&batch));
+    for (u64 i = 0; i < ARRAY_LENGTH(file_names); i++) {
+        EXPECT(read_entire_file(arena, file_names[i], &contents));
+        EXPECT(string_equals(BUFFER_TO_STRING(contents), S("new")));
+    }
+
+    // A cancelled batch leaves the files as they were
+    batch = write_batch_begin(arena);
+    EXPECT(write_batch_add(&batch, file_names[0], &newer, 1));
+    write_batch_cancel(&batch);
+    EXPECT(write_batch_commit(&batch));
+    EXPECT(read_entire_file(arena, file_names[0], &contents));
+    EXPECT(string_equals(BUFFER_TO_STRING(contents), S("new")));
+
+    for (u64 i = 0; i < ARRAY_LENGTH(file_names); i++) {
+        remove(string_to_cstring(arena, file_names[i]));
+    }
+}
+
+static void test_file_cache_serves_hits_without_copying(void *context) {
+    UNUSED(context);
+
+    u8 first[] = "first";
+    u8 second[] = "again";
+    Buffer first_contents = { first, sizeof(first) - 1 };
+    Buffer second_contents = { second, sizeof(second) - 1 };
+    EXPECT(write_entire_file(S("cache_test.txt"), first_contents, 0));
+
+    FileCache cache = file_cache_alloc(KiB);
+    Buffer a = {};
+    Buffer b = {};
+    EXPECT(file_cache_read(&cache, S("cache_test.txt"), &a));
+    EXPECT(file_cache_read(&cache, S("cache_test.txt"), &b));
+    EXPECT(string_equals(BUFFER_TO_STRING(a), S("first")));
+    EXPECT(a.data == b.data);
+    FileCacheStats stats = file_cache_get_stats(&cache);
+    EXPECT(stats.misses == 1 && stats.hits == 1 && stats.entry_count == 1);
+
+    // Replaced with the same size. The buffers of the old contents stay valid until they are released.
+    EXPECT(write_entire_file(S("cache_test.txt"), second_contents, 0));
+    Buffer c = {};
+    EXPECT(file_cache_read(&cache, S("cache_test.txt"), &c));
+    EXPECT(string_equals(BUFFER_TO_STRING(c), S("again")));
+    EXPECT(string_equals(BUFFER_TO_STRING(a), S("first")));
+    stats = file_cache_get_stats(&cache);
+    EXPECT(stats.misses == 2 && stats.invalidations == 1 && stats.entry_count == 1);
+    file_cache_release(&cache, a);
+    file_cache_release(&cache, b);
+    file_cache_release(&cache, c);
+
+    EXPECT(!file_cache_read(&cache, S("test_file_does_not_exist.txt"), &a));
+    EXPECT(!file_cache_read(&cache, S("."), &a));
+
+    file_cache_free(&cache);
+    remove("cache_test.txt");
+}
+
+static void test_file_cache_evicts_least_recently_used(void *context) {
+    UNUSED(context);
+
+    // Room for two of the files, but not for the big one
+    u8 data[1000] = {};
+    Buffer small = { data, 200 };
+    Buffer big = { data, sizeof(data) };
+    const char *file_names[] = { "cache_test_0.txt", "cache_test_1.txt", "cache_test_2.txt", "cache_test_big.txt" };
+    for (u64 i = 0; i < 3; i++) {
+        EXPECT(write_entire_file(string_from_cstring(file_names[i]), small, 0));
+    }
+    EXPECT(write_entire_file(string_from_cstring(file_names[3]), big, 0));
+
+    FileCache cache = file_cache_alloc(2*(200 + 200));
+    Buffer contents = {};
+    for (u64 i = 0; i < 3; i++) {
+        EXPECT(file_cache_read(&cache, string_from_cstring(file_names[i % 2]), &contents));
+        file_cache_release(&cache, contents);
+    }
+
+    // The second file is the least recently used, so it's evicted and the first one is still cached
+    EXPECT(file_cache_read(&cache, string_from_cstring(file_names[2]), &contents));
+    file_cache_release(&cache, contents);
+    FileCacheStats stats = file_cache_get_stats(&cache);
+    EXPECT(stats.evictions == 1 && stats.entry_count == 2);
+    EXPECT(stats.used_size <= 2*(200 + 200));
+    EXPECT(file_cache_read(&cache, string_from_cstring(file_names[0]), &contents));
+    file_cache_release(&cache, contents);
+    EXPECT(file_cache_get_stats(&cache).hits == 2);
+
+    // Files bigger than the budget are mapped every time instead of cached
+    Buffer other = {};
+    EXPECT(file_cache_read(&cache, string_from_cstring(file_names[3]), &contents));
+    EXPECT(file_cache_read(&cache, string_from_cstring(file_names[3]), &other));
+    EXPECT(contents.length == sizeof(data) && memcmp(contents.data, data, sizeof(data)) == 0);
+    EXPECT(other.length == sizeof(data) && other.data != contents.data);
+    file_cache_release(&cache, contents);
+    file_cache_release(&cache, other);
+    stats = file_cache_get_stats(&cache);
+    EXPECT(stats.entry_count == 2 && stats.used_size <= 2*(200 + 200));
+
+    // Evicting many different files doesn't make the map grow without bound
+    char many_file_name[64];
+    for (u32 i = 0; i < 100; i++) {
+        snprintf(many_file_name, sizeof(many_file_name), "cache_test_many_%u.txt", i);
+        EXPECT(write_entire_file(string_from_cstring(many_file_name), small, 0));
+    }
+    for (u32 i = 0; i < 10000; i++) {
+        snprintf(many_file_name, sizeof(many_file_name), "cache_test_many_%u.txt", (i*37) % 100);
+        EXPECT(file_cache_read(&cache, string_from_cstring(many_file_name), &contents));
+        file_cache_release(&cache, contents);
+    }
+    EXPECT(arena_get_pos(cache._map_arena) < 64*KiB);
+
+    file_cache_free(&cache);
+    for (u64 i = 0; i < ARRAY_LENGTH(file_names); i++) {
+        remove(file_names[i]);
+    }
+    for (u32 i = 0; i < 100; i++) {
+        snprintf(many_file_name, sizeof(many_file_name), "cache_test_many_%u.txt", i);
+        remove(many_file_name);
+    }
+}
+
+typedef struct {
+    Mutex mutex;
+    u64 counter;
+} MutexTestContext;
+
+static void mutex_test_thread(void *arg) {
+    MutexTestContext *context = (MutexTestContext*)arg;
+    for (u64 i = 0; i < 100000; i++) {
+        mutex_lock(&context->mutex);
+        context->counter += 1;
+        mutex_unlock(&context->mutex);
+    }
+}
+
+static void test_mutex_protects_counter(void *context) {
+    UNUSED(context);
+
+    MutexTestContext mutex_context = {};
+    Thread threads[4];
+    for (u64 i = 0; i < ARRAY_LENGTH(threads); i++) {
+        threads[i] = thread_create(mutex_test_thread, &mutex_context);
+    }
+    for (u64 i = 0; i < ARRAY_LENGTH(threads); i++) {
+        thread_join(threads[i]);
+    }
+
+    EXPECT(mutex_context.counter == 4*100000);
+}
+
+static void test_atomics_return_previous_value(void *context) {
+    UNUSED(context);
+
+    volatile u64 value = 10;
+    EXPECT(atomic_fetch_add_u64(&value, 5) == 10);
+    EXPECT(atomic_exchange_u64(&value, 20) == 15);
+    EXPECT(atomic_compare_exchange_u64(&value, 1, 30) == 20);
+    EXPECT(atomic_load_u64(&value) == 20);
+    EXPECT(atomic_compare_exchange_u64(&value, 20, 30) == 20);
+    EXPECT(atomic_load_u64(&value) == 30);
+}
+
+static void test_array_push_and_pop(void *context) {
+    Arena *arena = (Arena*)context;
+
+    Array<u64> numbers = array_make(arena, u64, 0);
+    for (u64 i = 0; i < 1000; i++) {
+        u64 *element = array_push(&numbers, i);
+        EXPECT(*element == i);
+    }
+    EXPECT(numbers.length == 1000);
+    EXPECT(numbers.capacity >= 1000);
+    for (u64 i = 0; i < numbers.length; i++) {
+        EXPECT(numbers[i] == i);
+    }
+
+    for (u64 i = 1000; i > 0; i--) {
+        EXPECT(array_pop(&numbers) == i - 1);
+    }
+    EXPECT(numbers.length == 0);
+}
+
+static void test_array_grows_in_place_when_last(void *context) {
+    Arena *arena = (Arena*)context;
+
+    // The array is the last element of the arena, so it never moves
+    Array<u32> numbers = array_make(arena, u32, 4);
+    u32 *data = numbers.data;
+    for (u32 i = 0; i < 100; i++) {
+        array_push(&numbers, i);
+    }
+    EXPECT(numbers.data == data);
+    EXPECT(arena_get_pos(arena) == numbers.capacity*sizeof(u32));
+
+    // Another push lands after the array, so the next growth has to copy the elements
+    arena_push(arena, u8);
+    u32 more[200] = {};
+    for (u32 i = 0; i < ARRAY_LENGTH(more); i++) {
+        more[i] = 100 + i;
+    }
+    array_append(&numbers, more, ARRAY_LENGTH(more));
+    EXPECT(numbers.data != data);
+    EXPECT(numbers.length == 300);
+    for (u32 i = 0; i < numbers.length; i++) {
+        EXPECT(numbers[i] == i);
+    }
+
+    array_clear(&numbers);
+    EXPECT(numbers.length == 0);
+}
+
+static String string_map_test_key(Arena *arena, u64 i) {
+    char *key = arena_push_nozero(arena, char, 32);
+    int length = snprintf(key, 32, "key-%llu", (unsigned long long)i);
+    String str = { (const u8*)key, (u64)length };
+    return str;
+}
+
+static void test_string_map_put_get_remove(void *context) {
+    Arena *arena = (Arena*)context;
+
+    StringMap<u32> map = string_map_make(arena, u32, 0);
+    EXPECT(string_map_get(&map, S("http")) == 0);
+
+    string_map_put(&map, S("http"), 80);
+    string_map_put(&map, S("https"), 443);
+    EXPECT(map.length == 2);
+    EXPECT(*string_map_get(&map, S("http")) == 80);
+    EXPECT(*string_map_get(&map, S("https")) == 443);
+
+    // Overwrite
+    u32 *value = string_map_put(&map, S("http"), 8080);
+    EXPECT(*value == 8080);
+    EXPECT(*string_map_get(&map, S("http")) == 8080);
+    EXPECT(map.length == 2);
+
+    EXPECT(string_map_remove(&map, S("http")));
+    EXPECT(!string_map_remove(&map, S("http")));
+    EXPECT(string_map_get(&map, S("http")) == 0);
+    EXPECT(*string_map_get(&map, S("https")) == 443);
+    EXPECT(map.length == 1);
+
+    // Empty keys are valid keys
+    string_map_put(&map, S(""), 1);
+    EXPECT(*string_map_get(&map, S("")) == 1);
+}
+
+static void test_string_map_grows_and_reuses_deleted_slots(void *context) {
+    Arena *arena = (Arena*)context;
+
+    StringMap<u64> map = string_map_make(arena, u64, 0);
+    for (u64 i = 0; i < 10000; i++) {
+        string_map_put(&map, string_map_test_key(arena, i), i);
+    }
+    EXPECT(map.length == 10000);
+    for (u64 i = 0; i < 10000; i++) {
+        u64 *value = string_map_get(&map, string_map_test_key(arena, i));
+        EXPECT(value != 0 && *value == i);
+    }
+    EXPECT(string_map_get(&map, S("key-10000")) == 0);
+
+    // Removing and inserting different keys many times must not grow the table forever
+    u64 capacity = map._capacity;
+    for (u64 i = 0; i < 100000; i++) {
+        EXPECT(string_map_remove(&map, string_map_test_key(arena, i)));
+        string_map_put(&map, string_map_test_key(arena, i + 10000), i + 10000);
+    }
+    EXPECT(map.length == 10000);
+    EXPECT(map._capacity == capacity);
+    for (u64 i = 100000; i < 110000; i++) {
+        u64 *value = string_map_get(&map, string_map_test_key(arena, i));
+        EXPECT(value != 0 && *value == i);
+    }
+}
+
+static void test_string_hash(void *context) {
+    UNUSED(context);
+
+    EXPECT(string_hash(S("content-length")) == string_hash(string_from_cstring("content-length")));
+    EXPECT(string_hash(S("content-length")) != string_hash(S("content-type")));
+    EXPECT(string_hash(S("a")) != string_hash(S("b")));
+    EXPECT(string_hash(S("")) != string_hash(S("a")));
+}
+
+static void test_interner_deduplicates_strings(void *context) {
+    Arena *arena = (Arena*)context;
+    Interner interner = interner_alloc();
+
+    EXPECT(interner_find(&interner, S("content-length")) == 0);
+    Atom a = interner_intern(&interner, S("content-length"));
+    Atom b = interner_intern(&interner, S("content-type"));
+    EXPECT(a != 0 && b != 0 && a != b);
+
+    // The interned string is a copy, so the key can be released
+    const char *key = string_to_cstring(arena, S("content-length"));
+    EXPECT(interner_intern(&interner, string_from_cstring(key)) == a);
+    EXPECT(interner_find(&interner, S("content-length")) == a);
+    EXPECT(string_equals(interner_get_string(&interner, a), S("content-length")));
+    EXPECT(interner_get_string(&interner, a).data != (const u8*)key);
+
+    Atom empty = interner_intern(&interner, S(""));
+    EXPECT(empty != 0 && interner_intern(&interner, S("")) == empty);
+    EXPECT(interner_get_string(&interner, empty).length == 0);
+    EXPECT(interner_get_count(&interner) == 3);
+
+    interner_free(&interner);
+}
+
+#define INTERNER_TEST_THREADS 4
+#define INTERNER_TEST_KEYS 20000
+
+typedef struct {
+    Interner *interner;
+    Atom atoms[INTERNER_TEST_KEYS];
+} InternerTestThread;
+
+static void interner_test_thread(void *arg) {
+    InternerTestThread *thread = (InternerTestThread*)arg;
+    for (u64 i = 0; i < INTERNER_TEST_KEYS; i++) {
+        char key[32];
+        int length = snprintf(key, sizeof(key), "identifier_%llu", (unsigned long long)i);
+        String str = { (const u8*)key, (u64)length };
+        thread->atoms[i] = interner_intern(thread->interner, str);
+    }
+}
+
+static void test_interner_concurrent_interning(void *context) {
+    Arena *arena = (Arena*)context;
+    Interner interner = interner_alloc();
+
+    // Every thread interns the same strings while the table grows, and all of them must get the same atoms
+    InternerTestThread *threads = arena_push(arena, InternerTestThread, INTERNER_TEST_THREADS);
+    Thread handles[INTERNER_TEST_THREADS];
+    for (u64 i = 0; i < INTERNER_TEST_THREADS; i++) {
+        threads[i].interner = &interner;
+        handles[i] = thread_create(interner_test_thread, &threads[i]);
+    }
+    for (u64 i = 0; i < INTERNER_TEST_THREADS; i++) {
+        thread_join(handles[i]);
+    }
+
+    EXPECT(interner_get_count(&interner) == INTERNER_TEST_KEYS);
+    for (u64 i = 0; i < INTERNER_TEST_KEYS; i++) {
+        Atom atom = threads[0].atoms[i];
+        for (u64 t = 1; t < INTERNER_TEST_THREADS; t++) {
+            EXPECT(threads[t].atoms[i] == atom);
+        }
+
+        char key[32];
+        int length = snprintf(key, sizeof(key), "identifier_%llu", (unsigned long long)i);
+        String str = { (const u8*)key, (u64)length };
+        EXPECT(string_equals(interner_get_string(&interner, atom), str));
+    }
+
+    interner_free(&interner);
+}
+
+static void test_ring_buffer_is_contiguous_across_the_end(void *context) {
+    UNUSED(context);
+    RingBuffer ring = ring_buffer_alloc(1);
+    u64 capacity = ring._capacity;
+
+    Buffer free_space = ring_buffer_write_begin(&ring);
+    EXPECT(free_space.length == capacity);
+    EXPECT(ring_buffer_read_begin(&ring).length == 0);
+
+    // Move the positions close to the end, so the next write wraps around
+    ring_buffer_write_end(&ring, capacity - 10);
+    ring_buffer_read_end(&ring, capacity - 10);
+
+    free_space = ring_buffer_write_begin(&ring);
+    EXPECT(free_space.length == capacity);
+    memcpy(free_space.data, "0123456789abcdefghij", 20);
+    ring_buffer_write_end(&ring, 20);
+
+    // The wrapped bytes are at the beginning of the buffer and the data is still contiguous
+    EXPECT(memcmp(ring._memory, "abcdefghij", 10) == 0);
+    Buffer data = ring_buffer_read_begin(&ring);
+    EXPECT(data.length == 20);
+    EXPECT(memcmp(data.data, "0123456789abcdefghij", 20) == 0);
+
+    ring_buffer_read_end(&ring, 15);
+    data = ring_buffer_read_begin(&ring);
+    EXPECT(data.length == 5);
+    EXPECT(memcmp(data.data, "fghij", 5) == 0);
+    EXPECT(ring_buffer_write_begin(&ring).length == capacity - 5);
+
+    ring_buffer_free(&ring);
+}
+
+#define RING_BUFFER_TEST_BYTES (64*MiB)
+
+static void ring_buffer_test_producer(void *arg) {
+    RingBuffer *ring = (RingBuffer*)arg;
+    u64 written = 0;
+    while (written < RING_BUFFER_TEST_BYTES) {
+        Buffer free_space = ring_buffer_write_begin(ring);
+        u64 count = MIN(free_space.length, RING_BUFFER_TEST_BYTES - written);
+        count = MIN(count, 1000 + written % 3000);
+        for (u64 i = 0; i < count; i++) {
+            free_space.data[i] = (u8)((written + i) % 251);
+        }
+        ring_buffer_write_end(ring, count);
+        written += count;
+        if (count == 0) {
+            atomic_pause();
+        }
+    }
+}
+
+static void test_ring_buffer_producer_and_consumer(void *context) {
+    UNUSED(context);
+    RingBuffer ring = ring_buffer_alloc(64*KiB);
+    Thread producer = thread_create(ring_buffer_test_producer, &ring);
+
+    // The consumer checks that every byte arrives in order
+    bool ok = true;
+    u64 read = 0;
+    while (read < RING_BUFFER_TEST_BYTES) {
+        Buffer data = ring_buffer_read_begin(&ring);
+        for (u64 i = 0; i < data.length; i++) {
+            ok = ok && data.data[i] == (u8)((read + i) % 251);
+        }
+        ring_buffer_read_end(&ring, data.length);
+        read += data.length;
+        if (data.length == 0) {
+            atomic_pause();
+        }
+    }
+
+    thread_join(producer);
+    EXPECT(ok);
+    EXPECT(read == RING_BUFFER_TEST_BYTES);
+    ring_buffer_free(&ring);
+}
+
 static void do_before_every_test_handler(void *context) {
     Arena *arena = (Arena*)context;
     arena_clear(arena);
 }
 
+static void test_spsc_queue_push_and_pop(void *context) {
+    Arena *arena = (Arena*)context;
+    SpscQueue<u64> queue = spsc_queue_make(arena, u64, 5, 0);
+
+    // The capacity is rounded up to 8. Push and pop a few laps so the positions wrap around the storage.
+    u64 value;
+    for (u64 lap = 0; lap < 3; lap++) {
+        for (u64 i = 0; i < 8; i++) {
+            EXPECT(spsc_queue_push(&queue, lap*8 + i));
+        }
+        EXPECT(!spsc_queue_push(&queue, 1000));
+
+        for (u64 i = 0; i < 8; i++) {
+            EXPECT(spsc_queue_pop(&queue, &value));
+            EXPECT(value == lap*8 + i);
+        }
+        EXPECT(!spsc_queue_pop(&queue, &value));
+    }
+}
+
+#define QUEUE_TEST_ITEMS (1000*1000)
+
+static void spsc_queue_test_producer(void *arg) {
+    SpscQueue<u64> *queue = (SpscQueue<u64>*)arg;
+    for (u64 i = 0; i < QUEUE_TEST_ITEMS; i++) {
+        spsc_queue_push_wait(queue, i);
+    }
+}
+
+static void test_spsc_queue_blocking_producer_and_consumer(void *context) {
+    Arena *arena = (Arena*)context;
+    SpscQueue<u64> queue = spsc_queue_make(arena, u64, 16, QUEUE_FLAG_BLOCKING);
+    Thread producer = thread_create(spsc_queue_test_producer, &queue);
+
+    bool ok = true;
+    for (u64 i = 0; i < QUEUE_TEST_ITEMS; i++) {
+        ok = ok && spsc_queue_pop_wait(&queue) == i;
+    }
+
+    thread_join(producer);
+    EXPECT(ok);
+    u64 value;
+    EXPECT(!spsc_queue_pop(&queue, &value));
+}
+
+#define MPMC_TEST_THREADS 4
+
+typedef struct {
+    MpmcQueue<u32> *queue;
+    u32 first;          // Producers push [first, first + QUEUE_TEST_ITEMS/MPMC_TEST_THREADS)
+    volatile u32 *seen; // Consumers count how many times they pop every value
+} MpmcQueueTestThread;
+
+static void mpmc_queue_test_producer(void *arg) {
+    MpmcQueueTestThread *thread = (MpmcQueueTestThread*)arg;
+    for (u32 i = 0; i < QUEUE_TEST_ITEMS/MPMC_TEST_THREADS; i++) {
+        mpmc_queue_push_wait(thread->queue, thread->first + i);
+    }
+}
+
+static void mpmc_queue_test_consumer(void *arg) {
+    MpmcQueueTestThread *thread = (MpmcQueueTestThread*)arg;
+    for (u32 i = 0; i < QUEUE_TEST_ITEMS/MPMC_TEST_THREADS; i++) {
+        u32 value = mpmc_queue_pop_wait(thread->queue);
+        atomic_fetch_add_u32(&thread->seen[value], 1);
+    }
+}
+
+static void test_mpmc_queue_multiple_producers_and_consumers(void *context) {
+    Arena *arena = (Arena*)context;
+    MpmcQueue<u32> queue = mpmc_queue_make(arena, u32, 64, QUEUE_FLAG_BLOCKING);
+
+    u32 value;
+    EXPECT(!mpmc_queue_pop(&queue, &value));
+
+    volatile u32 *seen = arena_push(arena, u32, QUEUE_TEST_ITEMS);
+    MpmcQueueTestThread threads[2*MPMC_TEST_THREADS];
+    Thread handles[2*MPMC_TEST_THREADS];
+    for (u32 i = 0; i < MPMC_TEST_THREADS; i++) {
+        threads[i] = (MpmcQueueTestThread){ &queue, i*(QUEUE_TEST_ITEMS/MPMC_TEST_THREADS), seen };
+        threads[MPMC_TEST_THREADS + i] = threads[i];
+        handles[i] = thread_create(mpmc_queue_test_producer, &threads[i]);
+        handles[MPMC_TEST_THREADS + i] = thread_create(mpmc_queue_test_consumer, &threads[MPMC_TEST_THREADS + i]);
+    }
+    for (u32 i = 0; i < 2*MPMC_TEST_THREADS; i++) {
+        thread_join(handles[i]);
+    }
+
+    bool ok = true;
+    for (u64 i = 0; i < QUEUE_TEST_ITEMS; i++) {
+        ok = ok && seen[i] == 1;
+    }
+    EXPECT(ok);
+    EXPECT(!mpmc_queue_pop(&queue, &value));
+}
+
+#define JOB_TEST_WORKERS 4
+#define PARALLEL_FOR_TEST_COUNT 100000
+
+static void parallel_for_test_range(void *arg, u64 begin, u64 end, Arena *arena) {
+    volatile u32 *visits = (volatile u32*)arg;
+    // Temporary memory of the job. It's released when the job returns.
+    u64 *indices = arena_push_nozero(arena, u64, end - begin);
+    for (u64 i = begin; i < end; i++) {
+        indices[i - begin] = i;
+    }
+    for (u64 i = 0; i < end - begin; i++) {
+        atomic_fetch_add_u32(&visits[indices[i]], 1);
+    }
+}
+
+static void test_parallel_for_visits_every_index_once(void *context) {
+    Arena *arena = (Arena*)context;
+    JobSystem *jobs = job_system_alloc(JOB_TEST_WORKERS);
+    EXPECT(job_system_get_worker_count(jobs) == JOB_TEST_WORKERS);
+
+    u64 grain_sizes[] = { 0, 1, 7, PARALLEL_FOR_TEST_COUNT };
+    for (u64 g = 0; g < ARRAY_LENGTH(grain_sizes); g++) {
+        volatile u32 *visits = arena_push(arena, u32, PARALLEL_FOR_TEST_COUNT);
+        parallel_for(jobs, PARALLEL_FOR_TEST_COUNT, grain_sizes[g], parallel_for_test_range, (void*)visits);
+
+        bool ok = true;
+        for (u64 i = 0; i < PARALLEL_FOR_TEST_COUNT; i++) {
+            ok = ok && visits[i] == 1;
+        }
+        EXPECT(ok);
+    }
+
+    job_system_free(jobs);
+}
+
+typedef struct {
+    JobSystem *jobs;
+    u32 n;
+    u64 result;
+} FibonacciJob;
+
+// Every call spawns two jobs and waits for them, so workers wait inside jobs while others steal from them
+static void fibonacci_job(void *arg, Arena *arena) {
+    FibonacciJob *job = (FibonacciJob*)arg;
+    if (job->n < 2) {
+        job->result = job->n;
+        return;
+    }
+
+    FibonacciJob *children = arena_push(arena, FibonacciJob, 2);
+    children[0] = (FibonacciJob){ job->jobs, job->n - 1, 0 };
+    children[1] = (FibonacciJob){ job->jobs, job->n - 2, 0 };
+    JobGroup group = {};
+    job_run(job->jobs, &group, fibonacci_job, &children[0]);
+    job_run(job->jobs, &group, fibonacci_job, &children[1]);
+    job_group_wait(job->jobs, &group);
+    job->result = children[0].result + children[1].result;
+}
+
+static void test_job_groups_can_be_nested(void *context) {
+    UNUSED(context);
+    JobSystem *jobs = job_system_alloc(JOB_TEST_WORKERS);
+
+    FibonacciJob fibonacci = { jobs, 20, 0 };
+    JobGroup group = {};
+    job_run(jobs, &group, fibonacci_job, &fibonacci);
+    job_group_wait(jobs, &group);
+    EXPECT(fibonacci.result == 6765);
+
+    job_system_free(jobs);
+}
+
+#define WALK_TEST_MANY_FILES 300
+
+static void walk_test_write(const char *file_name, const char *contents) {
+    FILE *file = fopen(file_name, "wb");
+    EXPECT(file != 0);
+    fwrite(contents, 1, strlen(contents), file);
+    fclose(file);
+}
+
+static const DirectoryEntry *walk_test_find(const DirectoryListing *listing, String path) {
+    for (u64 i = 0; i < listing->count; i++) {
+        if (string_equals(listing->entries[i].path, path)) {
+            return &listing->entries[i];
+        }
+    }
+    return 0;
+}
+
+static void test_walk_directory_lists_every_entry(void *context) {
+    Arena *arena = (Arena*)context;
+
+    // More files in one directory than fit in the first batches of entries
+    const char *directories[] = { "walk_test", "walk_test/sub", "walk_test/sub/deeper", "walk_test/empty", "walk_test/many" };
+    for (u64 i = 0; i < ARRAY_LENGTH(directories); i++) {
+#ifdef _WIN32
+        _mkdir(directories[i]);
+#else
+        mkdir(directories[i], 0755);
+#endif
+    }
+    walk_test_write("walk_test/a.txt", "abc");
+    walk_test_write("walk_test/sub/b.txt", "hello");
+    walk_test_write("walk_test/sub/deeper/c.txt", "");
+    char file_name[64];
+    for (u32 i = 0; i < WALK_TEST_MANY_FILES; i++) {
+        snprintf(file_name, sizeof(file_name), "walk_test/many/file_%03u.txt", i);
+        walk_test_write(file_name, "x");
+    }
+    u64 expected_count = 7 + WALK_TEST_MANY_FILES;
+#ifdef __linux__
+    EXPECT(symlink("sub", "walk_test/link") == 0);
+    expected_count += 1;
+#endif
+
+    JobSystem *jobs = job_system_alloc(JOB_TEST_WORKERS);
+    for (u32 mode = 0; mode < 4; mode++) {
+        // The separator is not doubled when the root already ends with one
+        String root = mode % 2 == 0 ? S("walk_test") : S("walk_test/");
+        u32 flags = mode >= 2 ? WALK_DIRECTORY_SIZES : 0;
+        DirectoryListing listing = {};
+        EXPECT(walk_directory(arena, mode == 1 ? 0 : jobs, root, flags, &listing));
+        EXPECT(listing.count == expected_count);
+        EXPECT(listing.error_count == 0);
+
+        for (u64 i = 0; i < listing.count; i++) {
+            EXPECT(string_starts_with(listing.entries[i].path, S("walk_test/")));
+            EXPECT(listing.entries[i].path.data[listing.entries[i].path.length] == 0);
+        }
+
+        const DirectoryEntry *entry = walk_test_find(&listing, S("walk_test/sub/b.txt"));
+        EXPECT(entry != 0 && entry->type == DIRECTORY_ENTRY_FILE);
+        EXPECT(entry->size == (flags ? 5u : 0u));
+        entry = walk_test_find(&listing, S("walk_test/sub/deeper"));
+        EXPECT(entry != 0 && entry->type == DIRECTORY_ENTRY_DIRECTORY);
+        entry = walk_test_find(&listing, S("walk_test/sub/deeper/c.txt"));
+        EXPECT(entry != 0 && entry->type == DIRECTORY_ENTRY_FILE && entry->size == 0);
+        entry = walk_test_find(&listing, S("walk_test/many/file_299.txt"));
+        EXPECT(entry != 0 && entry->type == DIRECTORY_ENTRY_FILE);
+#ifdef __linux__
+        // Symbolic links are not followed
+        entry = walk_test_find(&listing, S("walk_test/link"));
+        EXPECT(entry != 0 && entry->type == DIRECTORY_ENTRY_SYMLINK);
+        EXPECT(walk_test_find(&listing, S("walk_test/link/b.txt")) == 0);
+#endif
+    }
+
+    DirectoryListing listing = {};
+    EXPECT(!walk_directory(arena, jobs, S("walk_test_does_not_exist"), 0, &listing));
+    EXPECT(listing.count == 0);
+    job_system_free(jobs);
+
+#ifdef __linux__
+    remove("walk_test/link");
+#endif
+    for (u32 i = 0; i < WALK_TEST_MANY_FILES; i++) {
+        snprintf(file_name, sizeof(file_name), "walk_test/many/file_%03u.txt", i);
+        remove(file_name);
+    }
+    remove("walk_test/a.txt");
+    remove("walk_test/sub/b.txt");
+    remove("walk_test/sub/deeper/c.txt");
+    for (u64 i = ARRAY_LENGTH(directories); i > 0; i--) {
+#ifdef _WIN32
+        _rmdir(directories[i - 1]);
+#else
+        rmdir(directories[i - 1]);
+#endif
+    }
+}
+
 int main(void) {
     TestSuite suite = test_suite_new(__FILE__);
 
@@ -656,6 +1621,32 @@ int main(void) {
     TEST(&suite, test_string_concat_something_with_empty);
     TEST(&suite, test_read_entire_file);
     TEST(&suite, test_read_entire_file_does_not_exist);
+    TEST(&suite, test_map_entire_file);
+    TEST(&suite, test_map_entire_file_copies_files_without_size);
+    TEST(&suite, test_read_entire_files);
+    TEST(&suite, test_read_entire_file_parallel);
+    TEST(&suite, test_file_stream_carries_records_across_chunks);
+    TEST(&suite, test_write_entire_file);
+    TEST(&suite, test_write_batch_replaces_files_on_commit);
+    TEST(&suite, test_file_cache_serves_hits_without_copying);
+    TEST(&suite, test_file_cache_evicts_least_recently_used);
+    TEST(&suite, test_mutex_protects_counter);
+    TEST(&suite, test_atomics_return_previous_value);
+    TEST(&suite, test_array_push_and_pop);
+    TEST(&suite, test_array_grows_in_place_when_last);
+    TEST(&suite, test_string_map_put_get_remove);
+    TEST(&suite, test_string_map_grows_and_reuses_deleted_slots);
+    TEST(&suite, test_string_hash);
+    TEST(&suite, test_interner_deduplicates_strings);
+    TEST(&suite, test_interner_concurrent_interning);
+    TEST(&suite, test_ring_buffer_is_contiguous_across_the_end);
+    TEST(&suite, test_ring_buffer_producer_and_consumer);
+    TEST(&suite, test_spsc_queue_push_and_pop);
+    TEST(&suite, test_spsc_queue_blocking_producer_and_consumer);
+    TEST(&suite, test_mpmc_queue_multiple_producers_and_consumers);
+    TEST(&suite, test_parallel_for_visits_every_index_once);
+    TEST(&suite, test_job_groups_can_be_nested);
+    TEST(&suite, test_walk_directory_lists_every_entry);
 
     int errcode = test_suite_run_all_and_print(&suite);
     arena_free(&arena_test);
@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifdef _WIN32
+#    define _WIN32_LEAN_AND_MEAN
+#    include <windows.h>
+#endif
+
+// Minimal helpers shared by every benchmark. Benchmarks are only meaningful with optimizations enabled, so build them with
+// `make clean bench CXXFLAGS=-O2`.
+
+// ====================================================================================================================
+// Timer
+static uint64_t bench_now_ns() {
+#ifdef _WIN32
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)((double)counter.QuadPart*1e9/(double)frequency.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+// ====================================================================================================================
+// Reporting
+static void bench_print_header(const char *title) {
+    printf("\n=== %s ===\n", title);
+}
+
+// Print the average time per operation and the throughput of a benchmark
+static void bench_print(const char *name, uint64_t operations, uint64_t elapsed_ns) {
+    double ns_per_op = (double)elapsed_ns/(double)operations;
+    double mops = (double)operations*1e3/(double)elapsed_ns;
+    printf("%-56s %10.2f ns/op %10.2f Mop/s\n", name, ns_per_op, mops);
+}
+
+// Print the bandwidth of a benchmark that moves bytes around
+static inline void bench_print_bandwidth(const char *name, uint64_t bytes, uint64_t elapsed_ns) {
+    double gib_per_second = (double)bytes/(1024.0*1024.0*1024.0)/((double)elapsed_ns/1e9);
+    printf("%-56s %10.2f GiB/s\n", name, gib_per_second);
+}
+
+// Print the average duration of a long operation, like loading a file
+static inline void bench_print_duration(const char *name, uint64_t operations, uint64_t elapsed_ns) {
+    double ms_per_op = (double)elapsed_ns/(double)operations/1e6;
+    printf("%-56s %10.3f ms/op\n", name, ms_per_op);
+}
+
+static int bench_compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+// Sort the latencies of individual operations and print their percentiles
+static inline void bench_print_latencies(const char *name, uint64_t *latencies_ns, uint64_t count) {
+    qsort(latencies_ns, count, sizeof(uint64_t), bench_compare_u64);
+    printf(
+        "%-56s p50 %6llu ns  p99 %6llu ns  p99.9 %6llu ns  max %8llu ns\n",
+        name,
+        (unsigned long long)latencies_ns[count/2],
+        (unsigned long long)latencies_ns[count*99/100],
+        (unsigned long long)latencies_ns[count*999/1000],
+        (unsigned long long)latencies_ns[count - 1]
+    );
+}
+
+// Prevent the compiler from optimizing away the result of a benchmark
+static volatile uint64_t bench_sink;
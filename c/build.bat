@@ -6,11 +6,17 @@ rem Preserve current working directory
 pushd .
 cd Build
 
-cl /Zi /Fe:"arena_test.exe" ..\basic.cpp ..\arena_test.cpp ..\arena_virtual_memory.cpp
+cl /Zi /std:c++17 /Fe:"arena_test.exe" ..\basic.cpp ..\arena_test.cpp ..\arena_virtual_memory.cpp
+cl /Zi /std:c++17 /DARENA_STATS /Fe:"arena_stats_test.exe" ..\basic.cpp ..\arena_test.cpp
 cl /Zi /Fe:"basic_test.exe" ..\basic.cpp ..\basic_test.cpp
+cl /Zi /std:c++17 /O2 /Fe:"arena_bench.exe" ..\basic.cpp ..\arena_bench.cpp
+cl /Zi /std:c++17 /O2 /Fe:"basic_bench.exe" ..\basic.cpp ..\basic_bench.cpp
 
 copy /Y "arena_test.exe" ..
+copy /Y "arena_stats_test.exe" ..
 copy /Y "basic_test.exe" ..
+copy /Y "arena_bench.exe" ..
+copy /Y "basic_bench.exe" ..
 
 rem Restore original working directory
 popd